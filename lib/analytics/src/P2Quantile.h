@@ -0,0 +1,127 @@
+#ifndef P2_QUANTILE_H
+#define P2_QUANTILE_H
+
+#include <math.h>
+#include <stdint.h>
+
+// Estimate of the p-quantile (0 < p < 1) with the P-square algorithm (Jain &
+// Chlamtac 1985): five markers whose heights are adjusted with piecewise-
+// parabolic interpolation as values arrive, so no values are stored. Exact
+// up to five values; after that typically within a few percent for smooth
+// distributions.
+class P2Quantile
+{
+public:
+    explicit P2Quantile(float p = 0.5f) : _p(p) { reset(); }
+
+    void reset()
+    {
+        _count = 0;
+        for (int i = 0; i < 5; i++)
+        {
+            _height[i] = 0.0f;
+            _position[i] = i;
+        }
+        _desired[0] = 0.0f;
+        _desired[1] = 2.0f * _p;
+        _desired[2] = 4.0f * _p;
+        _desired[3] = 2.0f + 2.0f * _p;
+        _desired[4] = 4.0f;
+    }
+
+    void add(float value)
+    {
+        if (isnan(value))
+            return;
+        if (_count < 5)
+        {
+            // Insertion sort of the first five values
+            int i = (int)_count++;
+            while (i > 0 && _height[i - 1] > value)
+            {
+                _height[i] = _height[i - 1];
+                i--;
+            }
+            _height[i] = value;
+            return;
+        }
+        _count++;
+
+        int cell;
+        if (value < _height[0])
+        {
+            _height[0] = value;
+            cell = 0;
+        }
+        else if (value >= _height[4])
+        {
+            _height[4] = value;
+            cell = 3;
+        }
+        else
+        {
+            cell = 0;
+            while (value >= _height[cell + 1])
+                cell++;
+        }
+        for (int i = cell + 1; i < 5; i++)
+            _position[i]++;
+        const float increment[5] = {0.0f, _p / 2.0f, _p, (1.0f + _p) / 2.0f, 1.0f};
+        for (int i = 0; i < 5; i++)
+            _desired[i] += increment[i];
+
+        for (int i = 1; i < 4; i++)
+        {
+            float offset = _desired[i] - _position[i];
+            if ((offset >= 1.0f && _position[i + 1] - _position[i] > 1) ||
+                (offset <= -1.0f && _position[i - 1] - _position[i] < -1))
+            {
+                int step = offset > 0.0f ? 1 : -1;
+                float height = parabolic(i, step);
+                if (!(_height[i - 1] < height && height < _height[i + 1]))
+                    height = linear(i, step);
+                _height[i] = height;
+                _position[i] += step;
+            }
+        }
+    }
+
+    uint32_t count() const { return _count; }
+    float quantile() const { return _p; }
+
+    // NAN before the first value
+    float value() const
+    {
+        if (_count == 0)
+            return NAN;
+        if (_count <= 5)
+        {
+            // Nearest rank among the sorted first values
+            int index = (int)ceilf(_p * _count) - 1;
+            return _height[index < 0 ? 0 : index];
+        }
+        return _height[2];
+    }
+
+private:
+    float parabolic(int i, int step) const
+    {
+        float n0 = _position[i - 1], n1 = _position[i], n2 = _position[i + 1];
+        return _height[i] + step / (n2 - n0) *
+                                ((n1 - n0 + step) * (_height[i + 1] - _height[i]) / (n2 - n1) +
+                                 (n2 - n1 - step) * (_height[i] - _height[i - 1]) / (n1 - n0));
+    }
+
+    float linear(int i, int step) const
+    {
+        return _height[i] + step * (_height[i + step] - _height[i]) / (float)(_position[i + step] - _position[i]);
+    }
+
+    float _p;
+    uint32_t _count;
+    float _height[5];
+    int32_t _position[5];
+    float _desired[5];
+};
+
+#endif // P2_QUANTILE_H
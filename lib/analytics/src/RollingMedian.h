@@ -0,0 +1,236 @@
+#ifndef ROLLING_MEDIAN_H
+#define ROLLING_MEDIAN_H
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Median and median absolute deviation (MAD) of the last N values. The
+// values are kept in an order-statistic treap (a binary search tree with
+// subtree sizes, balanced by random priorities) whose nodes live in a fixed
+// array, one per slot of the window: adding a value removes the oldest node
+// and reinserts it with the new value, both in O(log N). Any order statistic
+// is then O(log N), and the MAD, the median of |x - median|, O(log^2 N) by
+// selecting from the deviations below and above the median as two sorted
+// sequences. NaN values are ignored. Memory is 16 bytes per slot.
+template <size_t N>
+class RollingMedian
+{
+    static_assert(N >= 1 && N < 65535, "RollingMedian window must hold 1..65534 values");
+
+public:
+    RollingMedian() { reset(); }
+
+    void reset()
+    {
+        _root = NIL;
+        _count = 0;
+        _next = 0;
+        _seed = 0x9E3779B9u;
+    }
+
+    // Adds a value, replacing the oldest once the window is full
+    void add(float value)
+    {
+        if (isnan(value))
+            return;
+        uint16_t node = _next;
+        if (_count == N)
+            _root = erase(_root, node);
+        else
+            _count++;
+        Node &n = _nodes[node];
+        n.value = value;
+        n.priority = random();
+        n.left = n.right = NIL;
+        n.size = 1;
+        _root = insert(_root, node);
+        _next = (uint16_t)((_next + 1) % N);
+    }
+
+    size_t size() const { return _count; }
+    bool full() const { return _count == N; }
+
+    // k-th smallest value (0-based); NAN if k is out of range
+    float select(size_t k) const
+    {
+        if (k >= _count)
+            return NAN;
+        uint16_t node = _root;
+        for (;;)
+        {
+            const Node &n = _nodes[node];
+            size_t left = sizeOf(n.left);
+            if (k < left)
+                node = n.left;
+            else if (k == left)
+                return n.value;
+            else
+            {
+                k -= left + 1;
+                node = n.right;
+            }
+        }
+    }
+
+    // Mean of the two middle values for an even count; NAN when empty
+    float median() const
+    {
+        if (_count == 0)
+            return NAN;
+        if (_count % 2)
+            return select(_count / 2);
+        return 0.5f * (select(_count / 2 - 1) + select(_count / 2));
+    }
+
+    // Median of |x - median()|, unscaled (multiply by 1.4826 for a standard
+    // deviation estimate of normal data); NAN when empty
+    float mad() const
+    {
+        if (_count == 0)
+            return NAN;
+        float center = median();
+        // Values below index split deviate by center - select(split - 1 - i),
+        // values from split on by select(split + i) - center; both ascend in i
+        size_t split = _count / 2;
+        if (_count % 2)
+            return deviation(center, split, _count / 2);
+        return 0.5f * (deviation(center, split, _count / 2 - 1) + deviation(center, split, _count / 2));
+    }
+
+private:
+    static const uint16_t NIL = 0xFFFF;
+
+    struct Node
+    {
+        float value;
+        uint32_t priority;
+        uint16_t left, right, size;
+    };
+
+    uint32_t random()
+    {
+        // xorshift32
+        _seed ^= _seed << 13;
+        _seed ^= _seed >> 17;
+        _seed ^= _seed << 5;
+        return _seed;
+    }
+
+    size_t sizeOf(uint16_t node) const { return node == NIL ? 0 : _nodes[node].size; }
+
+    void update(uint16_t node)
+    {
+        Node &n = _nodes[node];
+        n.size = (uint16_t)(1 + sizeOf(n.left) + sizeOf(n.right));
+    }
+
+    // Orders by value, then by slot, so equal values have distinct keys
+    bool less(uint16_t a, uint16_t b) const
+    {
+        return _nodes[a].value < _nodes[b].value || (_nodes[a].value == _nodes[b].value && a < b);
+    }
+
+    // Splits the tree at root into the keys below and above node's key
+    void split(uint16_t root, uint16_t node, uint16_t &left, uint16_t &right)
+    {
+        if (root == NIL)
+        {
+            left = right = NIL;
+            return;
+        }
+        if (less(root, node))
+        {
+            split(_nodes[root].right, node, _nodes[root].right, right);
+            left = root;
+        }
+        else
+        {
+            split(_nodes[root].left, node, left, _nodes[root].left);
+            right = root;
+        }
+        update(root);
+    }
+
+    // Joins two trees where every key of a is below every key of b
+    uint16_t merge(uint16_t a, uint16_t b)
+    {
+        if (a == NIL)
+            return b;
+        if (b == NIL)
+            return a;
+        if (_nodes[a].priority > _nodes[b].priority)
+        {
+            _nodes[a].right = merge(_nodes[a].right, b);
+            update(a);
+            return a;
+        }
+        _nodes[b].left = merge(a, _nodes[b].left);
+        update(b);
+        return b;
+    }
+
+    uint16_t insert(uint16_t root, uint16_t node)
+    {
+        if (root == NIL)
+            return node;
+        if (_nodes[node].priority > _nodes[root].priority)
+        {
+            split(root, node, _nodes[node].left, _nodes[node].right);
+            update(node);
+            return node;
+        }
+        if (less(node, root))
+            _nodes[root].left = insert(_nodes[root].left, node);
+        else
+            _nodes[root].right = insert(_nodes[root].right, node);
+        update(root);
+        return root;
+    }
+
+    uint16_t erase(uint16_t root, uint16_t node)
+    {
+        if (root == node)
+            return merge(_nodes[root].left, _nodes[root].right);
+        if (less(node, root))
+            _nodes[root].left = erase(_nodes[root].left, node);
+        else
+            _nodes[root].right = erase(_nodes[root].right, node);
+        update(root);
+        return root;
+    }
+
+    float below(float center, size_t split, size_t i) const { return center - select(split - 1 - i); }
+    float above(float center, size_t split, size_t i) const { return select(split + i) - center; }
+
+    // k-th smallest deviation (0-based): binary search for how many of the
+    // k + 1 smallest come from the values below split
+    float deviation(float center, size_t split, size_t k) const
+    {
+        size_t lower = split, upper = _count - split;
+        size_t lo = k + 1 > upper ? k + 1 - upper : 0;
+        size_t hi = k + 1 < lower ? k + 1 : lower;
+        while (lo < hi)
+        {
+            size_t i = (lo + hi) / 2;
+            if (below(center, split, i) < above(center, split, k - i))
+                lo = i + 1;
+            else
+                hi = i;
+        }
+        float result = -INFINITY;
+        if (lo > 0)
+            result = below(center, split, lo - 1);
+        if (lo < k + 1)
+            result = fmaxf(result, above(center, split, k - lo));
+        return result;
+    }
+
+    Node _nodes[N];
+    uint16_t _root;
+    uint16_t _next; // Slot of the next value, the oldest once full
+    size_t _count;
+    uint32_t _seed;
+};
+
+#endif // ROLLING_MEDIAN_H
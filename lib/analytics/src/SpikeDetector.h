@@ -0,0 +1,56 @@
+#ifndef SPIKE_DETECTOR_H
+#define SPIKE_DETECTOR_H
+
+#include <math.h>
+#include <stddef.h>
+#include "RollingMedian.h"
+
+// Online outlier test (a causal Hampel filter): each value is scored against
+// the median and MAD of the N values before it,
+//
+//   score = |x - median| / max(1.4826 * MAD, min_scale)
+//
+// and is a spike if the score exceeds the threshold. min_scale keeps a flat
+// signal (MAD 0) from turning every small change into a spike. Every value
+// enters the window afterwards, spikes included, so a lasting change of
+// level stops being flagged once it makes up half the window.
+template <size_t N>
+class SpikeDetector
+{
+public:
+    explicit SpikeDetector(float threshold = 5.0f, float min_scale = 0.0f, size_t min_history = N / 2)
+        : _threshold(threshold), _min_scale(min_scale), _min_history(min_history ? min_history : 1)
+    {
+    }
+
+    void reset() { _window.reset(); }
+
+    // Score of value against the window, then adds it. NAN for a NAN value
+    // and while the window holds fewer than min_history values.
+    float check(float value)
+    {
+        float score = NAN;
+        if (!isnan(value) && _window.size() >= _min_history)
+        {
+            float scale = 1.4826f * _window.mad();
+            if (scale < _min_scale)
+                scale = _min_scale;
+            float deviation = fabsf(value - _window.median());
+            score = scale > 0.0f ? deviation / scale : (deviation > 0.0f ? INFINITY : 0.0f);
+        }
+        _window.add(value);
+        return score;
+    }
+
+    bool isSpike(float score) const { return score > _threshold; } // False for NAN
+    float threshold() const { return _threshold; }
+    const RollingMedian<N> &window() const { return _window; }
+
+private:
+    float _threshold;
+    float _min_scale;
+    size_t _min_history;
+    RollingMedian<N> _window;
+};
+
+#endif // SPIKE_DETECTOR_H
@@ -0,0 +1,160 @@
+#ifndef STREAMING_STATS_H
+#define STREAMING_STATS_H
+
+#include <math.h>
+#include <stdint.h>
+#include "P2Quantile.h"
+
+// Statistics over an unbounded stream in fixed memory, for values that are
+// tracked for the lifetime of the firmware rather than per window (see
+// WindowStats.h for that). All classes ignore NaN values.
+
+// Count, mean, variance (Welford's method), min and max
+class RunningStats
+{
+public:
+    RunningStats() { reset(); }
+
+    void reset()
+    {
+        _count = 0;
+        _mean = 0.0;
+        _m2 = 0.0;
+        _min = INFINITY;
+        _max = -INFINITY;
+    }
+
+    void add(float value)
+    {
+        if (isnan(value))
+            return;
+        _count++;
+        double delta = value - _mean;
+        _mean += delta / _count;
+        _m2 += delta * (value - _mean);
+        if (value < _min)
+            _min = value;
+        if (value > _max)
+            _max = value;
+    }
+
+    // Combines two streams (Chan et al.), e.g. per-task statistics
+    void merge(const RunningStats &other)
+    {
+        if (other._count == 0)
+            return;
+        uint32_t count = _count + other._count;
+        double delta = other._mean - _mean;
+        _m2 += other._m2 + delta * delta * ((double)_count * other._count / count);
+        _mean += delta * other._count / count;
+        _count = count;
+        if (other._min < _min)
+            _min = other._min;
+        if (other._max > _max)
+            _max = other._max;
+    }
+
+    uint32_t count() const { return _count; }
+    float mean() const { return _count ? (float)_mean : NAN; }
+    float min() const { return _count ? _min : NAN; }
+    float max() const { return _count ? _max : NAN; }
+
+    // Sample variance; 0 for a single value
+    float variance() const
+    {
+        if (_count == 0)
+            return NAN;
+        return _count > 1 ? (float)(_m2 / (_count - 1)) : 0.0f;
+    }
+
+    float stddev() const { return sqrtf(variance()); }
+
+private:
+    uint32_t _count;
+    double _mean;
+    double _m2;
+    float _min;
+    float _max;
+};
+
+// Exponentially weighted moving average and variance. alpha is the weight of
+// a new value (0..1]; a smaller alpha smooths more. The first value seeds
+// the average.
+class Ewma
+{
+public:
+    explicit Ewma(float alpha = 0.1f) : _alpha(alpha) { reset(); }
+
+    // alpha for a half-life of the given number of samples
+    static float alphaForHalfLife(float samples) { return 1.0f - expf(-0.69314718f / samples); }
+
+    void reset()
+    {
+        _value = NAN;
+        _variance = 0.0f;
+    }
+
+    void add(float value)
+    {
+        if (isnan(value))
+            return;
+        if (isnan(_value))
+        {
+            _value = value;
+            return;
+        }
+        float delta = value - _value;
+        _value += _alpha * delta;
+        _variance = (1.0f - _alpha) * (_variance + _alpha * delta * delta);
+    }
+
+    float value() const { return _value; }
+    float variance() const { return isnan(_value) ? NAN : _variance; }
+    float stddev() const { return sqrtf(variance()); }
+    float alpha() const { return _alpha; }
+
+private:
+    float _alpha;
+    float _value;
+    float _variance;
+};
+
+// Everything for one channel: running mean/stddev, EWMA, median and p95.
+// About 150 bytes, whatever the stream length.
+class StreamingStats
+{
+public:
+    explicit StreamingStats(float ewma_alpha = 0.1f) : _ewma(ewma_alpha), _median(0.5f), _p95(0.95f) {}
+
+    void reset()
+    {
+        _running.reset();
+        _ewma.reset();
+        _median.reset();
+        _p95.reset();
+    }
+
+    void add(float value)
+    {
+        _running.add(value);
+        _ewma.add(value);
+        _median.add(value);
+        _p95.add(value);
+    }
+
+    const RunningStats &running() const { return _running; }
+    uint32_t count() const { return _running.count(); }
+    float mean() const { return _running.mean(); }
+    float stddev() const { return _running.stddev(); }
+    float ewma() const { return _ewma.value(); }
+    float median() const { return _median.value(); }
+    float p95() const { return _p95.value(); }
+
+private:
+    RunningStats _running;
+    Ewma _ewma;
+    P2Quantile _median;
+    P2Quantile _p95;
+};
+
+#endif // STREAMING_STATS_H
@@ -0,0 +1,92 @@
+#ifndef WINDOW_STATS_H
+#define WINDOW_STATS_H
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <algorithm>
+#include "P2Quantile.h"
+
+// Summary statistics of one value over a window: min, max, mean and
+// standard deviation (Welford's method) over all values, and exact
+// percentiles from the first MaxSamples values. For windows with more values
+// than that, the tracked percentile (p95 by default) comes from a P-square
+// estimate over all of them instead, so it is not biased towards the start
+// of the window; other percentiles still cover only the kept values. NaN
+// values are ignored.
+template <size_t MaxSamples>
+class WindowStats
+{
+public:
+    explicit WindowStats(float tracked = 95.0f) : _tracked(tracked), _estimate(tracked / 100.0f) { reset(); }
+
+    void reset()
+    {
+        _estimate.reset();
+        _count = 0;
+        _kept = 0;
+        _mean = 0.0;
+        _m2 = 0.0;
+        _min = INFINITY;
+        _max = -INFINITY;
+    }
+
+    void add(float value)
+    {
+        if (isnan(value))
+            return;
+        _count++;
+        double delta = value - _mean;
+        _mean += delta / _count;
+        _m2 += delta * (value - _mean);
+        if (value < _min)
+            _min = value;
+        if (value > _max)
+            _max = value;
+        if (_kept < MaxSamples)
+            _values[_kept++] = value;
+        _estimate.add(value);
+    }
+
+    uint32_t count() const { return _count; }
+    bool allKept() const { return _count == _kept; } // Percentiles are exact
+    float min() const { return _count ? _min : NAN; }
+    float max() const { return _count ? _max : NAN; }
+    float mean() const { return _count ? (float)_mean : NAN; }
+
+    // Sample standard deviation; 0 for a single value
+    float stddev() const
+    {
+        if (_count == 0)
+            return NAN;
+        return _count > 1 ? (float)sqrt(_m2 / (_count - 1)) : 0.0f;
+    }
+
+    // Nearest-rank percentile, p in 0..100. Reorders the kept values.
+    float percentile(float p)
+    {
+        if (_kept == 0)
+            return NAN;
+        if (!allKept() && p == _tracked)
+            return _estimate.value();
+        size_t rank = (size_t)ceilf(p / 100.0f * _kept);
+        size_t index = rank > 0 ? rank - 1 : 0;
+        if (index >= _kept)
+            index = _kept - 1;
+        std::nth_element(_values, _values + index, _values + _kept);
+        return _values[index];
+    }
+
+private:
+    float _tracked;
+    P2Quantile _estimate;
+    uint32_t _count;
+    size_t _kept;
+    double _mean;
+    double _m2;
+    float _min;
+    float _max;
+    float _values[MaxSamples];
+};
+
+#endif // WINDOW_STATS_H
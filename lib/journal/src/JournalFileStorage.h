@@ -0,0 +1,82 @@
+#ifndef JOURNAL_FILE_STORAGE_H
+#define JOURNAL_FILE_STORAGE_H
+
+// Storage policy backing SampleJournal with plain files, for running the
+// journal on a host (Linux) build:
+//
+//   SampleJournal<JournalFileStorage> journal{JournalFileStorage(), "/tmp/journal"};
+//   journal.begin();
+
+#include <dirent.h>
+#include <stdio.h>
+#include "SampleJournal.h"
+
+class JournalFileStorage
+{
+public:
+    bool append(const char *path, const uint8_t *data, size_t len)
+    {
+        FILE *file = fopen(path, "ab");
+        if (!file)
+            return false;
+        size_t written = fwrite(data, 1, len, file);
+        return fclose(file) == 0 && written == len;
+    }
+
+    size_t read(const char *path, size_t offset, uint8_t *data, size_t len)
+    {
+        FILE *file = fopen(path, "rb");
+        if (!file)
+            return 0;
+        size_t count = fseek(file, (long)offset, SEEK_SET) == 0 ? fread(data, 1, len, file) : 0;
+        fclose(file);
+        return count;
+    }
+
+    size_t size(const char *path)
+    {
+        FILE *file = fopen(path, "rb");
+        if (!file)
+            return 0;
+        fseek(file, 0, SEEK_END);
+        long bytes = ftell(file);
+        fclose(file);
+        return bytes > 0 ? (size_t)bytes : 0;
+    }
+
+    bool exists(const char *path)
+    {
+        FILE *file = fopen(path, "rb");
+        if (!file)
+            return false;
+        fclose(file);
+        return true;
+    }
+
+    bool remove(const char *path) { return ::remove(path) == 0; }
+
+    void list(const char *dir, void (*visit)(const char *name, void *context), void *context)
+    {
+        DIR *handle = opendir(dir);
+        if (!handle)
+            return;
+        while (struct dirent *entry = readdir(handle))
+            visit(entry->d_name, context);
+        closedir(handle);
+    }
+
+    bool replace(const char *path, const uint8_t *data, size_t len)
+    {
+        char tmp[JOURNAL_PATH_SIZE + 4];
+        snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+        FILE *file = fopen(tmp, "wb");
+        if (!file)
+            return false;
+        size_t written = fwrite(data, 1, len, file);
+        if (fclose(file) != 0 || written != len)
+            return false;
+        return ::rename(tmp, path) == 0;
+    }
+};
+
+#endif // JOURNAL_FILE_STORAGE_H
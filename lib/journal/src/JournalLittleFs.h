@@ -0,0 +1,76 @@
+#ifndef JOURNAL_LITTLEFS_H
+#define JOURNAL_LITTLEFS_H
+
+#include <Arduino.h>
+#include <LittleFS.h>
+#include "SampleJournal.h"
+
+// Storage policy binding SampleJournal to the LittleFS partition. Mount it
+// with LittleFS.begin() and create the journal directory before begin().
+class JournalLittleFsStorage
+{
+public:
+    bool append(const char *path, const uint8_t *data, size_t len)
+    {
+        File file = LittleFS.open(path, FILE_APPEND);
+        if (!file)
+            return false;
+        size_t written = file.write(data, len);
+        file.close();
+        return written == len;
+    }
+
+    size_t read(const char *path, size_t offset, uint8_t *data, size_t len)
+    {
+        if (!LittleFS.exists(path))
+            return 0;
+        File file = LittleFS.open(path, FILE_READ);
+        if (!file || !file.seek(offset))
+            return 0;
+        size_t count = file.read(data, len);
+        file.close();
+        return count;
+    }
+
+    size_t size(const char *path)
+    {
+        if (!LittleFS.exists(path))
+            return 0;
+        File file = LittleFS.open(path, FILE_READ);
+        size_t bytes = file ? file.size() : 0;
+        file.close();
+        return bytes;
+    }
+
+    bool exists(const char *path) { return LittleFS.exists(path); }
+    bool remove(const char *path) { return LittleFS.remove(path); }
+
+    void list(const char *dir, void (*visit)(const char *name, void *context), void *context)
+    {
+        File root = LittleFS.open(dir);
+        if (!root || !root.isDirectory())
+            return;
+        for (File file = root.openNextFile(); file; file = root.openNextFile())
+        {
+            visit(file.name(), context);
+            file.close();
+        }
+        root.close();
+    }
+
+    // Writes a temporary file and renames it over the old one, so a power
+    // loss leaves either the old or the new contents
+    bool replace(const char *path, const uint8_t *data, size_t len)
+    {
+        char tmp[JOURNAL_PATH_SIZE + 4];
+        snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+        File file = LittleFS.open(tmp, FILE_WRITE);
+        if (!file)
+            return false;
+        size_t written = file.write(data, len);
+        file.close();
+        return written == len && LittleFS.rename(tmp, path);
+    }
+};
+
+#endif // JOURNAL_LITTLEFS_H
@@ -0,0 +1,427 @@
+#ifndef SAMPLE_JOURNAL_H
+#define SAMPLE_JOURNAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "OpcN3Crc.h"
+
+// Append-only store-and-forward journal for samples that could not be sent.
+// Records go into numbered segment files of bounded size in one directory;
+// a full journal deletes its oldest segment. Segments are only ever appended
+// to or deleted whole, so the filesystem (LittleFS levels wear across blocks
+// on its own) sees no in-place rewrites apart from the small cursor file.
+//
+// The journal is parameterized over a storage policy providing:
+//
+//   bool append(const char *path, const uint8_t *data, size_t len);
+//   size_t read(const char *path, size_t offset, uint8_t *data, size_t len);
+//   size_t size(const char *path);        // 0 if the file does not exist
+//   bool exists(const char *path);
+//   bool remove(const char *path);
+//   bool replace(const char *path, const uint8_t *data, size_t len); // Atomic
+//   void list(const char *dir, void (*visit)(const char *name, void *context), void *context);
+//
+// JournalLittleFs.h binds it to LittleFS; JournalFileStorage.h to a host
+// directory for running it on Linux. Use a journal from one task only.
+//
+// Record layout: 0xA5, payload length (uint16_t), CRC-16 of the payload
+// (uint16_t), payload. A record torn by a power loss fails the CRC and ends
+// its segment; appending then continues in a fresh segment.
+//
+// The cursor is always saved before sent or evicted segments are deleted, so
+// a power loss in between leaves segments behind the cursor (begin() deletes
+// them) rather than a cursor pointing at a deleted segment.
+
+struct JournalCursor
+{
+    uint32_t segment; // Segment sequence number
+    uint32_t offset;  // Byte offset of the next record in the segment
+};
+
+struct JournalStats
+{
+    uint32_t appended;
+    uint32_t replayed;          // Records committed as sent
+    uint32_t evicted_segments;  // Oldest segments deleted to make room
+    uint32_t evicted_records;
+    uint32_t corrupt_segments;  // Segments cut short by a bad record
+    uint32_t write_errors;
+};
+
+const uint8_t JOURNAL_RECORD_MAGIC = 0xA5;
+const size_t JOURNAL_RECORD_HEADER_SIZE = 5;
+const size_t JOURNAL_PATH_SIZE = 48;
+
+template <class Storage, size_t MaxSegments = 8>
+class SampleJournal
+{
+public:
+    // dir must exist (or be creatable by the storage); segment_bytes bounds
+    // each segment file, so the journal never exceeds MaxSegments of them
+    SampleJournal(const Storage &storage, const char *dir, size_t segment_bytes = 16384);
+
+    Storage &storage() { return _storage; }
+
+    // Restores the journal state from the cursor file and the segments
+    bool begin();
+
+    bool append(const uint8_t *payload, uint16_t len);
+
+    // Replay: start from readCursor(), call next() for each record (it moves
+    // the cursor past the record), then commit() the cursor once the records
+    // were sent. Uncommitted records are replayed again later.
+    JournalCursor readCursor() const { return _read; }
+    bool next(JournalCursor &cursor, uint8_t *payload, size_t max_len, uint16_t &len);
+    bool commit(const JournalCursor &cursor);
+
+    uint32_t pending() const { return _pending; }
+    bool empty() const { return _pending == 0; }
+    const JournalStats &stats() const { return _stats; }
+    size_t segmentCount() const { return _write_segment - _read.segment + 1; }
+
+private:
+    void segmentPath(uint32_t segment, char *path) const;
+    void cursorPath(char *path) const;
+    bool saveCursor();
+    // Lowest segment of the directory, and lowest from the read segment on
+    bool findSegments(uint32_t &lowest, uint32_t &first);
+    static void visitSegment(const char *name, void *context);
+    // Counts the valid records of a segment; returns false if it ends in a bad one
+    bool scanSegment(uint32_t segment, uint32_t from, uint32_t &records, uint32_t &end);
+    bool readRecordHeader(const char *path, uint32_t offset, uint16_t &len, uint16_t &crc);
+    uint16_t &segmentRecords(uint32_t segment) { return _segment_records[segment % MaxSegments]; }
+    void evictOldest();
+
+    Storage _storage;
+    const char *_dir;
+    size_t _segment_bytes;
+
+    JournalCursor _read;        // Oldest unsent record
+    uint32_t _read_index;       // Records already sent from the read segment
+    uint32_t _write_segment;
+    uint32_t _write_size;
+    uint16_t _segment_records[MaxSegments];
+    uint32_t _pending;
+    JournalStats _stats;
+};
+
+template <class Storage, size_t MaxSegments>
+SampleJournal<Storage, MaxSegments>::SampleJournal(const Storage &storage, const char *dir, size_t segment_bytes)
+    : _storage(storage), _dir(dir), _segment_bytes(segment_bytes), _read(), _read_index(0),
+      _write_segment(0), _write_size(0), _pending(0), _stats()
+{
+    memset(_segment_records, 0, sizeof(_segment_records));
+}
+
+template <class Storage, size_t MaxSegments>
+bool SampleJournal<Storage, MaxSegments>::begin()
+{
+    // Cursor file: read segment, read offset, records already sent from it
+    char path[JOURNAL_PATH_SIZE];
+    cursorPath(path);
+    uint32_t saved[3] = {0, 0, 0};
+    if (_storage.read(path, 0, (uint8_t *)saved, sizeof(saved)) != sizeof(saved))
+        memset(saved, 0, sizeof(saved));
+    _read.segment = saved[0];
+    _read.offset = saved[1];
+    _read_index = saved[2];
+    memset(_segment_records, 0, sizeof(_segment_records));
+    _pending = 0;
+
+    // Delete segments left behind the cursor by an interrupted commit() or
+    // eviction. If the read segment is gone (or the cursor file was lost),
+    // resume at the lowest segment there is.
+    uint32_t lowest = 0, first = 0;
+    while (findSegments(lowest, first) && lowest < _read.segment)
+    {
+        segmentPath(lowest, path);
+        if (!_storage.remove(path))
+            break;
+    }
+    if (findSegments(lowest, first) && first != _read.segment)
+    {
+        _read.segment = first;
+        _read.offset = 0;
+        _read_index = 0;
+        saveCursor();
+    }
+
+    // Segments are numbered consecutively from the read segment
+    uint32_t segment = _read.segment;
+    bool clean = true;
+    _write_segment = segment;
+    _write_size = 0;
+    for (size_t i = 0; i < MaxSegments; i++, segment++)
+    {
+        segmentPath(segment, path);
+        if (!_storage.exists(path))
+            break;
+        uint32_t records = 0, end = 0;
+        clean = scanSegment(segment, 0, records, end);
+        segmentRecords(segment) = (uint16_t)records;
+        _pending += records;
+        _write_segment = segment;
+        _write_size = end;
+    }
+    _pending -= _read_index < _pending ? _read_index : _pending;
+
+    // Never append behind a torn record; it would be unreachable
+    if (!clean)
+    {
+        _stats.corrupt_segments++;
+        _write_segment++;
+        _write_size = 0;
+        if (segmentCount() > MaxSegments)
+            evictOldest();
+    }
+    return true;
+}
+
+template <class Storage, size_t MaxSegments>
+bool SampleJournal<Storage, MaxSegments>::append(const uint8_t *payload, uint16_t len)
+{
+    size_t record_size = JOURNAL_RECORD_HEADER_SIZE + len;
+    if (record_size > _segment_bytes)
+        return false;
+
+    if (_write_size + record_size > _segment_bytes)
+    {
+        _write_segment++;
+        _write_size = 0;
+        if (segmentCount() > MaxSegments)
+            evictOldest(); // Shares its record counter slot with the new segment
+        segmentRecords(_write_segment) = 0;
+    }
+
+    uint8_t header[JOURNAL_RECORD_HEADER_SIZE];
+    uint16_t crc = OpcN3Crc16::compute(payload, len);
+    header[0] = JOURNAL_RECORD_MAGIC;
+    memcpy(header + 1, &len, sizeof(len));
+    memcpy(header + 3, &crc, sizeof(crc));
+
+    char path[JOURNAL_PATH_SIZE];
+    segmentPath(_write_segment, path);
+    if (!_storage.append(path, header, sizeof(header)) || !_storage.append(path, payload, len))
+    {
+        // Whatever made it to flash fails the CRC; continue in a new segment
+        _stats.write_errors++;
+        _write_size = _segment_bytes;
+        return false;
+    }
+
+    _write_size += record_size;
+    segmentRecords(_write_segment)++;
+    _pending++;
+    _stats.appended++;
+    return true;
+}
+
+template <class Storage, size_t MaxSegments>
+bool SampleJournal<Storage, MaxSegments>::next(JournalCursor &cursor, uint8_t *payload, size_t max_len, uint16_t &len)
+{
+    char path[JOURNAL_PATH_SIZE];
+    while (cursor.segment <= _write_segment)
+    {
+        segmentPath(cursor.segment, path);
+        size_t size = _storage.size(path);
+        uint16_t crc = 0;
+        if (cursor.offset < size && readRecordHeader(path, cursor.offset, len, crc) &&
+            cursor.offset + JOURNAL_RECORD_HEADER_SIZE + len <= size)
+        {
+            uint32_t offset = cursor.offset + JOURNAL_RECORD_HEADER_SIZE;
+            cursor.offset = offset + len;
+            if (len <= max_len && _storage.read(path, offset, payload, len) == len &&
+                OpcN3Crc16::compute(payload, len) == crc)
+            {
+                return true;
+            }
+            continue; // Skip a damaged or oversized record
+        }
+        // End of this segment, or a torn record: move on to the next one
+        if (cursor.segment == _write_segment)
+            return false;
+        cursor.segment++;
+        cursor.offset = 0;
+    }
+    return false;
+}
+
+template <class Storage, size_t MaxSegments>
+bool SampleJournal<Storage, MaxSegments>::commit(const JournalCursor &cursor)
+{
+    char path[JOURNAL_PATH_SIZE];
+
+    // Skip the segments that were sent completely; they are deleted once
+    // the new cursor is saved
+    uint32_t sent = _read.segment;
+    while (_read.segment < cursor.segment)
+    {
+        uint32_t remaining = segmentRecords(_read.segment) - _read_index;
+        _pending -= remaining < _pending ? remaining : _pending;
+        _stats.replayed += remaining;
+        segmentRecords(_read.segment) = 0;
+        _read.segment++;
+        _read.offset = 0;
+        _read_index = 0;
+    }
+
+    // Count the records sent from the current read segment
+    if (cursor.segment == _read.segment && cursor.offset > _read.offset)
+    {
+        uint32_t records = 0;
+        segmentPath(_read.segment, path);
+        uint32_t offset = _read.offset;
+        uint16_t len = 0, crc = 0;
+        while (offset < cursor.offset && readRecordHeader(path, offset, len, crc))
+        {
+            offset += JOURNAL_RECORD_HEADER_SIZE + len;
+            records++;
+        }
+        _read.offset = cursor.offset;
+        _read_index += records;
+        _pending -= records < _pending ? records : _pending;
+        _stats.replayed += records;
+    }
+    if (!saveCursor())
+        return false; // Keep the segments; begin() deletes them after a restart
+    for (; sent < _read.segment; sent++)
+    {
+        segmentPath(sent, path);
+        _storage.remove(path);
+    }
+    return true;
+}
+
+// --- Private Methods ---
+
+template <class Storage, size_t MaxSegments>
+void SampleJournal<Storage, MaxSegments>::segmentPath(uint32_t segment, char *path) const
+{
+    snprintf(path, JOURNAL_PATH_SIZE, "%s/%08lx.jnl", _dir, (unsigned long)segment);
+}
+
+template <class Storage, size_t MaxSegments>
+void SampleJournal<Storage, MaxSegments>::cursorPath(char *path) const
+{
+    snprintf(path, JOURNAL_PATH_SIZE, "%s/cursor", _dir);
+}
+
+template <class Storage, size_t MaxSegments>
+bool SampleJournal<Storage, MaxSegments>::saveCursor()
+{
+    char path[JOURNAL_PATH_SIZE];
+    cursorPath(path);
+    uint32_t saved[3] = {_read.segment, _read.offset, _read_index};
+    return _storage.replace(path, (const uint8_t *)saved, sizeof(saved));
+}
+
+// Directory scan state for findSegments()
+struct JournalSegmentScan
+{
+    uint32_t read_segment;
+    uint32_t lowest;
+    uint32_t first;
+    bool any;
+    bool any_first;
+};
+
+template <class Storage, size_t MaxSegments>
+void SampleJournal<Storage, MaxSegments>::visitSegment(const char *name, void *context)
+{
+    // Storages may pass full paths or bare names
+    const char *slash = strrchr(name, '/');
+    if (slash)
+        name = slash + 1;
+    unsigned long segment = 0;
+    char extension[5] = {0};
+    if (strlen(name) != 12 || sscanf(name, "%8lx.%4s", &segment, extension) != 2 || strcmp(extension, "jnl") != 0)
+        return;
+
+    JournalSegmentScan &scan = *(JournalSegmentScan *)context;
+    if (!scan.any || segment < scan.lowest)
+        scan.lowest = (uint32_t)segment;
+    if (segment >= scan.read_segment && (!scan.any_first || segment < scan.first))
+    {
+        scan.first = (uint32_t)segment;
+        scan.any_first = true;
+    }
+    scan.any = true;
+}
+
+template <class Storage, size_t MaxSegments>
+bool SampleJournal<Storage, MaxSegments>::findSegments(uint32_t &lowest, uint32_t &first)
+{
+    JournalSegmentScan scan = {_read.segment, 0, 0, false, false};
+    _storage.list(_dir, &SampleJournal::visitSegment, &scan);
+    lowest = scan.lowest;
+    first = scan.any_first ? scan.first : _read.segment;
+    return scan.any;
+}
+
+template <class Storage, size_t MaxSegments>
+bool SampleJournal<Storage, MaxSegments>::readRecordHeader(const char *path, uint32_t offset, uint16_t &len, uint16_t &crc)
+{
+    uint8_t header[JOURNAL_RECORD_HEADER_SIZE];
+    if (_storage.read(path, offset, header, sizeof(header)) != sizeof(header) || header[0] != JOURNAL_RECORD_MAGIC)
+        return false;
+    memcpy(&len, header + 1, sizeof(len));
+    memcpy(&crc, header + 3, sizeof(crc));
+    return true;
+}
+
+template <class Storage, size_t MaxSegments>
+bool SampleJournal<Storage, MaxSegments>::scanSegment(uint32_t segment, uint32_t from, uint32_t &records, uint32_t &end)
+{
+    char path[JOURNAL_PATH_SIZE];
+    segmentPath(segment, path);
+    size_t size = _storage.size(path);
+    uint8_t payload[256];
+    records = 0;
+    end = from;
+    while (end < size)
+    {
+        uint16_t len = 0, crc = 0;
+        if (!readRecordHeader(path, end, len, crc) || end + JOURNAL_RECORD_HEADER_SIZE + len > size)
+            return false;
+
+        // Verify the CRC in chunks; payloads can be larger than the buffer
+        OpcN3Crc16 check;
+        for (uint32_t done = 0; done < len;)
+        {
+            size_t chunk = len - done < sizeof(payload) ? len - done : sizeof(payload);
+            if (_storage.read(path, end + JOURNAL_RECORD_HEADER_SIZE + done, payload, chunk) != chunk)
+                return false;
+            check.update(payload, chunk);
+            done += chunk;
+        }
+        if (check.value() != crc)
+            return false;
+
+        end += JOURNAL_RECORD_HEADER_SIZE + len;
+        records++;
+    }
+    return true;
+}
+
+template <class Storage, size_t MaxSegments>
+void SampleJournal<Storage, MaxSegments>::evictOldest()
+{
+    char path[JOURNAL_PATH_SIZE];
+    uint32_t lost = segmentRecords(_read.segment) - _read_index;
+    _pending -= lost < _pending ? lost : _pending;
+    _stats.evicted_records += lost;
+    _stats.evicted_segments++;
+
+    uint32_t evicted = _read.segment;
+    segmentRecords(evicted) = 0;
+    _read.segment++;
+    _read.offset = 0;
+    _read_index = 0;
+    saveCursor();
+    segmentPath(evicted, path);
+    _storage.remove(path);
+}
+
+#endif // SAMPLE_JOURNAL_H
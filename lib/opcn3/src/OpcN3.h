@@ -3,66 +3,49 @@
 
 #include <Arduino.h>
 #include <SPI.h>
+#include "OpcN3Driver.h"
 
-// Data structure to hold all the readings from the OPC-N3
-struct OpcN3Data
+// Bus policy binding OpcN3Driver to the global Arduino SPI object. Every
+// method is a thin inline forward, so the driver compiles to direct calls.
+class OpcN3ArduinoSpiBus
 {
-    // Histogram Data
-    // The OPC-N3 reports 24 histogram bins
-    uint16_t bin_counts[24];
-    float bin_boundaries_um[25];
-
-    // MToF (Time-of-Flight for specific bins)
-    uint8_t bin1_mtof, bin3_mtof, bin5_mtof, bin7_mtof;
+public:
+    static const uint32_t SPI_CLOCK_SPEED = 500000;
 
-    // Converted Values
-    float sampling_period_s, sample_flow_rate_ml_s, temperature_c, humidity_rh;
+    OpcN3ArduinoSpiBus(int ss_pin) : _ss_pin(ss_pin), _spi_settings(SPI_CLOCK_SPEED, MSBFIRST, SPI_MODE1) {}
 
-    // PM Values
-    float pm_a, pm_b, pm_c;
+    void begin()
+    {
+        pinMode(_ss_pin, OUTPUT);
+        digitalWrite(_ss_pin, HIGH);
+    }
 
-    // Status and Error Values
-    uint16_t reject_count_glitch, reject_count_long_tof, reject_count_ratio;
-    uint16_t fan_rev_count, laser_status;
+    void beginTransaction() { SPI.beginTransaction(_spi_settings); }
+    void endTransaction() { SPI.endTransaction(); }
+    void select() { digitalWrite(_ss_pin, LOW); }
+    void deselect() { digitalWrite(_ss_pin, HIGH); }
+    uint8_t transfer(uint8_t out) { return SPI.transfer(out); }
+    void transfer(uint8_t *buffer, size_t len) { SPI.transfer(buffer, len); }
 
-    // Checksum
-    uint16_t received_checksum;
-    bool checksum_ok;
-};
-
-class OpcN3
-{
-public:
-    OpcN3(int ss_pin);
+    unsigned long millis() { return ::millis(); }
+    unsigned long micros() { return ::micros(); }
+    void delayMs(unsigned long ms) { ::delay(ms); }
+    void delayUs(unsigned int us) { ::delayMicroseconds(us); }
 
-    // Initializes the sensor (SPI, connection check, power on, config read, set default period)
-    bool begin();
+    template <typename... Args>
+    void log(const char *format, Args... args) { Serial.printf(format, args...); }
 
-    // Reads the latest histogram data from the sensor
-    bool readData(OpcN3Data &data);
+    int ssPin() const { return _ss_pin; }
 
 private:
-    // --- Pin and SPI settings ---
     int _ss_pin;
     SPISettings _spi_settings;
+};
 
-    // --- Internal state ---
-    uint8_t _config_vars[168]; // Buffer to hold the full configuration variables
-
-    // --- Helper methods for SPI communication ---
-    bool waitForReady(uint8_t cmd, int timeout_ms = 500);
-    bool sendCommandWithData(uint8_t cmd, uint8_t data);
-
-    // --- Helper methods for sensor control ---
-    bool powerControl(uint8_t option);
-    bool checkConnection();
-    bool readConfiguration();
-    bool writeConfiguration(); // NEW: Writes the configuration variables back to the sensor
+// The OPC-N3 driver as used by the firmware: OpcN3 opc(OPC_SS_PIN);
+typedef OpcN3Driver<OpcN3ArduinoSpiBus> OpcN3;
 
-    // --- Helper methods for data processing ---
-    uint16_t crc16_calc(const uint8_t *data, size_t len);
-    uint16_t combine_bytes(uint8_t lsb, uint8_t msb);
-    float bytes_to_float(uint8_t b0, uint8_t b1, uint8_t b2, uint8_t b3);
-};
+// Instantiated once in OpcN3.cpp
+extern template class OpcN3Driver<OpcN3ArduinoSpiBus>;
 
-#endif // OPCN3_H
\ No newline at end of file
+#endif // OPCN3_H
@@ -0,0 +1,90 @@
+#ifndef OPCN3_ACCUMULATOR_H
+#define OPCN3_ACCUMULATOR_H
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include "OpcN3Frame.h"
+
+// Sums histograms together with the air volume they were counted in (sample
+// flow rate x sampling period), so bin counts can be turned into number
+// concentrations over any window: particles per cm^3 (= per mL) is the
+// summed count divided by the summed volume. Raw counts of intervals with
+// different lengths or flow rates are not comparable; concentrations are.
+// Memory use is fixed, however many histograms are added.
+class OpcN3Accumulator
+{
+public:
+    static const int BIN_COUNT = 24;
+
+    OpcN3Accumulator() { reset(); }
+
+    void reset()
+    {
+        memset(_counts, 0, sizeof(_counts));
+        _volume_ml = 0.0;
+        _seconds = 0.0;
+        _samples = 0;
+    }
+
+    // Adds one histogram. Histograms without a usable flow rate or sampling
+    // period cannot be normalized and are ignored (returns false).
+    bool add(const OpcN3Data &data)
+    {
+        float volume = data.sample_flow_rate_ml_s * data.sampling_period_s;
+        if (!(data.sample_flow_rate_ml_s > 0.0f) || !(data.sampling_period_s > 0.0f) || !isfinite(volume))
+            return false;
+        for (int i = 0; i < BIN_COUNT; i++)
+            _counts[i] += data.bin_counts[i];
+        _volume_ml += volume;
+        _seconds += data.sampling_period_s;
+        _samples++;
+        return true;
+    }
+
+    // Combines two windows, e.g. per-minute accumulators into an hour
+    void merge(const OpcN3Accumulator &other)
+    {
+        for (int i = 0; i < BIN_COUNT; i++)
+            _counts[i] += other._counts[i];
+        _volume_ml += other._volume_ml;
+        _seconds += other._seconds;
+        _samples += other._samples;
+    }
+
+    uint32_t samples() const { return _samples; }
+    float sampledVolumeMl() const { return (float)_volume_ml; }
+    float sampledSeconds() const { return (float)_seconds; }
+    uint32_t count(int bin) const { return _counts[bin]; }
+
+    // Sum of bins first..last (inclusive)
+    uint32_t count(int first, int last) const
+    {
+        uint32_t total = 0;
+        for (int i = first; i <= last; i++)
+            total += _counts[i];
+        return total;
+    }
+
+    // Particles per cm^3 in one bin or bins first..last; NAN without volume
+    float concentration(int bin) const { return _volume_ml > 0.0 ? (float)(_counts[bin] / _volume_ml) : NAN; }
+    float concentration(int first, int last) const
+    {
+        return _volume_ml > 0.0 ? (float)(count(first, last) / _volume_ml) : NAN;
+    }
+
+    void concentrations(float *out) const
+    {
+        float scale = _volume_ml > 0.0 ? (float)(1.0 / _volume_ml) : NAN;
+        for (int i = 0; i < BIN_COUNT; i++)
+            out[i] = _counts[i] * scale;
+    }
+
+private:
+    uint32_t _counts[BIN_COUNT];
+    double _volume_ml;
+    double _seconds;
+    uint32_t _samples;
+};
+
+#endif // OPCN3_ACCUMULATOR_H
@@ -0,0 +1,229 @@
+#ifndef OPCN3_BUS_MANAGER_H
+#define OPCN3_BUS_MANAGER_H
+
+#include "OpcN3Driver.h"
+
+// Drives several OPC-N3 sensors that share one SPI bus on distinct /SS pins:
+//
+//   OpcN3 inlet(OPC_SS_PIN), outlet(OPC_SS_PIN_2);
+//   OpcN3BusManager<OpcN3ArduinoSpiBus> opcs;
+//   opcs.addDevice(inlet);
+//   opcs.addDevice(outlet);
+//   opcs.begin();
+//   ...
+//   opcs.service();                // From loop(), never blocks
+//   if (opcs.takeData(0, data)) { ... }
+//
+// Every device runs its own non-blocking startRead()/poll() handshake, and
+// service() visits the devices round-robin. While one sensor answers busy,
+// the bus is free to poll or transfer a frame from another, so N sensors
+// take about as long per cycle as the slowest one rather than the sum.
+// All devices must be serviced from the same task.
+template <class Bus, size_t MaxDevices = 4>
+class OpcN3BusManager
+{
+public:
+    typedef OpcN3Driver<Bus> Device;
+
+    struct DeviceStats
+    {
+        uint32_t reads_ok;
+        uint32_t reads_failed;        // Handshake timeouts and CRC errors
+        uint64_t bus_time_us;         // Bus time of all received frames
+        uint32_t last_latency_ms;     // startRead() to frame received
+        uint32_t max_latency_ms;
+        unsigned long first_start_ms; // First read started
+        unsigned long last_ok_ms;     // Last frame received
+    };
+
+    OpcN3BusManager() : _count(0), _next(0), _read_interval_ms(1000) {}
+
+    // Registers a device; returns its index, or -1 if MaxDevices is reached
+    int addDevice(Device &device);
+    size_t deviceCount() const { return _count; }
+    Device &device(size_t index) { return *_slots[index].device; }
+
+    // Initializes all devices concurrently, so their power-up and settle
+    // delays overlap. Returns true if every device came up; devices that
+    // failed are skipped by service() (see deviceReady()).
+    bool begin();
+    bool deviceReady(size_t index) const { return index < _count && _slots[index].ready; }
+
+    // Time between the starts of two reads of the same device. This is the
+    // histogram period, since each read resets the sensor's histogram.
+    void setReadIntervalMs(unsigned long ms) { _read_interval_ms = ms; }
+
+    // Advances every device's read by at most one poll or frame transfer
+    void service();
+
+    // Copies the newest sample of a device; returns false if none arrived
+    // since the previous call
+    bool takeData(size_t index, OpcN3Data &data);
+
+    const DeviceStats &stats(size_t index) const { return _slots[index].stats; }
+    uint32_t crcErrorCount(size_t index) { return _slots[index].device->crcErrorCount(); }
+
+    // Successfully received frames per minute since the first read started
+    float readsPerMinute(size_t index) const;
+
+private:
+    struct Slot
+    {
+        Device *device;
+        bool ready;
+        bool reading;
+        bool fresh;
+        unsigned long start_ms;
+        unsigned long next_start_ms;
+        OpcN3Data data;
+        DeviceStats stats;
+    };
+
+    Bus &clock() { return _slots[0].device->bus(); }
+    void serviceSlot(Slot &slot, unsigned long now);
+
+    Slot _slots[MaxDevices];
+    size_t _count;
+    size_t _next; // Device visited first by the next service() call
+    unsigned long _read_interval_ms;
+};
+
+template <class Bus, size_t MaxDevices>
+int OpcN3BusManager<Bus, MaxDevices>::addDevice(Device &device)
+{
+    if (_count >= MaxDevices)
+        return -1;
+
+    Slot &slot = _slots[_count];
+    memset(&slot, 0, sizeof(slot));
+    slot.device = &device;
+    return (int)_count++;
+}
+
+template <class Bus, size_t MaxDevices>
+bool OpcN3BusManager<Bus, MaxDevices>::begin()
+{
+    OpcN3Types::BeginStatus status[MaxDevices];
+    for (size_t i = 0; i < _count; i++)
+    {
+        _slots[i].device->startBegin();
+        status[i] = OpcN3Types::BEGIN_PENDING;
+    }
+
+    size_t pending = _count;
+    while (pending > 0)
+    {
+        for (size_t i = 0; i < _count; i++)
+        {
+            if (status[i] != OpcN3Types::BEGIN_PENDING)
+                continue;
+            status[i] = _slots[i].device->pollBegin();
+            if (status[i] != OpcN3Types::BEGIN_PENDING)
+                pending--;
+        }
+        if (pending > 0)
+            clock().delayMs(1);
+    }
+
+    bool all_ready = true;
+    unsigned long now = clock().millis();
+    for (size_t i = 0; i < _count; i++)
+    {
+        _slots[i].ready = status[i] == OpcN3Types::BEGIN_OK;
+        _slots[i].next_start_ms = now;
+        if (!_slots[i].ready)
+        {
+            clock().log("ERROR: OPC-N3 #%u failed to initialize and will be skipped.\n", (unsigned)i);
+            all_ready = false;
+        }
+    }
+    return all_ready;
+}
+
+template <class Bus, size_t MaxDevices>
+void OpcN3BusManager<Bus, MaxDevices>::service()
+{
+    if (_count == 0)
+        return;
+
+    unsigned long now = clock().millis();
+    for (size_t k = 0; k < _count; k++)
+        serviceSlot(_slots[(_next + k) % _count], now);
+
+    // Rotate the starting device so no sensor is always served last
+    _next = (_next + 1) % _count;
+}
+
+template <class Bus, size_t MaxDevices>
+void OpcN3BusManager<Bus, MaxDevices>::serviceSlot(Slot &slot, unsigned long now)
+{
+    if (!slot.ready)
+        return;
+
+    if (!slot.reading)
+    {
+        if ((long)(now - slot.next_start_ms) < 0)
+            return; // Not due yet
+        if (!slot.device->startRead())
+            return;
+        if (slot.stats.reads_ok == 0 && slot.stats.reads_failed == 0)
+            slot.stats.first_start_ms = now;
+        slot.reading = true;
+        slot.start_ms = now;
+        return;
+    }
+
+    OpcN3Data data;
+    OpcN3Types::ReadStatus status = slot.device->poll(data);
+    if (status == OpcN3Types::READ_PENDING)
+        return;
+    slot.reading = false;
+
+    unsigned long done_ms = clock().millis();
+    if (status == OpcN3Types::READ_OK)
+    {
+        DeviceStats &stats = slot.stats;
+        stats.reads_ok++;
+        stats.bus_time_us += slot.device->lastBusTimeUs();
+        stats.last_latency_ms = done_ms - slot.start_ms;
+        if (stats.last_latency_ms > stats.max_latency_ms)
+            stats.max_latency_ms = stats.last_latency_ms;
+        stats.last_ok_ms = done_ms;
+        slot.data = data;
+        slot.fresh = true;
+
+        // Schedule from the previous start so the histogram period stays even
+        slot.next_start_ms = slot.start_ms + _read_interval_ms;
+        if ((long)(done_ms - slot.next_start_ms) > 0)
+            slot.next_start_ms = done_ms;
+    }
+    else
+    {
+        // Give the sensor time to recover before the next command
+        slot.stats.reads_failed++;
+        slot.next_start_ms = done_ms + opcn3::DELAY_CMD_RECOVERY_MS;
+    }
+}
+
+template <class Bus, size_t MaxDevices>
+bool OpcN3BusManager<Bus, MaxDevices>::takeData(size_t index, OpcN3Data &data)
+{
+    if (index >= _count || !_slots[index].fresh)
+        return false;
+
+    data = _slots[index].data;
+    _slots[index].fresh = false;
+    return true;
+}
+
+template <class Bus, size_t MaxDevices>
+float OpcN3BusManager<Bus, MaxDevices>::readsPerMinute(size_t index) const
+{
+    const DeviceStats &stats = _slots[index].stats;
+    unsigned long elapsed_ms = stats.last_ok_ms - stats.first_start_ms;
+    if (stats.reads_ok == 0 || elapsed_ms == 0)
+        return 0.0f;
+    return stats.reads_ok * 60000.0f / elapsed_ms;
+}
+
+#endif // OPCN3_BUS_MANAGER_H
@@ -0,0 +1,300 @@
+#ifndef OPCN3_CODEC_H
+#define OPCN3_CODEC_H
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "OpcN3Frame.h"
+
+// Compact binary records for OpcN3Data, for queues, flash journals and serial
+// links. A record is
+//
+//   header   bits 0-3 format version, bit 4 delta record, bit 5 checksum_ok
+//   seq      uint8_t, increments per record
+//   fields   varints, in the order of OpcN3Data
+//
+// Bin counts and status counters are unsigned varints in a keyframe and
+// zig-zag varints of the difference to the previous record in a delta
+// record. Floats travel as fixed-point hundredths (0.01 s, 0.01 mL/s,
+// 0.01 C, 0.01 %RH, 0.01 ug/m3), which is the resolution the sensor reports
+// them in; values beyond +-10,737,418 are clamped and NaN is kept as NaN.
+// A typical keyframe takes 50-70 bytes, a delta record of a steady signal
+// 35-45, compared with about 100 bytes in RAM.
+//
+// received_checksum is not carried; decoded records report it as 0.
+
+namespace opcn3_codec
+{
+    const uint8_t FORMAT_VERSION = 1;
+    const uint8_t FLAG_DELTA = 0x10;
+    const uint8_t FLAG_CHECKSUM_OK = 0x20;
+
+    // Worst case: header and seq, 34 integer fields of up to 16 bits (3 bytes
+    // even as deltas) and 7 fixed-point fields of up to 5 bytes
+    const size_t MAX_RECORD_SIZE = 2 + 34 * 3 + 7 * 5;
+
+    inline uint32_t zigzag(int32_t value) { return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31); }
+    inline int32_t unzigzag(uint32_t value) { return (int32_t)(value >> 1) ^ -(int32_t)(value & 1); }
+
+    // Fixed-point hundredths are clamped to +-FIXED_MAX, so that the delta of
+    // any two of them (and of FIXED_NAN, which stands for NaN) fits an int32_t
+    const int32_t FIXED_MAX = 0x3FFFFFFF;
+    const int32_t FIXED_NAN = -FIXED_MAX - 1;
+
+    inline int32_t toFixed(float value)
+    {
+        if (isnan(value))
+            return FIXED_NAN;
+        float scaled = value * 100.0f;
+        if (scaled >= (float)FIXED_MAX)
+            return FIXED_MAX;
+        if (scaled <= -(float)FIXED_MAX)
+            return -FIXED_MAX;
+        return (int32_t)lroundf(scaled);
+    }
+
+    inline float fromFixed(int32_t value) { return value == FIXED_NAN ? NAN : value / 100.0f; }
+
+    // LEB128 writer/reader over a fixed buffer; ok() turns false on overflow
+    class Writer
+    {
+    public:
+        Writer(uint8_t *out, size_t size) : _out(out), _size(size), _pos(0), _ok(true) {}
+
+        void byte(uint8_t value)
+        {
+            if (_pos < _size)
+                _out[_pos++] = value;
+            else
+                _ok = false;
+        }
+
+        void varint(uint32_t value)
+        {
+            while (value >= 0x80)
+            {
+                byte((uint8_t)(value | 0x80));
+                value >>= 7;
+            }
+            byte((uint8_t)value);
+        }
+
+        void svarint(int32_t value) { varint(zigzag(value)); }
+
+        bool ok() const { return _ok; }
+        size_t length() const { return _pos; }
+
+    private:
+        uint8_t *_out;
+        size_t _size;
+        size_t _pos;
+        bool _ok;
+    };
+
+    class Reader
+    {
+    public:
+        Reader(const uint8_t *in, size_t len) : _in(in), _len(len), _pos(0), _ok(true) {}
+
+        uint8_t byte()
+        {
+            if (_pos < _len)
+                return _in[_pos++];
+            _ok = false;
+            return 0;
+        }
+
+        uint32_t varint()
+        {
+            uint32_t value = 0;
+            for (int shift = 0; shift < 35; shift += 7)
+            {
+                uint8_t b = byte();
+                value |= (uint32_t)(b & 0x7F) << shift;
+                if (!(b & 0x80))
+                    return value;
+            }
+            _ok = false; // Longer than 5 bytes
+            return 0;
+        }
+
+        int32_t svarint() { return unzigzag(varint()); }
+
+        bool ok() const { return _ok; }
+        size_t position() const { return _pos; }
+
+    private:
+        const uint8_t *_in;
+        size_t _len;
+        size_t _pos;
+        bool _ok;
+    };
+
+    // Integer view of the coded fields, in record order
+    const int FIELD_COUNT = 24 + 1 + 4 + 4 + 3 + 5;
+
+    inline void toFields(const OpcN3Data &data, int32_t *fields)
+    {
+        int n = 0;
+        for (int i = 0; i < 24; i++)
+            fields[n++] = data.bin_counts[i];
+        fields[n++] = data.config_version;
+        fields[n++] = data.bin1_mtof;
+        fields[n++] = data.bin3_mtof;
+        fields[n++] = data.bin5_mtof;
+        fields[n++] = data.bin7_mtof;
+        fields[n++] = toFixed(data.sampling_period_s);
+        fields[n++] = toFixed(data.sample_flow_rate_ml_s);
+        fields[n++] = toFixed(data.temperature_c);
+        fields[n++] = toFixed(data.humidity_rh);
+        fields[n++] = toFixed(data.pm_a);
+        fields[n++] = toFixed(data.pm_b);
+        fields[n++] = toFixed(data.pm_c);
+        fields[n++] = data.reject_count_glitch;
+        fields[n++] = data.reject_count_long_tof;
+        fields[n++] = data.reject_count_ratio;
+        fields[n++] = data.fan_rev_count;
+        fields[n++] = data.laser_status;
+    }
+
+    inline void fromFields(const int32_t *fields, OpcN3Data &data)
+    {
+        int n = 0;
+        for (int i = 0; i < 24; i++)
+            data.bin_counts[i] = (uint16_t)fields[n++];
+        data.config_version = (uint16_t)fields[n++];
+        data.bin1_mtof = (uint8_t)fields[n++];
+        data.bin3_mtof = (uint8_t)fields[n++];
+        data.bin5_mtof = (uint8_t)fields[n++];
+        data.bin7_mtof = (uint8_t)fields[n++];
+        data.sampling_period_s = fromFixed(fields[n++]);
+        data.sample_flow_rate_ml_s = fromFixed(fields[n++]);
+        data.temperature_c = fromFixed(fields[n++]);
+        data.humidity_rh = fromFixed(fields[n++]);
+        data.pm_a = fromFixed(fields[n++]);
+        data.pm_b = fromFixed(fields[n++]);
+        data.pm_c = fromFixed(fields[n++]);
+        data.reject_count_glitch = (uint16_t)fields[n++];
+        data.reject_count_long_tof = (uint16_t)fields[n++];
+        data.reject_count_ratio = (uint16_t)fields[n++];
+        data.fan_rev_count = (uint16_t)fields[n++];
+        data.laser_status = (uint16_t)fields[n++];
+    }
+
+    // Fields before FIRST_SIGNED_FIELD are unsigned in keyframes; the
+    // fixed-point values can be negative (temperature) and are always zig-zag
+    // coded
+    const int FIRST_SIGNED_FIELD = 24 + 1 + 4;
+    const int LAST_SIGNED_FIELD = FIRST_SIGNED_FIELD + 7;
+}
+
+// Encodes a stream of samples. Every keyframe_interval-th record (and the
+// first) is a keyframe that decodes on its own; the others are deltas
+// against the previous record. Use an interval of 1 where records may be
+// lost or read out of order, e.g. in a journal that evicts old segments.
+class OpcN3RecordEncoder
+{
+public:
+    explicit OpcN3RecordEncoder(uint16_t keyframe_interval = 32)
+        : _keyframe_interval(keyframe_interval ? keyframe_interval : 1), _since_keyframe(0), _seq(0), _has_previous(false)
+    {
+        memset(_previous, 0, sizeof(_previous));
+    }
+
+    // Makes the next record a keyframe
+    void reset() { _has_previous = false; }
+
+    // Returns the record length, or 0 if it did not fit into size bytes
+    size_t encode(const OpcN3Data &data, uint8_t *out, size_t size)
+    {
+        using namespace opcn3_codec;
+        int32_t fields[FIELD_COUNT];
+        toFields(data, fields);
+
+        bool delta = _has_previous && _since_keyframe < _keyframe_interval;
+        Writer writer(out, size);
+        writer.byte((uint8_t)(FORMAT_VERSION | (delta ? FLAG_DELTA : 0) | (data.checksum_ok ? FLAG_CHECKSUM_OK : 0)));
+        writer.byte(_seq);
+        for (int i = 0; i < FIELD_COUNT; i++)
+        {
+            bool is_signed = i >= FIRST_SIGNED_FIELD && i < LAST_SIGNED_FIELD;
+            if (delta)
+                writer.svarint(fields[i] - _previous[i]);
+            else if (is_signed)
+                writer.svarint(fields[i]);
+            else
+                writer.varint((uint32_t)fields[i]);
+        }
+        if (!writer.ok())
+            return 0;
+
+        memcpy(_previous, fields, sizeof(_previous));
+        _has_previous = true;
+        _since_keyframe = delta ? _since_keyframe + 1 : 1;
+        _seq++;
+        return writer.length();
+    }
+
+private:
+    uint16_t _keyframe_interval;
+    uint16_t _since_keyframe;
+    uint8_t _seq;
+    bool _has_previous;
+    int32_t _previous[opcn3_codec::FIELD_COUNT];
+};
+
+// Decodes records produced by OpcN3RecordEncoder, in order. A delta record
+// is only accepted directly after the record it refers to.
+class OpcN3RecordDecoder
+{
+public:
+    OpcN3RecordDecoder() : _expected_seq(0), _has_previous(false) { memset(_previous, 0, sizeof(_previous)); }
+
+    void reset() { _has_previous = false; }
+
+    // Returns the number of bytes consumed, or 0 for a malformed record, an
+    // unknown format version or a delta without its base record
+    size_t decode(const uint8_t *in, size_t len, OpcN3Data &data)
+    {
+        using namespace opcn3_codec;
+        Reader reader(in, len);
+        uint8_t header = reader.byte();
+        uint8_t seq = reader.byte();
+        if (!reader.ok() || (header & 0x0F) != FORMAT_VERSION)
+            return 0;
+        bool delta = header & FLAG_DELTA;
+        if (delta && (!_has_previous || seq != _expected_seq))
+            return 0;
+
+        int32_t fields[FIELD_COUNT];
+        for (int i = 0; i < FIELD_COUNT; i++)
+        {
+            bool is_signed = i >= FIRST_SIGNED_FIELD && i < LAST_SIGNED_FIELD;
+            if (delta)
+                fields[i] = _previous[i] + reader.svarint();
+            else if (is_signed)
+                fields[i] = reader.svarint();
+            else
+                fields[i] = (int32_t)reader.varint();
+        }
+        if (!reader.ok())
+            return 0;
+
+        memset(&data, 0, sizeof(data));
+        fromFields(fields, data);
+        data.checksum_ok = header & FLAG_CHECKSUM_OK;
+
+        memcpy(_previous, fields, sizeof(_previous));
+        _has_previous = true;
+        _expected_seq = (uint8_t)(seq + 1);
+        return reader.position();
+    }
+
+private:
+    uint8_t _expected_seq;
+    bool _has_previous;
+    int32_t _previous[opcn3_codec::FIELD_COUNT];
+};
+
+#endif // OPCN3_CODEC_H
@@ -0,0 +1,164 @@
+#ifndef OPCN3_CRC_H
+#define OPCN3_CRC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Number of bytes folded per table lookup step when updating over a buffer.
+// 1 uses a single 256-entry table (512 bytes of flash), 4 and 8 use
+// slicing-by-4/8 tables (2 KB / 4 KB) for higher throughput on long frames.
+#ifndef OPCN3_CRC_SLICES
+#define OPCN3_CRC_SLICES 1
+#endif
+
+static_assert(OPCN3_CRC_SLICES == 1 || OPCN3_CRC_SLICES == 4 || OPCN3_CRC_SLICES == 8,
+              "OPCN3_CRC_SLICES must be 1, 4 or 8");
+
+namespace opcn3_crc
+{
+    const uint16_t POLYNOMIAL = 0xA001; // Reflected 0x8005 (CRC-16/MODBUS)
+    const uint16_t INITIAL_VALUE = 0xFFFF;
+
+    // Reference implementation: the bit-by-bit loop from the datasheet
+    constexpr uint16_t bitwise(const uint8_t *data, size_t len, uint16_t crc = INITIAL_VALUE)
+    {
+        for (size_t i = 0; i < len; i++)
+        {
+            crc ^= (uint16_t)data[i];
+            for (int j = 0; j < 8; j++)
+            {
+                crc = (crc & 1) ? (uint16_t)((crc >> 1) ^ POLYNOMIAL) : (uint16_t)(crc >> 1);
+            }
+        }
+        return crc;
+    }
+
+    template <size_t Slices>
+    struct Tables
+    {
+        uint16_t t[Slices][256];
+    };
+
+    // t[0][i] is the CRC step for a single byte i, t[k][i] is the same byte
+    // followed by k zero bytes, which lets slicing fold k + 1 bytes at once.
+    template <size_t Slices>
+    constexpr Tables<Slices> makeTables()
+    {
+        Tables<Slices> tables{};
+        for (int i = 0; i < 256; i++)
+        {
+            const uint8_t byte = (uint8_t)i;
+            tables.t[0][i] = bitwise(&byte, 1, 0);
+        }
+        for (size_t k = 1; k < Slices; k++)
+        {
+            for (int i = 0; i < 256; i++)
+            {
+                uint16_t prev = tables.t[k - 1][i];
+                tables.t[k][i] = (uint16_t)((prev >> 8) ^ tables.t[0][prev & 0xFF]);
+            }
+        }
+        return tables;
+    }
+
+    template <size_t Slices>
+    struct TableHolder
+    {
+        static constexpr Tables<Slices> value = makeTables<Slices>();
+    };
+
+    template <size_t Slices>
+    constexpr uint16_t byteStep(uint16_t crc, uint8_t b)
+    {
+        return (uint16_t)((crc >> 8) ^ TableHolder<Slices>::value.t[0][(crc ^ b) & 0xFF]);
+    }
+
+    // Table-driven update over a buffer, folding Slices bytes per iteration
+    // and finishing the tail one byte at a time.
+    template <size_t Slices>
+    constexpr uint16_t update(uint16_t crc, const uint8_t *data, size_t len)
+    {
+        const auto &t = TableHolder<Slices>::value.t;
+        size_t i = 0;
+        if constexpr (Slices > 1)
+        {
+            for (; i + Slices <= len; i += Slices)
+            {
+                uint16_t x = crc;
+                uint16_t folded = (uint16_t)(t[Slices - 1][(x ^ data[i]) & 0xFF] ^
+                                             t[Slices - 2][((x >> 8) ^ data[i + 1]) & 0xFF]);
+                for (size_t k = 2; k < Slices; k++)
+                {
+                    folded ^= t[Slices - 1 - k][data[i + k]];
+                }
+                crc = folded;
+            }
+        }
+        for (; i < len; i++)
+        {
+            crc = byteStep<Slices>(crc, data[i]);
+        }
+        return crc;
+    }
+}
+
+// Incremental CRC-16 (polynomial 0xA001, initial value 0xFFFF) as used by the
+// OPC-N3 for histogram frames. Bytes can be folded in one at a time while they
+// come off the bus, or in bulk over a buffer.
+class OpcN3Crc16
+{
+public:
+    constexpr OpcN3Crc16() : _crc(opcn3_crc::INITIAL_VALUE) {}
+
+    constexpr void reset() { _crc = opcn3_crc::INITIAL_VALUE; }
+
+    constexpr void update(uint8_t b) { _crc = opcn3_crc::byteStep<OPCN3_CRC_SLICES>(_crc, b); }
+
+    constexpr void update(const uint8_t *data, size_t len)
+    {
+        _crc = opcn3_crc::update<OPCN3_CRC_SLICES>(_crc, data, len);
+    }
+
+    constexpr uint16_t value() const { return _crc; }
+
+    static constexpr uint16_t compute(const uint8_t *data, size_t len)
+    {
+        return opcn3_crc::update<OPCN3_CRC_SLICES>(opcn3_crc::INITIAL_VALUE, data, len);
+    }
+
+private:
+    uint16_t _crc;
+};
+
+// --- Compile-time equivalence checks against the bitwise reference ---
+namespace opcn3_crc
+{
+    // Compares every table variant with the bitwise loop over a pseudo-random
+    // buffer, for every length up to the largest frame (168 config bytes).
+    template <size_t Slices>
+    constexpr bool matchesBitwise()
+    {
+        uint8_t buffer[168] = {};
+        uint32_t seed = 0x12345678;
+        for (size_t i = 0; i < sizeof(buffer); i++)
+        {
+            seed = seed * 1103515245u + 12345u;
+            buffer[i] = (uint8_t)(seed >> 16);
+        }
+        for (size_t len = 0; len <= sizeof(buffer); len++)
+        {
+            if (update<Slices>(INITIAL_VALUE, buffer, len) != bitwise(buffer, len))
+                return false;
+        }
+        return true;
+    }
+
+    constexpr uint8_t CHECK_INPUT[] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+    static_assert(bitwise(CHECK_INPUT, sizeof(CHECK_INPUT)) == 0x4B37, "CRC-16/MODBUS check value");
+    static_assert(update<1>(INITIAL_VALUE, CHECK_INPUT, sizeof(CHECK_INPUT)) == 0x4B37, "byte table check value");
+    static_assert(matchesBitwise<1>(), "byte table CRC differs from bitwise CRC");
+    static_assert(matchesBitwise<4>(), "slicing-by-4 CRC differs from bitwise CRC");
+    static_assert(matchesBitwise<8>(), "slicing-by-8 CRC differs from bitwise CRC");
+}
+
+#endif // OPCN3_CRC_H
@@ -0,0 +1,181 @@
+#ifndef OPCN3_DISTRIBUTION_H
+#define OPCN3_DISTRIBUTION_H
+
+#include <math.h>
+#include <stdint.h>
+#include "OpcN3Accumulator.h"
+#include "OpcN3Frame.h"
+
+// Per-bin geometry derived from the 25 bin edges, computed once per sensor
+// configuration so the per-sample math is multiply-adds over flat arrays:
+//
+//   midpoint_um   geometric mean of the bin edges
+//   inv_dlogdp    1 / log10(upper / lower)
+//   surface_um2   pi * Dp^2, surface of a sphere at the midpoint
+//   volume_um3    pi / 6 * Dp^3
+//   ln_midpoint   ln(Dp), for the geometric mean diameter
+//
+// Starts out with the factory bin edges of the OPC-N3. A table only applies
+// to histograms read under the configuration it was built from, see
+// matches().
+struct OpcN3BinGeometry
+{
+    static const int BIN_COUNT = 24;
+
+    float edges_um[BIN_COUNT + 1];
+    float midpoint_um[BIN_COUNT];
+    float inv_dlogdp[BIN_COUNT];
+    float surface_um2[BIN_COUNT];
+    float volume_um3[BIN_COUNT];
+    float ln_midpoint[BIN_COUNT];
+    float ln_edges[BIN_COUNT + 1];
+    uint16_t config_version; // Of the configuration the table was built from
+
+    OpcN3BinGeometry() : config_version(0) { configure(factoryEdges(), 0); }
+
+    static const float *factoryEdges()
+    {
+        static const float FACTORY_EDGES_UM[BIN_COUNT + 1] = {0.35f, 0.46f, 0.66f, 1.0f,  1.3f,  1.7f,  2.3f,
+                                                              3.0f,  4.0f,  5.0f,  6.5f, 8.0f,  10.0f, 12.0f,
+                                                              14.0f, 16.0f, 18.0f, 20.0f, 22.0f, 25.0f, 28.0f,
+                                                              31.0f, 34.0f, 37.0f, 40.0f};
+        return FACTORY_EDGES_UM;
+    }
+
+    // Rebuilds the table; edges must increase strictly, otherwise the table
+    // is left unchanged and false is returned
+    bool configure(const float *edges, uint16_t version)
+    {
+        for (int i = 0; i < BIN_COUNT; i++)
+        {
+            if (!(edges[i] > 0.0f) || !(edges[i + 1] > edges[i]))
+                return false;
+        }
+        for (int i = 0; i <= BIN_COUNT; i++)
+        {
+            edges_um[i] = edges[i];
+            ln_edges[i] = logf(edges[i]);
+        }
+        for (int i = 0; i < BIN_COUNT; i++)
+        {
+            float mid = sqrtf(edges[i] * edges[i + 1]);
+            midpoint_um[i] = mid;
+            inv_dlogdp[i] = 1.0f / log10f(edges[i + 1] / edges[i]);
+            surface_um2[i] = (float)M_PI * mid * mid;
+            volume_um3[i] = (float)M_PI / 6.0f * mid * mid * mid;
+            ln_midpoint[i] = logf(mid);
+        }
+        config_version = version;
+        return true;
+    }
+
+    bool configure(const OpcN3Config &config) { return configure(config.bin_boundaries_um, config.version); }
+
+    // Whether the bins of data were counted with the edges of this table
+    bool matches(const OpcN3Data &data) const { return data.config_version == config_version; }
+};
+
+// Size distribution of one histogram or window. Concentrations are per cm^3
+// of sampled air; the d/dlogDp arrays are normalized by the bin widths so
+// bins of different width compare.
+struct OpcN3SizeDistribution
+{
+    float dn_dlogdp[OpcN3BinGeometry::BIN_COUNT]; // particles/cm^3
+    float ds_dlogdp[OpcN3BinGeometry::BIN_COUNT]; // um^2/cm^3
+    float dv_dlogdp[OpcN3BinGeometry::BIN_COUNT]; // um^3/cm^3
+    float number_cm3;                             // Total number concentration
+    float surface_um2_cm3;
+    float volume_um3_cm3;
+    float cmd_um; // Count median diameter
+    float gmd_um; // Geometric mean diameter
+    float gsd;    // Geometric standard deviation
+};
+
+// Computes the distribution from per-bin number concentrations (particles
+// per cm^3). Returns false, with NAN diameters, if there are no particles.
+inline bool computeSizeDistribution(const OpcN3BinGeometry &geometry, const float *concentrations,
+                                    OpcN3SizeDistribution &out)
+{
+    const int n = OpcN3BinGeometry::BIN_COUNT;
+    float number = 0.0f, surface = 0.0f, volume = 0.0f, ln_sum = 0.0f;
+    for (int i = 0; i < n; i++)
+    {
+        float c = concentrations[i];
+        float dn = c * geometry.inv_dlogdp[i];
+        out.dn_dlogdp[i] = dn;
+        out.ds_dlogdp[i] = dn * geometry.surface_um2[i];
+        out.dv_dlogdp[i] = dn * geometry.volume_um3[i];
+        number += c;
+        surface += c * geometry.surface_um2[i];
+        volume += c * geometry.volume_um3[i];
+        ln_sum += c * geometry.ln_midpoint[i];
+    }
+    out.number_cm3 = number;
+    out.surface_um2_cm3 = surface;
+    out.volume_um3_cm3 = volume;
+    if (!(number > 0.0f))
+    {
+        out.cmd_um = out.gmd_um = out.gsd = NAN;
+        return false;
+    }
+
+    float ln_gmd = ln_sum / number;
+    float ln_var = 0.0f;
+    for (int i = 0; i < n; i++)
+    {
+        float d = geometry.ln_midpoint[i] - ln_gmd;
+        ln_var += concentrations[i] * d * d;
+    }
+    out.gmd_um = expf(ln_gmd);
+    out.gsd = expf(sqrtf(ln_var / number));
+
+    // Median: find the bin where the cumulative count passes half the total
+    // and interpolate within it on a log scale
+    float half = number * 0.5f;
+    float cumulative = 0.0f;
+    out.cmd_um = geometry.edges_um[n];
+    for (int i = 0; i < n; i++)
+    {
+        float c = concentrations[i];
+        if (cumulative + c >= half && c > 0.0f)
+        {
+            float fraction = (half - cumulative) / c;
+            out.cmd_um = expf(geometry.ln_edges[i] + fraction * (geometry.ln_edges[i + 1] - geometry.ln_edges[i]));
+            break;
+        }
+        cumulative += c;
+    }
+    return true;
+}
+
+// Distribution of one histogram read. Returns false, with NAN values, if the
+// histogram was read under another configuration than the geometry's.
+inline bool computeSizeDistribution(const OpcN3BinGeometry &geometry, const OpcN3Data &data,
+                                    OpcN3SizeDistribution &out)
+{
+    if (!geometry.matches(data))
+    {
+        for (int i = 0; i < OpcN3BinGeometry::BIN_COUNT; i++)
+            out.dn_dlogdp[i] = out.ds_dlogdp[i] = out.dv_dlogdp[i] = NAN;
+        out.number_cm3 = out.surface_um2_cm3 = out.volume_um3_cm3 = NAN;
+        out.cmd_um = out.gmd_um = out.gsd = NAN;
+        return false;
+    }
+    OpcN3Accumulator histogram;
+    histogram.add(data);
+    float concentrations[OpcN3Accumulator::BIN_COUNT];
+    histogram.concentrations(concentrations);
+    return computeSizeDistribution(geometry, concentrations, out);
+}
+
+// Distribution over a window of histograms; the caller makes sure they were
+// all read under the geometry's configuration
+inline bool computeSizeDistribution(const OpcN3BinGeometry &geometry, const OpcN3Accumulator &histograms,
+                                    OpcN3SizeDistribution &out)
+{
+    float concentrations[OpcN3Accumulator::BIN_COUNT];
+    histograms.concentrations(concentrations);
+    return computeSizeDistribution(geometry, concentrations, out);
+}
+
+#endif // OPCN3_DISTRIBUTION_H
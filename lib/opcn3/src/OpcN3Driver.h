@@ -0,0 +1,792 @@
+#ifndef OPCN3_DRIVER_H
+#define OPCN3_DRIVER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "OpcN3Crc.h"
+#include "OpcN3Frame.h"
+
+namespace opcn3
+{
+    // --- OPC-N3 Command & Response Constants ---
+    const uint8_t CMD_READ_FIRMWARE = 0x12;
+    const uint8_t CMD_POWER_CONTROL = 0x03;
+    const uint8_t CMD_READ_HISTOGRAM = 0x30;
+    const uint8_t CMD_READ_PM = 0x32;
+    const uint8_t CMD_READ_CONFIG_VARS = 0x3C;
+    const uint8_t CMD_WRITE_CONFIG_VARS = 0x3A;
+    const uint8_t CMD_SAVE_CONFIG_VARS = 0x43;
+
+    // Key bytes that must follow CMD_SAVE_CONFIG_VARS for the save to happen
+    inline constexpr uint8_t SAVE_CONFIG_SEQUENCE[] = {0x3F, 0x3C, 0x3F, 0x3C, 0x43};
+
+    const uint8_t POWER_FAN_ON = 0x03;
+    const uint8_t POWER_LASER_ON = 0x07;
+
+    const uint8_t RESP_READY = 0xF3;
+    const uint8_t RESP_BUSY = 0x31;
+
+    const size_t CONFIG_VARS_SIZE = 168;
+
+    // --- Timing and Robustness Constants ---
+    const int DELAY_CMD_POLLING_MS = 10;
+    const int DELAY_INTER_BYTE_US = 10;
+    const int DELAY_POWER_UP_MS = 3000;
+    const int DELAY_FAN_ON_MS = 1000;
+    const int DELAY_LASER_ON_MS = 200;
+    const int DELAY_CMD_RECOVERY_MS = 2500;
+    const int MAX_INIT_RETRIES = 5;
+    const int MAX_BURST_CRC_ERRORS = 3; // Consecutive CRC errors before burst mode falls back to paced reads
+}
+
+// Status and step enums shared by every OpcN3Driver instantiation
+struct OpcN3Types
+{
+    // Result of polling an asynchronous read started with startRead()
+    enum ReadStatus
+    {
+        READ_IDLE = 0, // No read in progress
+        READ_PENDING,  // Sensor still busy; call poll() again later
+        READ_OK,       // Frame received and validated
+        READ_FAILED    // Timeout, unexpected response or CRC mismatch
+    };
+
+    // Result of polling the initialization sequence started with startBegin()
+    enum BeginStatus
+    {
+        BEGIN_PENDING = 0,
+        BEGIN_OK,
+        BEGIN_FAILED
+    };
+
+    // Steps of the initialization sequence, in order
+    enum BootStep
+    {
+        BOOT_POWER_UP = 0,
+        BOOT_CONNECTION,
+        BOOT_FAN,
+        BOOT_LASER,
+        BOOT_CONFIG,
+        BOOT_STEP_COUNT
+    };
+
+    static const char *bootStepName(BootStep step);
+};
+
+namespace opcn3
+{
+    // --- Initialization sequence ---
+    // One entry per BootStep; each step waits for the command-ready handshake,
+    // completes the transfer, then settles for settle_ms before the next step.
+    struct BootStepInfo
+    {
+        const char *name;
+        const char *title;
+        const char *fatal_message;
+        uint8_t cmd;
+        uint8_t data;
+        int settle_ms;
+    };
+
+    inline constexpr BootStepInfo BOOT_STEPS[OpcN3Types::BOOT_STEP_COUNT] = {
+        {"power_up", "Waiting for Power-Up", "", 0, 0, 0},
+        {"connection", "Checking Connection", "FATAL: Could not establish connection. Halting.", CMD_READ_FIRMWARE, 0, 0},
+        {"fan", "Turning on Fan", "FATAL: Could not turn on fan. Halting.", CMD_POWER_CONTROL, POWER_FAN_ON, DELAY_FAN_ON_MS},
+        {"laser", "Turning on Laser", "FATAL: Could not turn on laser. Halting.", CMD_POWER_CONTROL, POWER_LASER_ON, DELAY_LASER_ON_MS},
+        {"config", "Reading Configuration", "FATAL: Could not read configuration. Halting.", CMD_READ_CONFIG_VARS, 0, 0},
+    };
+}
+
+inline const char *OpcN3Types::bootStepName(BootStep step)
+{
+    return step < BOOT_STEP_COUNT ? opcn3::BOOT_STEPS[step].name : "unknown";
+}
+
+// OPC-N3 protocol driver, parameterized over the bus it talks through. The
+// Bus type provides the SPI transfers, chip select, clock and logging, all
+// resolved at compile time:
+//
+//   void begin();                          // Configure the chip select pin
+//   void beginTransaction(); void endTransaction();
+//   void select(); void deselect();        // Drive /SS low / high
+//   uint8_t transfer(uint8_t out);
+//   void transfer(uint8_t *buffer, size_t len); // In-place buffered transfer
+//   unsigned long millis(); unsigned long micros();
+//   void delayMs(unsigned long ms); void delayUs(unsigned int us);
+//   void log(const char *format, ...);    // printf-style diagnostics
+//
+// OpcN3.h instantiates it over the Arduino SPI bus as OpcN3; OpcN3SimBus.h
+// provides a simulated sensor for running the protocol logic on a host.
+template <class Bus>
+class OpcN3Driver : public OpcN3Types
+{
+public:
+    explicit OpcN3Driver(const Bus &bus);
+
+    // Underlying bus, e.g. to inspect or tune a simulated sensor
+    Bus &bus() { return _bus; }
+
+    // Initializes the sensor (SPI, connection check, power on, config read, set default period)
+    bool begin();
+
+    // Non-blocking variant of begin(). startBegin() starts the power-up wait;
+    // pollBegin() advances the sequence by at most one handshake byte or
+    // transfer per call and returns BEGIN_PENDING until it succeeds or fails.
+    // Power-up, settle and retry delays are timestamps, so the caller can
+    // bring up other peripherals and the network while the sensor starts.
+    void startBegin();
+    BeginStatus pollBegin();
+
+    // Time taken by each initialization step, including retries and settling
+    uint32_t bootStepMs(BootStep step) const { return step < BOOT_STEP_COUNT ? _boot_step_ms[step] : 0; }
+
+    // Reads the latest histogram data from the sensor
+    bool readData(OpcN3Data &data);
+
+    // Configuration decoded by the last successful configuration read
+    const OpcN3Config &config() const { return _config; }
+
+    // Re-reads the configuration variables from the sensor into config()
+    bool readConfiguration();
+
+    // Writes all configuration fields (start from a copy of config()), reads
+    // them back and verifies that the sensor stored exactly these values.
+    // With persist the values are also saved to non-volatile memory so they
+    // survive a power cycle; otherwise they last until the next power-up.
+    bool writeConfiguration(const OpcN3Config &config, bool persist = false);
+
+    // Sets the autonomous-mode sampling period in histogram intervals
+    bool setSamplingIntervalCount(uint16_t count, bool persist = false);
+
+    // Non-blocking variant of readData(). startRead() issues the histogram
+    // command and returns immediately; poll() then advances the busy/ready
+    // handshake at most once per polling interval and reads the frame as soon
+    // as the sensor is ready. Returns false if a read is already in progress.
+    // The blocking calls share the handshake state, so while a read is in
+    // progress they fail without touching the bus.
+    bool startRead();
+    ReadStatus poll(OpcN3Data &data);
+
+    // Fast PM-only read using the short PM data command (0x32): 14 bytes
+    // instead of 86, with its own CRC. Like the histogram command it resets
+    // the sensor's histogram, so a following readData() only covers the time
+    // since this read. startReadPm()/pollPm() are the non-blocking variants;
+    // only one asynchronous read (histogram or PM) can be in progress.
+    bool readPm(OpcN3PmData &data);
+    bool startReadPm();
+    ReadStatus pollPm(OpcN3PmData &data);
+
+    // Opt-in burst mode: clocks histogram and PM frames out in one buffered SPI
+    // transfer instead of pacing every byte. Falls back to paced mode
+    // automatically after repeated CRC errors; burstMode() reports the mode
+    // currently in use. The configuration block has no CRC to catch a garbled
+    // burst, so it is always read paced.
+    void setBurstMode(bool enabled);
+    bool burstMode() const { return _burst_enabled; }
+
+    // Time in microseconds the bus was held for the last frame transfer
+    uint32_t lastBusTimeUs() const { return _last_bus_time_us; }
+    uint32_t crcErrorCount() const { return _crc_error_count; }
+
+private:
+    enum CommandStatus
+    {
+        COMMAND_PENDING = 0,
+        COMMAND_READY,
+        COMMAND_FAILED
+    };
+
+    Bus _bus;
+
+    // --- Internal state ---
+    uint8_t _config_vars[opcn3::CONFIG_VARS_SIZE]; // Buffer to hold the full configuration variables
+    OpcN3Config _config;
+    bool _burst_enabled;
+    uint8_t _burst_crc_errors; // Consecutive CRC errors seen in burst mode
+    uint32_t _crc_error_count;
+    uint32_t _last_bus_time_us;
+
+    // --- Command-ready handshake state ---
+    uint8_t _cmd;
+    unsigned long _cmd_timeout_ms;
+    unsigned long _cmd_start_ms;
+    unsigned long _cmd_last_poll_ms;
+    uint8_t _read_cmd; // Command of the asynchronous read in progress, 0 if none
+
+    // --- Initialization sequence state ---
+    uint8_t _boot_step;
+    uint8_t _boot_attempt;
+    bool _boot_cmd_sent;
+    bool _boot_step_done;
+    bool _boot_failed;
+    unsigned long _boot_step_start_ms;
+    unsigned long _boot_wait_start_ms;
+    unsigned long _boot_wait_ms;
+    uint32_t _boot_step_ms[BOOT_STEP_COUNT];
+
+    // --- Helper methods for SPI communication ---
+    bool waitForReady(uint8_t cmd, int timeout_ms = 500);
+    void startCommand(uint8_t cmd, int timeout_ms = 500);
+    CommandStatus pollCommand();
+    bool sendCommandWithData(uint8_t cmd, uint8_t data);
+    void sendDataByte(uint8_t data);
+    void readBytes(uint8_t *buffer, size_t len, OpcN3Crc16 *crc = nullptr, size_t crc_len = 0);
+
+    // --- Helper methods for sensor control ---
+    void bootWait(unsigned long ms);
+    void receiveFirmwareVersion();
+    void receiveConfiguration();
+    void decodeConfiguration();
+    bool saveConfiguration();
+
+    // --- Helper methods for data processing ---
+    bool startAsyncRead(uint8_t cmd);
+    ReadStatus pollAsyncRead(uint8_t cmd);
+    bool checkCrc(uint16_t received, uint16_t calculated);
+    bool decodeHistogram(const OpcN3HistogramFrame &frame, uint16_t calculated_crc, OpcN3Data &data);
+    bool decodePm(const OpcN3PmFrame &frame, uint16_t calculated_crc, OpcN3PmData &data);
+};
+
+// --- Constructor ---
+template <class Bus>
+OpcN3Driver<Bus>::OpcN3Driver(const Bus &bus)
+    : _bus(bus),
+      _burst_enabled(false), _burst_crc_errors(0), _crc_error_count(0), _last_bus_time_us(0),
+      _cmd(0), _cmd_timeout_ms(0), _cmd_start_ms(0), _cmd_last_poll_ms(0), _read_cmd(0),
+      _boot_step(BOOT_POWER_UP), _boot_attempt(0), _boot_cmd_sent(false), _boot_step_done(false), _boot_failed(false),
+      _boot_step_start_ms(0), _boot_wait_start_ms(0), _boot_wait_ms(0)
+{
+    // Initialize config buffer with zeros
+    memset(_config_vars, 0, sizeof(_config_vars));
+    memset(&_config, 0, sizeof(_config));
+    memset(_boot_step_ms, 0, sizeof(_boot_step_ms));
+}
+
+// --- Public Methods ---
+
+template <class Bus>
+bool OpcN3Driver<Bus>::begin()
+{
+    startBegin();
+    BeginStatus status;
+    while ((status = pollBegin()) == BEGIN_PENDING)
+    {
+        _bus.delayMs(1);
+    }
+    return status == BEGIN_OK;
+}
+
+template <class Bus>
+void OpcN3Driver<Bus>::startBegin()
+{
+    _bus.begin();
+
+    _bus.log("Waiting for OPC-N3 to initialize (3 seconds)...\n");
+    memset(_boot_step_ms, 0, sizeof(_boot_step_ms));
+    _boot_step = BOOT_POWER_UP;
+    _boot_attempt = 0;
+    _boot_cmd_sent = false;
+    _boot_failed = false;
+    _boot_step_start_ms = _bus.millis();
+    bootWait(opcn3::DELAY_POWER_UP_MS);
+    _boot_step_done = true;
+}
+
+template <class Bus>
+OpcN3Types::BeginStatus OpcN3Driver<Bus>::pollBegin()
+{
+    if (_boot_failed)
+        return BEGIN_FAILED;
+    if (_boot_step >= BOOT_STEP_COUNT)
+        return BEGIN_OK;
+
+    unsigned long now = _bus.millis();
+    if (now - _boot_wait_start_ms < _boot_wait_ms)
+        return BEGIN_PENDING; // Power-up, settle or retry backoff still running
+
+    if (_boot_step_done)
+    {
+        // The step and its settle time are over; record it and move on
+        _boot_step_ms[_boot_step] = now - _boot_step_start_ms;
+        _boot_step++;
+        _boot_step_start_ms = now;
+        _boot_attempt = 0;
+        _boot_step_done = false;
+        if (_boot_step >= BOOT_STEP_COUNT)
+        {
+            _bus.log("\nInitialization successful. Starting measurements...\n");
+            return BEGIN_OK;
+        }
+        _bus.log("\n--- Initialization Step %d: %s ---\n", _boot_step, opcn3::BOOT_STEPS[_boot_step].title);
+    }
+
+    const opcn3::BootStepInfo &step = opcn3::BOOT_STEPS[_boot_step];
+    if (!_boot_cmd_sent)
+    {
+        if (step.cmd == opcn3::CMD_POWER_CONTROL)
+            _bus.log("Sending command to turn on: %s... ", step.data == opcn3::POWER_FAN_ON ? "Fan" : "Laser");
+        else if (step.cmd == opcn3::CMD_READ_FIRMWARE)
+            _bus.log("Checking connection to OPC-N3...\n");
+
+        _bus.beginTransaction();
+        startCommand(step.cmd);
+        _bus.endTransaction();
+        _boot_cmd_sent = true;
+        return BEGIN_PENDING;
+    }
+    if (now - _cmd_last_poll_ms < (unsigned long)opcn3::DELAY_CMD_POLLING_MS)
+        return BEGIN_PENDING;
+
+    _bus.beginTransaction();
+    CommandStatus status = pollCommand();
+    if (status == COMMAND_PENDING)
+    {
+        _bus.endTransaction();
+        return BEGIN_PENDING;
+    }
+    if (status == COMMAND_READY)
+    {
+        if (step.cmd == opcn3::CMD_READ_FIRMWARE)
+            receiveFirmwareVersion();
+        else if (step.cmd == opcn3::CMD_POWER_CONTROL)
+            sendDataByte(step.data);
+        else
+            receiveConfiguration();
+    }
+    _bus.endTransaction();
+    _boot_cmd_sent = false;
+
+    if (status == COMMAND_READY)
+    {
+        if (step.cmd == opcn3::CMD_POWER_CONTROL)
+            _bus.log("Success.\n");
+        bootWait(step.settle_ms);
+        _boot_step_done = true;
+        return BEGIN_PENDING;
+    }
+
+    if (step.cmd == opcn3::CMD_POWER_CONTROL)
+        _bus.log("Failed.\n");
+    _boot_attempt++;
+    if (_boot_attempt >= opcn3::MAX_INIT_RETRIES)
+    {
+        _bus.log("%s\n", step.fatal_message);
+        _boot_failed = true;
+        return BEGIN_FAILED;
+    }
+    _bus.log("Attempt %d/%d failed. Retrying in %dms...\n", _boot_attempt, opcn3::MAX_INIT_RETRIES, opcn3::DELAY_CMD_RECOVERY_MS);
+    bootWait(opcn3::DELAY_CMD_RECOVERY_MS);
+    return BEGIN_PENDING;
+}
+
+template <class Bus>
+bool OpcN3Driver<Bus>::readData(OpcN3Data &data)
+{
+    _bus.beginTransaction();
+    if (!waitForReady(opcn3::CMD_READ_HISTOGRAM))
+    {
+        _bus.endTransaction();
+        return false;
+    }
+
+    // The CRC covers everything but the trailing checksum
+    OpcN3HistogramFrame frame;
+    OpcN3Crc16 crc;
+    readBytes(opcn3_frame::bytes(frame), sizeof(frame), &crc, opcn3_frame::HISTOGRAM_CRC_LENGTH);
+    _bus.endTransaction();
+
+    return decodeHistogram(frame, crc.value(), data);
+}
+
+template <class Bus>
+bool OpcN3Driver<Bus>::startRead()
+{
+    return startAsyncRead(opcn3::CMD_READ_HISTOGRAM);
+}
+
+template <class Bus>
+OpcN3Types::ReadStatus OpcN3Driver<Bus>::poll(OpcN3Data &data)
+{
+    ReadStatus status = pollAsyncRead(opcn3::CMD_READ_HISTOGRAM);
+    if (status != READ_OK)
+        return status;
+
+    OpcN3HistogramFrame frame;
+    OpcN3Crc16 crc;
+    readBytes(opcn3_frame::bytes(frame), sizeof(frame), &crc, opcn3_frame::HISTOGRAM_CRC_LENGTH);
+    _bus.endTransaction();
+
+    return decodeHistogram(frame, crc.value(), data) ? READ_OK : READ_FAILED;
+}
+
+template <class Bus>
+bool OpcN3Driver<Bus>::readPm(OpcN3PmData &data)
+{
+    _bus.beginTransaction();
+    if (!waitForReady(opcn3::CMD_READ_PM))
+    {
+        _bus.endTransaction();
+        return false;
+    }
+
+    OpcN3PmFrame frame;
+    OpcN3Crc16 crc;
+    readBytes(opcn3_frame::bytes(frame), sizeof(frame), &crc, opcn3_frame::PM_CRC_LENGTH);
+    _bus.endTransaction();
+
+    return decodePm(frame, crc.value(), data);
+}
+
+template <class Bus>
+bool OpcN3Driver<Bus>::startReadPm()
+{
+    return startAsyncRead(opcn3::CMD_READ_PM);
+}
+
+template <class Bus>
+OpcN3Types::ReadStatus OpcN3Driver<Bus>::pollPm(OpcN3PmData &data)
+{
+    ReadStatus status = pollAsyncRead(opcn3::CMD_READ_PM);
+    if (status != READ_OK)
+        return status;
+
+    OpcN3PmFrame frame;
+    OpcN3Crc16 crc;
+    readBytes(opcn3_frame::bytes(frame), sizeof(frame), &crc, opcn3_frame::PM_CRC_LENGTH);
+    _bus.endTransaction();
+
+    return decodePm(frame, crc.value(), data) ? READ_OK : READ_FAILED;
+}
+
+template <class Bus>
+void OpcN3Driver<Bus>::setBurstMode(bool enabled)
+{
+    _burst_enabled = enabled;
+    _burst_crc_errors = 0;
+}
+
+// --- Private Methods ---
+
+template <class Bus>
+bool OpcN3Driver<Bus>::startAsyncRead(uint8_t cmd)
+{
+    if (_read_cmd != 0)
+        return false;
+
+    _bus.beginTransaction();
+    startCommand(cmd);
+    _bus.endTransaction();
+    _read_cmd = cmd;
+    return true;
+}
+
+// Advances the handshake of an asynchronous read of cmd. On READ_OK the
+// sensor is ready and the bus transaction is left open for the caller to
+// receive the frame; every other status has already released the bus.
+template <class Bus>
+OpcN3Types::ReadStatus OpcN3Driver<Bus>::pollAsyncRead(uint8_t cmd)
+{
+    if (_read_cmd != cmd)
+        return READ_IDLE;
+    if (_bus.millis() - _cmd_last_poll_ms < (unsigned long)opcn3::DELAY_CMD_POLLING_MS)
+        return READ_PENDING; // Not yet time for the next poll; leave the bus alone
+
+    _bus.beginTransaction();
+    CommandStatus status = pollCommand();
+    if (status == COMMAND_PENDING)
+    {
+        _bus.endTransaction();
+        return READ_PENDING;
+    }
+    _read_cmd = 0;
+    if (status != COMMAND_READY)
+    {
+        _bus.endTransaction();
+        return READ_FAILED;
+    }
+    return READ_OK;
+}
+
+template <class Bus>
+bool OpcN3Driver<Bus>::checkCrc(uint16_t received, uint16_t calculated)
+{
+    if (calculated != received)
+    {
+        _bus.log("ERROR: CRC checksum mismatch! Received: 0x%04X, Calculated: 0x%04X\n", received, calculated);
+        _crc_error_count++;
+        if (_burst_enabled && ++_burst_crc_errors >= opcn3::MAX_BURST_CRC_ERRORS)
+        {
+            _bus.log("WARNING: Repeated CRC errors in burst mode. Falling back to paced transfers.\n");
+            _burst_enabled = false;
+        }
+        return false;
+    }
+    _burst_crc_errors = 0;
+    return true;
+}
+
+template <class Bus>
+bool OpcN3Driver<Bus>::decodeHistogram(const OpcN3HistogramFrame &frame, uint16_t calculated_crc, OpcN3Data &data)
+{
+    if (!checkCrc(frame.checksum, calculated_crc))
+    {
+        data.received_checksum = frame.checksum;
+        data.checksum_ok = false;
+        return false;
+    }
+
+    opcn3_frame::decode(frame, calculated_crc, data);
+    data.config_version = _config.version;
+
+    return true;
+}
+
+template <class Bus>
+bool OpcN3Driver<Bus>::decodePm(const OpcN3PmFrame &frame, uint16_t calculated_crc, OpcN3PmData &data)
+{
+    opcn3_frame::decode(frame, calculated_crc, data);
+    return checkCrc(frame.checksum, calculated_crc);
+}
+
+template <class Bus>
+void OpcN3Driver<Bus>::readBytes(uint8_t *buffer, size_t len, OpcN3Crc16 *crc, size_t crc_len)
+{
+    unsigned long start_us = _bus.micros();
+    _bus.select();
+    if (_burst_enabled && crc)
+    {
+        // Single buffered transfer; the CRC is computed over the buffer afterwards.
+        // Only for frames with a CRC, which catches a transfer that was too fast.
+        _bus.delayUs(opcn3::DELAY_INTER_BYTE_US);
+        memset(buffer, 0x00, len);
+        _bus.transfer(buffer, len);
+        crc->update(buffer, crc_len);
+    }
+    else
+    {
+        // Paced per-byte transfer; the CRC is folded in while the bytes arrive
+        for (size_t i = 0; i < len; i++)
+        {
+            _bus.delayUs(opcn3::DELAY_INTER_BYTE_US);
+            buffer[i] = _bus.transfer(0x00);
+            if (crc && i < crc_len)
+                crc->update(buffer[i]);
+        }
+    }
+    _bus.deselect();
+    _last_bus_time_us = _bus.micros() - start_us;
+}
+
+template <class Bus>
+bool OpcN3Driver<Bus>::readConfiguration()
+{
+    _bus.beginTransaction();
+    if (!waitForReady(opcn3::CMD_READ_CONFIG_VARS))
+    {
+        _bus.endTransaction();
+        return false;
+    }
+
+    receiveConfiguration();
+    _bus.endTransaction();
+    return true;
+}
+
+template <class Bus>
+bool OpcN3Driver<Bus>::writeConfiguration(const OpcN3Config &config, bool persist)
+{
+    OpcN3ConfigFrame frame;
+    opcn3_frame::encode(config, frame);
+    const uint8_t *bytes = opcn3_frame::bytes(frame);
+
+    _bus.beginTransaction();
+    if (!waitForReady(opcn3::CMD_WRITE_CONFIG_VARS))
+    {
+        _bus.endTransaction();
+        return false;
+    }
+    _bus.select();
+    for (size_t i = 0; i < sizeof(frame); i++)
+    {
+        _bus.delayUs(opcn3::DELAY_INTER_BYTE_US);
+        _bus.transfer(bytes[i]);
+    }
+    _bus.deselect();
+    _bus.endTransaction();
+    _bus.log("Successfully wrote configuration variables to the sensor.\n");
+
+    // Read back and compare byte for byte before declaring success
+    if (!readConfiguration())
+        return false;
+    if (memcmp(_config_vars, bytes, sizeof(frame)) != 0)
+    {
+        _bus.log("ERROR: Configuration read-back does not match the written values.\n");
+        return false;
+    }
+
+    if (persist && !saveConfiguration())
+        return false;
+    return true;
+}
+
+template <class Bus>
+bool OpcN3Driver<Bus>::setSamplingIntervalCount(uint16_t count, bool persist)
+{
+    OpcN3Config config = _config;
+    config.am_sampling_interval_count = count;
+    return writeConfiguration(config, persist);
+}
+
+template <class Bus>
+void OpcN3Driver<Bus>::receiveConfiguration()
+{
+    readBytes(_config_vars, sizeof(_config_vars)); // Read and store in our internal buffer
+    decodeConfiguration();
+    _bus.log("Successfully read and stored configuration variables.\n");
+}
+
+template <class Bus>
+void OpcN3Driver<Bus>::decodeConfiguration()
+{
+    OpcN3ConfigFrame frame;
+    memcpy(&frame, _config_vars, sizeof(frame));
+    OpcN3Config decoded;
+    memset(&decoded, 0, sizeof(decoded));
+    opcn3_frame::decode(frame, decoded);
+
+    // Only publish a new version when the values actually changed
+    if (_config.version == 0 || !opcn3_frame::sameSettings(decoded, _config))
+    {
+        decoded.version = _config.version + 1;
+        if (decoded.version == 0)
+            decoded.version = 1;
+        _config = decoded;
+    }
+}
+
+template <class Bus>
+bool OpcN3Driver<Bus>::saveConfiguration()
+{
+    _bus.beginTransaction();
+    if (!waitForReady(opcn3::CMD_SAVE_CONFIG_VARS))
+    {
+        _bus.endTransaction();
+        return false;
+    }
+    _bus.select();
+    for (size_t i = 0; i < sizeof(opcn3::SAVE_CONFIG_SEQUENCE); i++)
+    {
+        _bus.delayUs(opcn3::DELAY_INTER_BYTE_US);
+        _bus.transfer(opcn3::SAVE_CONFIG_SEQUENCE[i]);
+    }
+    _bus.deselect();
+    _bus.endTransaction();
+
+    _bus.log("Saved configuration variables to non-volatile memory.\n");
+    return true;
+}
+
+template <class Bus>
+bool OpcN3Driver<Bus>::waitForReady(uint8_t cmd, int timeout_ms)
+{
+    if (_read_cmd != 0)
+    {
+        _bus.log("Error: Command 0x%02X rejected while an asynchronous read is in progress.\n", cmd);
+        return false;
+    }
+    startCommand(cmd, timeout_ms);
+    for (;;)
+    {
+        _bus.delayMs(opcn3::DELAY_CMD_POLLING_MS);
+        CommandStatus status = pollCommand();
+        if (status == COMMAND_READY)
+            return true;
+        if (status != COMMAND_PENDING)
+            return false;
+    }
+}
+
+template <class Bus>
+void OpcN3Driver<Bus>::startCommand(uint8_t cmd, int timeout_ms)
+{
+    _bus.select();
+    _bus.transfer(cmd);
+    _bus.deselect();
+
+    _cmd = cmd;
+    _cmd_timeout_ms = timeout_ms;
+    _cmd_start_ms = _bus.millis();
+    _cmd_last_poll_ms = _cmd_start_ms;
+}
+
+template <class Bus>
+typename OpcN3Driver<Bus>::CommandStatus OpcN3Driver<Bus>::pollCommand()
+{
+    unsigned long now = _bus.millis();
+    if (now - _cmd_start_ms >= _cmd_timeout_ms)
+    {
+        _bus.log("Error: Timeout while waiting for ready signal.\n");
+        return COMMAND_FAILED;
+    }
+    _cmd_last_poll_ms = now;
+
+    _bus.select();
+    uint8_t response = _bus.transfer(_cmd);
+    _bus.deselect();
+
+    if (response == opcn3::RESP_READY)
+        return COMMAND_READY;
+    if (response != opcn3::RESP_BUSY)
+    {
+        _bus.log("Error: Unexpected response while waiting for ready: 0x%02X\n", response);
+        return COMMAND_FAILED;
+    }
+    return COMMAND_PENDING;
+}
+
+template <class Bus>
+bool OpcN3Driver<Bus>::sendCommandWithData(uint8_t cmd, uint8_t data)
+{
+    _bus.beginTransaction();
+    if (!waitForReady(cmd))
+    {
+        _bus.endTransaction();
+        return false;
+    }
+    sendDataByte(data);
+    _bus.endTransaction();
+    return true;
+}
+
+template <class Bus>
+void OpcN3Driver<Bus>::sendDataByte(uint8_t data)
+{
+    _bus.delayUs(opcn3::DELAY_INTER_BYTE_US);
+    _bus.select();
+    _bus.transfer(data);
+    _bus.deselect();
+}
+
+template <class Bus>
+void OpcN3Driver<Bus>::receiveFirmwareVersion()
+{
+    uint8_t version[2];
+    _bus.select();
+    _bus.delayUs(opcn3::DELAY_INTER_BYTE_US);
+    version[0] = _bus.transfer(0x00);
+    _bus.delayUs(opcn3::DELAY_INTER_BYTE_US);
+    version[1] = _bus.transfer(0x00);
+    _bus.deselect();
+
+    _bus.log("Connection successful. Firmware Version: %d.%d\n", version[0], version[1]);
+}
+
+template <class Bus>
+void OpcN3Driver<Bus>::bootWait(unsigned long ms)
+{
+    _boot_wait_start_ms = _bus.millis();
+    _boot_wait_ms = ms;
+}
+
+#endif // OPCN3_DRIVER_H
@@ -0,0 +1,300 @@
+#ifndef OPCN3_FRAME_H
+#define OPCN3_FRAME_H
+
+// Data structures and frame layout of the OPC-N3 histogram response. This
+// header has no Arduino dependencies so recorded frames can also be decoded
+// offline on a host.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "OpcN3Crc.h"
+
+// Configuration decoded once from the sensor's configuration variables.
+// It only changes when the configuration is read again, so samples refer to
+// it by version instead of carrying their own copy.
+struct OpcN3Config
+{
+    // Incremented whenever a configuration read yields different values;
+    // 0 means no configuration has been read yet
+    uint16_t version;
+
+    // Particle diameters (in um) defining the edges of the 24 bins
+    float bin_boundaries_um[25];
+
+    // Bin edges in raw ADC units, as used by the sensor internally
+    uint16_t bin_boundaries_adc[25];
+
+    // Weighting applied to each bin in the PM calculation
+    float bin_weightings[24];
+
+    // Cut-off diameters (in um) of the PM A/B/C values
+    float pm_diameter_a_um, pm_diameter_b_um, pm_diameter_c_um;
+
+    uint16_t max_tof;
+
+    // Autonomous (SD card logging) mode settings
+    uint16_t am_sampling_interval_count; // Sampling period in histogram intervals
+    uint16_t am_idle_interval_count;
+    uint16_t am_max_data_arrays_in_file;
+    uint8_t am_only_save_pm_data;
+    uint8_t am_fan_on_in_idle;
+    uint8_t am_laser_on_in_idle;
+
+    uint8_t tof_to_sfr_factor;
+    uint8_t pvp;
+    uint8_t bin_weighting_index;
+};
+
+// Data structure to hold all the readings from the OPC-N3
+struct OpcN3Data
+{
+    // Histogram Data
+    // The OPC-N3 reports 24 histogram bins
+    uint16_t bin_counts[24];
+
+    // Version of the OpcN3Config the bins refer to
+    uint16_t config_version;
+
+    // MToF (Time-of-Flight for specific bins)
+    uint8_t bin1_mtof, bin3_mtof, bin5_mtof, bin7_mtof;
+
+    // Converted Values
+    float sampling_period_s, sample_flow_rate_ml_s, temperature_c, humidity_rh;
+
+    // PM Values
+    float pm_a, pm_b, pm_c;
+
+    // Status and Error Values
+    uint16_t reject_count_glitch, reject_count_long_tof, reject_count_ratio;
+    uint16_t fan_rev_count, laser_status;
+
+    // Checksum
+    uint16_t received_checksum;
+    bool checksum_ok;
+};
+
+// Compact result of a PM-only read
+struct OpcN3PmData
+{
+    float pm_a, pm_b, pm_c;
+    uint16_t received_checksum;
+    bool checksum_ok;
+};
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "OpcN3HistogramFrame assumes a little-endian target, like the sensor"
+#endif
+
+// Raw 86-byte histogram frame exactly as sent by the sensor (little-endian).
+// SPI transfers write straight into this struct and the decoder reads the
+// fields in place, so the layout below is the single source of the offsets.
+struct __attribute__((packed)) OpcN3HistogramFrame
+{
+    uint16_t bin_counts[24];
+    uint8_t bin1_mtof, bin3_mtof, bin5_mtof, bin7_mtof;
+    uint16_t sampling_period;  // 1/100 s
+    uint16_t sample_flow_rate; // 1/100 ml/s
+    uint16_t temperature;      // Raw SHT31 reading
+    uint16_t humidity;         // Raw SHT31 reading
+    float pm_a, pm_b, pm_c;    // ug/m3
+    uint16_t reject_count_glitch;
+    uint16_t reject_count_long_tof;
+    uint16_t reject_count_ratio;
+    uint16_t reject_count_out_of_range;
+    uint16_t fan_rev_count;
+    uint16_t laser_status;
+    uint16_t checksum; // CRC-16 over all preceding bytes
+};
+
+// Raw 14-byte response to the PM data command
+struct __attribute__((packed)) OpcN3PmFrame
+{
+    float pm_a, pm_b, pm_c; // ug/m3
+    uint16_t checksum;      // CRC-16 over the three floats
+};
+
+// Raw 168-byte configuration variables block (read with 0x3C, written with 0x3A)
+struct __attribute__((packed)) OpcN3ConfigFrame
+{
+    uint16_t bin_boundaries_adc[25];
+    uint16_t bin_boundaries_um[25]; // 1/100 um
+    uint16_t bin_weightings[24];    // 1/100
+    uint16_t pm_diameter_a;         // 1/100 um
+    uint16_t pm_diameter_b;
+    uint16_t pm_diameter_c;
+    uint16_t max_tof;
+    uint16_t am_sampling_interval_count;
+    uint16_t am_idle_interval_count;
+    uint16_t am_max_data_arrays_in_file;
+    uint8_t am_only_save_pm_data;
+    uint8_t am_fan_on_in_idle;
+    uint8_t am_laser_on_in_idle;
+    uint8_t tof_to_sfr_factor;
+    uint8_t pvp;
+    uint8_t bin_weighting_index;
+};
+
+namespace opcn3_frame
+{
+    const size_t HISTOGRAM_SIZE = sizeof(OpcN3HistogramFrame);
+    const size_t HISTOGRAM_CRC_LENGTH = offsetof(OpcN3HistogramFrame, checksum);
+
+    // Offsets from the OPC-N3 datasheet, checked against the struct layout
+    static_assert(HISTOGRAM_SIZE == 86, "histogram frame must be 86 bytes");
+    static_assert(offsetof(OpcN3HistogramFrame, bin1_mtof) == 48, "MToF offset");
+    static_assert(offsetof(OpcN3HistogramFrame, sampling_period) == 52, "sampling period offset");
+    static_assert(offsetof(OpcN3HistogramFrame, sample_flow_rate) == 54, "flow rate offset");
+    static_assert(offsetof(OpcN3HistogramFrame, temperature) == 56, "temperature offset");
+    static_assert(offsetof(OpcN3HistogramFrame, humidity) == 58, "humidity offset");
+    static_assert(offsetof(OpcN3HistogramFrame, pm_a) == 60, "PM offset");
+    static_assert(offsetof(OpcN3HistogramFrame, reject_count_glitch) == 72, "reject count offset");
+    static_assert(offsetof(OpcN3HistogramFrame, fan_rev_count) == 80, "fan rev count offset");
+    static_assert(offsetof(OpcN3HistogramFrame, laser_status) == 82, "laser status offset");
+    static_assert(HISTOGRAM_CRC_LENGTH == 84, "checksum offset");
+
+    const size_t CONFIG_SIZE = sizeof(OpcN3ConfigFrame);
+    static_assert(CONFIG_SIZE == 168, "configuration block must be 168 bytes");
+    static_assert(offsetof(OpcN3ConfigFrame, bin_boundaries_um) == 50, "bin boundary offset");
+    static_assert(offsetof(OpcN3ConfigFrame, pm_diameter_a) == 148, "PM diameter offset");
+    static_assert(offsetof(OpcN3ConfigFrame, am_sampling_interval_count) == 156, "AM sampling interval offset");
+
+    const size_t PM_SIZE = sizeof(OpcN3PmFrame);
+    const size_t PM_CRC_LENGTH = offsetof(OpcN3PmFrame, checksum);
+    static_assert(PM_SIZE == 14, "PM frame must be 14 bytes");
+
+    template <typename Frame>
+    inline uint8_t *bytes(Frame &frame)
+    {
+        return reinterpret_cast<uint8_t *>(&frame);
+    }
+
+    template <typename Frame>
+    inline const uint8_t *bytes(const Frame &frame)
+    {
+        return reinterpret_cast<const uint8_t *>(&frame);
+    }
+
+    inline uint16_t computeChecksum(const OpcN3HistogramFrame &frame)
+    {
+        return OpcN3Crc16::compute(bytes(frame), HISTOGRAM_CRC_LENGTH);
+    }
+
+    // Straight-line conversion of a raw frame into OpcN3Data. Does not check
+    // the CRC; checksum fields are filled from calculated_crc.
+    inline void decode(const OpcN3HistogramFrame &frame, uint16_t calculated_crc, OpcN3Data &data)
+    {
+        for (int i = 0; i < 24; i++)
+            data.bin_counts[i] = frame.bin_counts[i];
+        data.bin1_mtof = frame.bin1_mtof;
+        data.bin3_mtof = frame.bin3_mtof;
+        data.bin5_mtof = frame.bin5_mtof;
+        data.bin7_mtof = frame.bin7_mtof;
+        data.sampling_period_s = frame.sampling_period / 100.0f;
+        data.sample_flow_rate_ml_s = frame.sample_flow_rate / 100.0f;
+        data.temperature_c = -45.0f + 175.0f * (frame.temperature / 65535.0f);
+        data.humidity_rh = 100.0f * (frame.humidity / 65535.0f);
+        data.pm_a = frame.pm_a;
+        data.pm_b = frame.pm_b;
+        data.pm_c = frame.pm_c;
+        data.reject_count_glitch = frame.reject_count_glitch;
+        data.reject_count_long_tof = frame.reject_count_long_tof;
+        data.reject_count_ratio = frame.reject_count_ratio;
+        data.fan_rev_count = frame.fan_rev_count;
+        data.laser_status = frame.laser_status;
+        data.received_checksum = frame.checksum;
+        data.checksum_ok = (calculated_crc == frame.checksum);
+    }
+
+    inline uint16_t computeChecksum(const OpcN3PmFrame &frame)
+    {
+        return OpcN3Crc16::compute(bytes(frame), PM_CRC_LENGTH);
+    }
+
+    inline void decode(const OpcN3PmFrame &frame, uint16_t calculated_crc, OpcN3PmData &data)
+    {
+        data.pm_a = frame.pm_a;
+        data.pm_b = frame.pm_b;
+        data.pm_c = frame.pm_c;
+        data.received_checksum = frame.checksum;
+        data.checksum_ok = (calculated_crc == frame.checksum);
+    }
+
+    // Hundredths as sent by the sensor, rounded and clamped to uint16_t
+    inline uint16_t toHundredths(float value)
+    {
+        float scaled = value * 100.0f + 0.5f;
+        if (scaled <= 0.0f)
+            return 0;
+        if (scaled >= 65535.0f)
+            return 65535;
+        return (uint16_t)scaled;
+    }
+
+    // Converts the configuration block into typed values; leaves version alone
+    inline void decode(const OpcN3ConfigFrame &frame, OpcN3Config &config)
+    {
+        for (int i = 0; i < 25; i++)
+        {
+            config.bin_boundaries_adc[i] = frame.bin_boundaries_adc[i];
+            config.bin_boundaries_um[i] = frame.bin_boundaries_um[i] / 100.0f;
+        }
+        for (int i = 0; i < 24; i++)
+            config.bin_weightings[i] = frame.bin_weightings[i] / 100.0f;
+        config.pm_diameter_a_um = frame.pm_diameter_a / 100.0f;
+        config.pm_diameter_b_um = frame.pm_diameter_b / 100.0f;
+        config.pm_diameter_c_um = frame.pm_diameter_c / 100.0f;
+        config.max_tof = frame.max_tof;
+        config.am_sampling_interval_count = frame.am_sampling_interval_count;
+        config.am_idle_interval_count = frame.am_idle_interval_count;
+        config.am_max_data_arrays_in_file = frame.am_max_data_arrays_in_file;
+        config.am_only_save_pm_data = frame.am_only_save_pm_data;
+        config.am_fan_on_in_idle = frame.am_fan_on_in_idle;
+        config.am_laser_on_in_idle = frame.am_laser_on_in_idle;
+        config.tof_to_sfr_factor = frame.tof_to_sfr_factor;
+        config.pvp = frame.pvp;
+        config.bin_weighting_index = frame.bin_weighting_index;
+    }
+
+    inline void encode(const OpcN3Config &config, OpcN3ConfigFrame &frame)
+    {
+        for (int i = 0; i < 25; i++)
+        {
+            frame.bin_boundaries_adc[i] = config.bin_boundaries_adc[i];
+            frame.bin_boundaries_um[i] = toHundredths(config.bin_boundaries_um[i]);
+        }
+        for (int i = 0; i < 24; i++)
+            frame.bin_weightings[i] = toHundredths(config.bin_weightings[i]);
+        frame.pm_diameter_a = toHundredths(config.pm_diameter_a_um);
+        frame.pm_diameter_b = toHundredths(config.pm_diameter_b_um);
+        frame.pm_diameter_c = toHundredths(config.pm_diameter_c_um);
+        frame.max_tof = config.max_tof;
+        frame.am_sampling_interval_count = config.am_sampling_interval_count;
+        frame.am_idle_interval_count = config.am_idle_interval_count;
+        frame.am_max_data_arrays_in_file = config.am_max_data_arrays_in_file;
+        frame.am_only_save_pm_data = config.am_only_save_pm_data;
+        frame.am_fan_on_in_idle = config.am_fan_on_in_idle;
+        frame.am_laser_on_in_idle = config.am_laser_on_in_idle;
+        frame.tof_to_sfr_factor = config.tof_to_sfr_factor;
+        frame.pvp = config.pvp;
+        frame.bin_weighting_index = config.bin_weighting_index;
+    }
+
+    // Compares the values the sensor would store, ignoring version
+    inline bool sameSettings(const OpcN3Config &a, const OpcN3Config &b)
+    {
+        OpcN3ConfigFrame fa, fb;
+        encode(a, fa);
+        encode(b, fb);
+        return memcmp(&fa, &fb, sizeof(fa)) == 0;
+    }
+
+    // Convenience for offline decoding of recorded frames
+    inline bool decode(const OpcN3HistogramFrame &frame, OpcN3Data &data)
+    {
+        decode(frame, computeChecksum(frame), data);
+        return data.checksum_ok;
+    }
+}
+
+#endif // OPCN3_FRAME_H
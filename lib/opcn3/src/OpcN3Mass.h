@@ -0,0 +1,178 @@
+#ifndef OPCN3_MASS_H
+#define OPCN3_MASS_H
+
+#include <math.h>
+#include <stdint.h>
+#include "OpcN3Accumulator.h"
+#include "OpcN3Distribution.h"
+
+// Particle properties for turning counts into mass. Particles below split_um
+// get the fine density, larger ones the coarse density. kappa is the
+// hygroscopicity parameter of kappa-Koehler theory (Petters & Kreidenweis
+// 2007): 0 for insoluble dust, about 0.1-0.3 for continental and urban
+// aerosol, about 1 for sea salt.
+struct OpcN3DensityProfile
+{
+    const char *name;
+    float fine_density_g_cm3;
+    float coarse_density_g_cm3;
+    float split_um;
+    float kappa;
+};
+
+// The Alphasense default density (1.65 g/cm3) with a typical urban kappa
+inline constexpr OpcN3DensityProfile OPCN3_PROFILE_URBAN = {"urban", 1.65f, 1.65f, 1.0f, 0.3f};
+inline constexpr OpcN3DensityProfile OPCN3_PROFILE_RURAL = {"rural", 1.5f, 2.0f, 1.0f, 0.2f};
+inline constexpr OpcN3DensityProfile OPCN3_PROFILE_MARINE = {"marine", 1.8f, 2.16f, 1.0f, 0.9f};
+inline constexpr OpcN3DensityProfile OPCN3_PROFILE_DUST = {"dust", 2.0f, 2.65f, 1.0f, 0.03f};
+inline constexpr OpcN3DensityProfile OPCN3_PROFILE_SMOKE = {"smoke", 1.3f, 1.5f, 1.0f, 0.1f};
+
+struct OpcN3MassConcentration
+{
+    float pm1, pm2_5, pm10;             // From the histogram as measured, in ug/m3
+    float pm1_dry, pm2_5_dry, pm10_dry; // Corrected for water uptake
+    float growth_factor;                // Wet / dry diameter at the sample humidity
+};
+
+// Rebuilds PM1/PM2.5/PM10 from bin concentrations and corrects them for
+// hygroscopic growth. At high humidity particles take up water and are
+// counted larger (and heavier) than their dry size. kappa-Koehler theory
+// gives the diameter growth factor
+//
+//   GF(RH) = (1 + kappa * aw / (1 - aw))^(1/3),  aw = RH / 100
+//
+// (without the Kelvin term, which is negligible above 0.1 um). The dry mass
+// of a bin is its measured volume divided by GF^3, and a particle counts
+// towards PM_x if its dry diameter Dp / GF is below x, with bins straddling
+// the cut-off split on a log scale.
+//
+// Bin masses and log edges are tabulated by configure(), and GF over 0-99 %RH
+// in a lookup table per profile, so a sample costs one interpolation and a
+// fixed loop over the 24 bins. Humidity above 99 %RH is clamped.
+class OpcN3MassEngine
+{
+public:
+    static const int BIN_COUNT = OpcN3BinGeometry::BIN_COUNT;
+    static const int LUT_SIZE = 100; // 0..99 %RH in 1 % steps
+
+    explicit OpcN3MassEngine(const OpcN3DensityProfile &profile = OPCN3_PROFILE_URBAN)
+    {
+        configure(OpcN3BinGeometry(), profile);
+    }
+
+    void configure(const OpcN3BinGeometry &geometry, const OpcN3DensityProfile &profile)
+    {
+        _profile = profile;
+        _config_version = geometry.config_version;
+        for (int i = 0; i < BIN_COUNT; i++)
+        {
+            float density = geometry.midpoint_um[i] < profile.split_um ? profile.fine_density_g_cm3
+                                                                       : profile.coarse_density_g_cm3;
+            // 1 particle/cm3 of 1 um3 at 1 g/cm3 is 1 ug/m3
+            _mass_ug_m3[i] = density * geometry.volume_um3[i];
+            _ln_lower[i] = geometry.ln_edges[i];
+            _inv_ln_width[i] = 1.0f / (geometry.ln_edges[i + 1] - geometry.ln_edges[i]);
+        }
+        for (int rh = 0; rh < LUT_SIZE; rh++)
+        {
+            float aw = rh / 100.0f;
+            float swelling = 1.0f + profile.kappa * aw / (1.0f - aw); // (Dp / Dp_dry)^3
+            _ln_gf[rh] = logf(swelling) / 3.0f;
+            _inv_gf3[rh] = 1.0f / swelling;
+        }
+    }
+
+    void configure(const OpcN3BinGeometry &geometry) { configure(geometry, _profile); }
+
+    const OpcN3DensityProfile &profile() const { return _profile; }
+
+    // Version of the configuration whose bin edges the tables were built from
+    uint16_t configVersion() const { return _config_version; }
+
+    float growthFactor(float humidity_rh) const
+    {
+        float ln_gf, inv_gf3;
+        lookup(humidity_rh, ln_gf, inv_gf3);
+        return expf(ln_gf);
+    }
+
+    // From per-bin concentrations (particles/cm3); a NAN humidity disables
+    // the correction. Returns false if the concentrations are not valid.
+    bool compute(const float *concentrations, float humidity_rh, OpcN3MassConcentration &out) const
+    {
+        static const float LN_CUTOFF[3] = {0.0f, 0.91629073f, 2.30258509f}; // ln(1), ln(2.5), ln(10)
+        float ln_gf, inv_gf3;
+        lookup(humidity_rh, ln_gf, inv_gf3);
+
+        float wet[3] = {0.0f, 0.0f, 0.0f};
+        float dry[3] = {0.0f, 0.0f, 0.0f};
+        for (int i = 0; i < BIN_COUNT; i++)
+        {
+            float mass = concentrations[i] * _mass_ug_m3[i];
+            for (int c = 0; c < 3; c++)
+            {
+                wet[c] += mass * fractionBelow(LN_CUTOFF[c], i);
+                dry[c] += mass * fractionBelow(LN_CUTOFF[c] + ln_gf, i);
+            }
+        }
+        out.pm1 = wet[0];
+        out.pm2_5 = wet[1];
+        out.pm10 = wet[2];
+        out.pm1_dry = dry[0] * inv_gf3;
+        out.pm2_5_dry = dry[1] * inv_gf3;
+        out.pm10_dry = dry[2] * inv_gf3;
+        out.growth_factor = expf(ln_gf);
+        return !isnan(out.pm10);
+    }
+
+    // One histogram read, corrected with the sensor's own humidity reading.
+    // Returns false if it was read under another configuration.
+    bool compute(const OpcN3Data &data, OpcN3MassConcentration &out) const
+    {
+        OpcN3Accumulator histogram;
+        if (data.config_version != _config_version || !histogram.add(data))
+            return false;
+        float concentrations[BIN_COUNT];
+        histogram.concentrations(concentrations);
+        return compute(concentrations, data.humidity_rh, out);
+    }
+
+private:
+    // Share of bin i (on a log scale) below the diameter exp(ln_cutoff)
+    float fractionBelow(float ln_cutoff, int i) const
+    {
+        float f = (ln_cutoff - _ln_lower[i]) * _inv_ln_width[i];
+        return f < 0.0f ? 0.0f : (f > 1.0f ? 1.0f : f);
+    }
+
+    void lookup(float humidity_rh, float &ln_gf, float &inv_gf3) const
+    {
+        if (!(humidity_rh > 0.0f)) // Also NAN
+        {
+            ln_gf = 0.0f;
+            inv_gf3 = 1.0f;
+            return;
+        }
+        float position = humidity_rh < LUT_SIZE - 1 ? humidity_rh : (float)(LUT_SIZE - 1);
+        int index = (int)position;
+        if (index >= LUT_SIZE - 1)
+        {
+            ln_gf = _ln_gf[LUT_SIZE - 1];
+            inv_gf3 = _inv_gf3[LUT_SIZE - 1];
+            return;
+        }
+        float t = position - index;
+        ln_gf = _ln_gf[index] + t * (_ln_gf[index + 1] - _ln_gf[index]);
+        inv_gf3 = _inv_gf3[index] + t * (_inv_gf3[index + 1] - _inv_gf3[index]);
+    }
+
+    OpcN3DensityProfile _profile;
+    uint16_t _config_version;
+    float _mass_ug_m3[BIN_COUNT];
+    float _ln_lower[BIN_COUNT];
+    float _inv_ln_width[BIN_COUNT];
+    float _ln_gf[LUT_SIZE];
+    float _inv_gf3[LUT_SIZE];
+};
+
+#endif // OPCN3_MASS_H
@@ -0,0 +1,291 @@
+#ifndef OPCN3_SIM_BUS_H
+#define OPCN3_SIM_BUS_H
+
+// Simulated OPC-N3 behind the OpcN3Driver bus interface, for running and
+// benchmarking the protocol logic on a host (Linux) build:
+//
+//   OpcN3Driver<OpcN3SimBus> opc{OpcN3SimBus()};
+//   opc.bus().setReadyLatencyMs(30);
+//   opc.begin();
+//
+// The simulated sensor answers the command-ready handshake with 0x31 (busy)
+// until the configured latency has passed and then with 0xF3 (ready), and
+// serves firmware, power control, histogram, PM and configuration commands
+// (read, write and save).
+// Time is virtual: it advances only through delayMs()/delayUs(), transfers
+// and advanceUs(), so simulated runs are deterministic and fast.
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include "OpcN3Driver.h"
+
+class OpcN3SimBus
+{
+public:
+    OpcN3SimBus()
+        : _now_us(0), _shared_clock(nullptr), _byte_time_us(16), _ready_latency_us(20000), _bit_error_rate(0.0f),
+          _random_state(0x2545F491), _verbose(false), _selected(false), _in_transaction(false),
+          _state(STATE_IDLE), _cmd(0), _ready_at_us(0), _response_len(0), _response_pos(0),
+          _payload_expected(0), _payload_pos(0), _fan_on(false), _laser_on(false),
+          _commands(0), _busy_replies(0), _bits_flipped(0), _saves(0)
+    {
+        memset(&_histogram, 0, sizeof(_histogram));
+        memset(_config_vars, 0, sizeof(_config_vars));
+        memset(_payload, 0, sizeof(_payload));
+        memset(_response, 0, sizeof(_response));
+
+        // Default bin boundaries from the datasheet, in 1/100 um
+        static const uint16_t boundaries[25] = {35, 46, 66, 100, 130, 170, 230, 300, 400, 500, 650, 800, 1000,
+                                                1200, 1400, 1600, 1800, 2000, 2200, 2500, 2800, 3100, 3400, 3700, 4000};
+        for (int i = 0; i < 25; i++)
+        {
+            _config_vars[50 + i * 2] = boundaries[i] & 0xFF;
+            _config_vars[50 + i * 2 + 1] = boundaries[i] >> 8;
+        }
+
+        for (int i = 0; i < 24; i++)
+            _histogram.bin_counts[i] = (uint16_t)(400 >> (i / 3));
+        _histogram.sampling_period = 1000;
+        _histogram.sample_flow_rate = 550;
+        _histogram.temperature = 26000;
+        _histogram.humidity = 30000;
+        _histogram.pm_a = 3.5f;
+        _histogram.pm_b = 6.25f;
+        _histogram.pm_c = 11.0f;
+        _histogram.laser_status = 600;
+    }
+
+    // --- Simulation controls ---
+    void setReadyLatencyMs(unsigned long ms) { _ready_latency_us = (uint64_t)ms * 1000; }
+    void setByteTimeUs(unsigned int us) { _byte_time_us = us; }
+    void setBitErrorRate(float rate) { _bit_error_rate = rate; } // Per transmitted response bit
+    void setVerbose(bool verbose) { _verbose = verbose; }
+    void advanceUs(uint64_t us) { clock() += us; }
+
+    // Runs this sensor on an external clock, so several simulated sensors
+    // on one bus see the same time
+    void setSharedClock(uint64_t *clock_us) { _shared_clock = clock_us; }
+
+    // Frame served by the next histogram command (the checksum is filled in)
+    OpcN3HistogramFrame &histogram() { return _histogram; }
+    uint8_t *configVars() { return _config_vars; }
+
+    bool fanOn() const { return _fan_on; }
+    bool laserOn() const { return _laser_on; }
+    uint64_t nowUs() const { return _shared_clock ? *_shared_clock : _now_us; }
+    uint32_t commandCount() const { return _commands; }
+    uint32_t busyReplies() const { return _busy_replies; }
+    uint32_t bitsFlipped() const { return _bits_flipped; }
+    uint32_t configSaves() const { return _saves; }
+
+    // --- Bus interface used by OpcN3Driver ---
+    void begin() { _selected = false; }
+    void beginTransaction() { _in_transaction = true; }
+    void endTransaction() { _in_transaction = false; }
+    void select() { _selected = true; }
+    void deselect() { _selected = false; }
+
+    uint8_t transfer(uint8_t out)
+    {
+        clock() += _byte_time_us;
+        return _selected ? respond(out) : 0xFF;
+    }
+
+    void transfer(uint8_t *buffer, size_t len)
+    {
+        for (size_t i = 0; i < len; i++)
+            buffer[i] = transfer(buffer[i]);
+    }
+
+    unsigned long millis() { return (unsigned long)(clock() / 1000); }
+    unsigned long micros() { return (unsigned long)clock(); }
+    void delayMs(unsigned long ms) { clock() += (uint64_t)ms * 1000; }
+    void delayUs(unsigned int us) { clock() += us; }
+
+    void log(const char *format, ...)
+    {
+        if (!_verbose)
+            return;
+        va_list args;
+        va_start(args, format);
+        vprintf(format, args);
+        va_end(args);
+    }
+
+private:
+    uint64_t &clock() { return _shared_clock ? *_shared_clock : _now_us; }
+
+    enum State
+    {
+        STATE_IDLE = 0,
+        STATE_WAIT_READY, // Command received, answering busy until ready
+        STATE_RESPONSE,   // Streaming response bytes
+        STATE_PAYLOAD     // Receiving payload bytes for a write command
+    };
+
+    uint8_t respond(uint8_t in)
+    {
+        switch (_state)
+        {
+        case STATE_IDLE:
+            _cmd = in;
+            _commands++;
+            _ready_at_us = clock() + _ready_latency_us;
+            _state = STATE_WAIT_READY;
+            return opcn3::RESP_BUSY;
+
+        case STATE_WAIT_READY:
+            if (in != _cmd)
+            {
+                _state = STATE_IDLE; // Aborted handshake; treat as a new command
+                return respond(in);
+            }
+            if (clock() < _ready_at_us)
+            {
+                _busy_replies++;
+                return opcn3::RESP_BUSY;
+            }
+            prepareResponse();
+            return opcn3::RESP_READY;
+
+        case STATE_RESPONSE:
+        {
+            uint8_t b = corrupt(_response[_response_pos++]);
+            if (_response_pos >= _response_len)
+                _state = STATE_IDLE;
+            return b;
+        }
+
+        case STATE_PAYLOAD:
+            _payload[_payload_pos++] = in;
+            if (_payload_pos >= _payload_expected)
+            {
+                applyPayload();
+                _state = STATE_IDLE;
+            }
+            return 0x00;
+        }
+        return 0xFF;
+    }
+
+    void prepareResponse()
+    {
+        _response_pos = 0;
+        _payload_pos = 0;
+        _state = STATE_RESPONSE;
+        switch (_cmd)
+        {
+        case opcn3::CMD_READ_FIRMWARE:
+            _response[0] = 3;
+            _response[1] = 1;
+            _response_len = 2;
+            break;
+        case opcn3::CMD_READ_HISTOGRAM:
+            _histogram.checksum = opcn3_frame::computeChecksum(_histogram);
+            memcpy(_response, opcn3_frame::bytes(_histogram), sizeof(_histogram));
+            _response_len = sizeof(_histogram);
+            break;
+        case opcn3::CMD_READ_PM:
+        {
+            OpcN3PmFrame pm;
+            pm.pm_a = _histogram.pm_a;
+            pm.pm_b = _histogram.pm_b;
+            pm.pm_c = _histogram.pm_c;
+            pm.checksum = opcn3_frame::computeChecksum(pm);
+            memcpy(_response, opcn3_frame::bytes(pm), sizeof(pm));
+            _response_len = sizeof(pm);
+            break;
+        }
+        case opcn3::CMD_READ_CONFIG_VARS:
+            memcpy(_response, _config_vars, sizeof(_config_vars));
+            _response_len = sizeof(_config_vars);
+            break;
+        case opcn3::CMD_POWER_CONTROL:
+            _payload_expected = 1;
+            _state = STATE_PAYLOAD;
+            break;
+        case opcn3::CMD_WRITE_CONFIG_VARS:
+            _payload_expected = sizeof(_config_vars);
+            _state = STATE_PAYLOAD;
+            break;
+        case opcn3::CMD_SAVE_CONFIG_VARS:
+            _payload_expected = sizeof(opcn3::SAVE_CONFIG_SEQUENCE);
+            _state = STATE_PAYLOAD;
+            break;
+        default:
+            _state = STATE_IDLE;
+            break;
+        }
+    }
+
+    void applyPayload()
+    {
+        if (_cmd == opcn3::CMD_POWER_CONTROL)
+        {
+            if (_payload[0] == opcn3::POWER_FAN_ON)
+                _fan_on = true;
+            else if (_payload[0] == opcn3::POWER_LASER_ON)
+                _laser_on = true;
+        }
+        else if (_cmd == opcn3::CMD_WRITE_CONFIG_VARS)
+        {
+            memcpy(_config_vars, _payload, sizeof(_config_vars));
+        }
+        else if (_cmd == opcn3::CMD_SAVE_CONFIG_VARS &&
+                 memcmp(_payload, opcn3::SAVE_CONFIG_SEQUENCE, sizeof(opcn3::SAVE_CONFIG_SEQUENCE)) == 0)
+        {
+            _saves++;
+        }
+    }
+
+    uint8_t corrupt(uint8_t b)
+    {
+        if (_bit_error_rate <= 0.0f)
+            return b;
+        for (int bit = 0; bit < 8; bit++)
+        {
+            _random_state ^= _random_state << 13;
+            _random_state ^= _random_state >> 17;
+            _random_state ^= _random_state << 5;
+            if ((_random_state & 0xFFFFFF) < (uint32_t)(_bit_error_rate * 16777216.0f))
+            {
+                b ^= (uint8_t)(1 << bit);
+                _bits_flipped++;
+            }
+        }
+        return b;
+    }
+
+    uint64_t _now_us;
+    uint64_t *_shared_clock;
+    unsigned int _byte_time_us;
+    uint64_t _ready_latency_us;
+    float _bit_error_rate;
+    uint32_t _random_state;
+    bool _verbose;
+    bool _selected;
+    bool _in_transaction;
+
+    State _state;
+    uint8_t _cmd;
+    uint64_t _ready_at_us;
+    uint8_t _response[opcn3::CONFIG_VARS_SIZE];
+    size_t _response_len;
+    size_t _response_pos;
+    uint8_t _payload[opcn3::CONFIG_VARS_SIZE];
+    size_t _payload_expected;
+    size_t _payload_pos;
+
+    OpcN3HistogramFrame _histogram;
+    uint8_t _config_vars[opcn3::CONFIG_VARS_SIZE];
+    bool _fan_on;
+    bool _laser_on;
+
+    uint32_t _commands;
+    uint32_t _busy_replies;
+    uint32_t _bits_flipped;
+    uint32_t _saves;
+};
+
+#endif // OPCN3_SIM_BUS_H
@@ -3,13 +3,20 @@
 #include <ArduinoJson.h>
 #include <Arduino.h>
 
+static const char *WEATHER_HOST = "api.open-meteo.com";
+static const char *AIR_QUALITY_HOST = "air-quality-api.open-meteo.com";
+
 OpenMeteoClient::OpenMeteoClient(float latitude, float longitude,
                                  uint32_t intervalMs)
     : _latitude(latitude), _longitude(longitude),
-      _minUpdateInterval(intervalMs), _lastUpdateMs(0)
+      _minUpdateInterval(intervalMs), _lastUpdateMs(0), _stats(), _keepAlive(false)
 {
     memset(&_data, 0, sizeof(_data));
     _data.valid = false;
+    // Like the plain HTTPClient before, the server certificate is not pinned
+    _weatherTls.setInsecure();
+    _airTls.setInsecure();
+    _http.setReuse(true);
 }
 
 bool OpenMeteoClient::update()
@@ -23,19 +30,24 @@ bool OpenMeteoClient::update()
 
     bool weatherOk = fetchCurrent();
     bool airOk = fetchAirQuality();
+    if (!_keepAlive)
+    {
+        _weatherTls.stop();
+        _airTls.stop();
+    }
     _data.valid = weatherOk || airOk;
     return _data.valid;
 }
 
 bool OpenMeteoClient::fetchCurrent()
 {
-    String url = String("https://api.open-meteo.com/v1/forecast?latitude=") + String(_latitude, 4) +
+    String url = String("https://") + WEATHER_HOST + "/v1/forecast?latitude=" + String(_latitude, 4) +
                  "&longitude=" + String(_longitude, 4) +
                  "&current=temperature_2m,relative_humidity_2m,apparent_temperature,is_day,rain,cloud_cover,pressure_msl,surface_pressure,wind_speed_10m,wind_direction_10m,wind_gusts_10m&timezone=Europe%2FBerlin";
     Serial.print("Fetching weather from: ");
     Serial.println(url);
     JsonDocument doc;
-    if (!fetchJson(url, doc)) {
+    if (!fetchJson(_weatherTls, WEATHER_HOST, url, doc)) {
         return false;
     }
     JsonObject current = doc["current"];
@@ -55,13 +67,13 @@ bool OpenMeteoClient::fetchCurrent()
 
 bool OpenMeteoClient::fetchAirQuality()
 {
-    String url = String("https://air-quality-api.open-meteo.com/v1/air-quality?latitude=") + String(_latitude, 4) +
+    String url = String("https://") + AIR_QUALITY_HOST + "/v1/air-quality?latitude=" + String(_latitude, 4) +
                  "&longitude=" + String(_longitude, 4) +
                  "&current=ragweed_pollen,olive_pollen,mugwort_pollen,grass_pollen,birch_pollen,alder_pollen,dust,carbon_monoxide,pm2_5,pm10,european_aqi&timezone=Europe%2FBerlin";
     Serial.print("Fetching air quality from: ");
     Serial.println(url);
     JsonDocument doc;
-    if (!fetchJson(url, doc)) {
+    if (!fetchJson(_airTls, AIR_QUALITY_HOST, url, doc)) {
         return false;
     }
     JsonObject current = doc["current"];
@@ -79,27 +91,65 @@ bool OpenMeteoClient::fetchAirQuality()
     return true;
 }
 
-bool OpenMeteoClient::fetchJson(const String &url, JsonDocument &doc)
+bool OpenMeteoClient::fetchJson(WiFiClientSecure &tls, const char *host, const String &url, JsonDocument &doc)
 {
-    HTTPClient http;
     for (uint8_t attempt = 0; attempt < MAX_RETRIES; ++attempt)
     {
-        http.begin(url);
-        http.setConnectTimeout(HTTP_TIMEOUT_MS);
-        http.setTimeout(HTTP_TIMEOUT_MS);
-        int code = http.GET();
-        if (code == HTTP_CODE_OK)
+        unsigned long startedMs = millis();
+        _stats.requests++;
+        if (tls.connected())
+        {
+            _stats.reused++;
+        }
+        else
         {
-            DeserializationError err = deserializeJson(doc, http.getString());
-            http.end();
-            if (!err)
+            tls.stop();
+            _stats.handshakes++;
+            bool connected = tls.connect(host, 443, HTTP_TIMEOUT_MS);
+            _stats.handshake_ms += millis() - startedMs;
+            if (!connected)
             {
-                return true;
+                recordRequest(millis() - startedMs, false);
+                delay(500);
+                continue;
             }
         }
-        http.end();
+
+        _http.begin(tls, url);
+        _http.setConnectTimeout(HTTP_TIMEOUT_MS);
+        _http.setTimeout(HTTP_TIMEOUT_MS);
+        int code = _http.GET();
+        bool ok = false;
+        if (code == HTTP_CODE_OK)
+        {
+            DeserializationError err = deserializeJson(doc, _http.getString());
+            ok = !err;
+        }
+        _http.end();
+        if (code < 0)
+        {
+            tls.stop(); // Unknown state after a network error
+        }
+        recordRequest(millis() - startedMs, ok);
+        if (ok)
+        {
+            return true;
+        }
         delay(500);
     }
     return false;
 }
 
+void OpenMeteoClient::recordRequest(uint32_t elapsedMs, bool ok)
+{
+    if (!ok)
+    {
+        _stats.failures++;
+    }
+    _stats.last_request_ms = elapsedMs;
+    if (elapsedMs > _stats.max_request_ms)
+    {
+        _stats.max_request_ms = elapsedMs;
+    }
+    _stats.total_request_ms += elapsedMs;
+}
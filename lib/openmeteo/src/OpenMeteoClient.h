@@ -3,6 +3,8 @@
 
 #include <Arduino.h>
 #include <ArduinoJson.h>
+#include <HTTPClient.h>
+#include <WiFiClientSecure.h>
 
 struct OpenMeteoData {
     float temperature_c;
@@ -31,12 +33,33 @@ struct OpenMeteoData {
     bool valid;
 };
 
+// Request counters; a handshake is a new TLS connection, a reused request
+// went out on a connection kept open from an earlier one
+struct OpenMeteoStats {
+    uint32_t requests;
+    uint32_t failures;
+    uint32_t handshakes;
+    uint32_t reused;
+    uint64_t handshake_ms;
+    uint32_t last_request_ms;
+    uint32_t max_request_ms;
+    uint64_t total_request_ms;
+};
+
+// Fetches current weather and air quality. Each of the two API hosts has its
+// own connection, which is reused for the retries of an update and closed
+// when update() returns: updates are minutes apart, so the server would close
+// an idle connection anyway, and two open TLS sessions would hold their
+// buffers on the heap all that time.
 class OpenMeteoClient {
 public:
     explicit OpenMeteoClient(float latitude, float longitude,
                              uint32_t intervalMs = 600000);
     bool update();
     const OpenMeteoData &data() const { return _data; }
+    const OpenMeteoStats &stats() const { return _stats; }
+    // Keeps the connections open between updates, e.g. for short intervals
+    void setKeepAlive(bool enabled) { _keepAlive = enabled; }
 
 private:
     static constexpr uint32_t HTTP_TIMEOUT_MS = 10000; // 10s timeout
@@ -46,9 +69,15 @@ private:
     uint32_t _minUpdateInterval;
     unsigned long _lastUpdateMs;
     OpenMeteoData _data;
+    OpenMeteoStats _stats;
+    bool _keepAlive;
+    WiFiClientSecure _weatherTls;
+    WiFiClientSecure _airTls;
+    HTTPClient _http;
     bool fetchCurrent();
     bool fetchAirQuality();
-    bool fetchJson(const String &url, JsonDocument &doc);
+    bool fetchJson(WiFiClientSecure &tls, const char *host, const String &url, JsonDocument &doc);
+    void recordRequest(uint32_t elapsedMs, bool ok);
 };
 
 #endif // OPEN_METEO_CLIENT_H
@@ -0,0 +1,79 @@
+#ifndef PIPELINE_STAGE_H
+#define PIPELINE_STAGE_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "PipelineStageStats.h"
+
+struct PipelineStageConfig
+{
+    const char *name;
+    uint32_t stack_size; // In bytes
+    UBaseType_t priority;
+    BaseType_t core;
+};
+
+// One task of the processing pipeline, pinned to a core. Stages hand items to
+// each other through queues and wake the next stage with a task notification,
+// so idle stages block instead of polling.
+class PipelineStage
+{
+public:
+    PipelineStage(const PipelineStageConfig &config, TaskFunction_t function)
+        : _config(config), _function(function), _handle(nullptr), _stats()
+    {
+    }
+
+    bool start()
+    {
+        return xTaskCreatePinnedToCore(_function, _config.name, _config.stack_size, this,
+                                       _config.priority, &_handle, _config.core) == pdPASS;
+    }
+
+    // Wakes the stage, e.g. after pushing an item into its input queue
+    void notify()
+    {
+        if (_handle)
+            xTaskNotifyGive(_handle);
+    }
+
+    // Called by the stage itself; returns early when notified
+    void waitForWork(uint32_t timeout_ms) { ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(timeout_ms)); }
+
+    // Called by the stage after finishing an item
+    void recordItem(uint32_t acquired_ms, uint32_t started_us, size_t backlog)
+    {
+        _stats.record(millis() - acquired_ms, micros() - started_us, backlog);
+    }
+
+    const char *name() const { return _config.name; }
+
+    PipelineStageStats stats()
+    {
+        if (_handle)
+            _stats.stack_free_bytes = uxTaskGetStackHighWaterMark(_handle) * sizeof(StackType_t);
+        return _stats;
+    }
+
+    void printStats()
+    {
+        PipelineStageStats s = stats();
+        Serial.printf("  %-12s core %d: %lu items, latency last %lu / avg %lu / max %lu ms, "
+                      "busy %lu ms, backlog %lu (max %lu), stack free %lu B\n",
+                      _config.name, (int)_config.core, (unsigned long)s.items,
+                      (unsigned long)s.last_latency_ms,
+                      (unsigned long)s.averageLatencyMs(),
+                      (unsigned long)s.max_latency_ms, (unsigned long)(s.busy_us / 1000),
+                      (unsigned long)s.backlog, (unsigned long)s.max_backlog,
+                      (unsigned long)s.stack_free_bytes);
+    }
+
+private:
+    PipelineStageConfig _config;
+    TaskFunction_t _function;
+    TaskHandle_t _handle;
+    PipelineStageStats _stats;
+};
+
+#endif // PIPELINE_STAGE_H
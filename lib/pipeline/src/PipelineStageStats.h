@@ -0,0 +1,37 @@
+#ifndef PIPELINE_STAGE_STATS_H
+#define PIPELINE_STAGE_STATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Latency and load counters of one stage. Latency is measured from the time
+// the sample was acquired to the time this stage finished with it.
+struct PipelineStageStats
+{
+    uint32_t items;
+    uint32_t last_latency_ms;
+    uint32_t max_latency_ms;
+    uint64_t total_latency_ms;
+    uint64_t busy_us;           // Time spent working on items
+    uint32_t backlog;           // Items waiting in the input queue
+    uint32_t max_backlog;
+    uint32_t stack_free_bytes;  // Lowest free stack seen (high water mark)
+
+    // Counts one finished item
+    void record(uint32_t latency_ms, uint32_t item_busy_us, size_t queued)
+    {
+        items++;
+        last_latency_ms = latency_ms;
+        if (latency_ms > max_latency_ms)
+            max_latency_ms = latency_ms;
+        total_latency_ms += latency_ms;
+        busy_us += item_busy_us;
+        backlog = (uint32_t)queued;
+        if (backlog > max_backlog)
+            max_backlog = backlog;
+    }
+
+    uint32_t averageLatencyMs() const { return items ? (uint32_t)(total_latency_ms / items) : 0; }
+};
+
+#endif // PIPELINE_STAGE_STATS_H
@@ -0,0 +1,186 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <type_traits>
+
+#if defined(ARDUINO)
+#include <Arduino.h>
+#else
+#include <chrono>
+#include <thread>
+#endif
+
+// What push() does when the queue is full
+enum SpscOverflowPolicy
+{
+    SPSC_DROP_NEWEST = 0, // Reject the new item
+    SPSC_DROP_OLDEST,     // Discard the oldest queued item to make room
+    SPSC_BLOCK            // Wait for the consumer, up to the block timeout
+};
+
+struct SpscQueueStats
+{
+    uint32_t pushed;
+    uint32_t popped;
+    uint32_t dropped_newest; // Rejected because the queue was full
+    uint32_t dropped_oldest; // Overwritten before the consumer got to them
+    uint32_t blocked;        // Pushes that had to wait for space
+    uint32_t high_water;     // Highest number of queued items seen
+};
+
+// Fixed-capacity, lock-free ring buffer between exactly one producer task
+// and one consumer task. Items are copied in and out, so T should be a
+// plain struct. No allocation happens after construction.
+//
+// The producer owns _head and the consumer owns _tail. The only exception
+// is SPSC_DROP_OLDEST: when full, the producer advances _tail with a
+// compare-exchange, and the consumer claims items with a compare-exchange
+// too, retrying if its item was dropped while it was being copied.
+//
+// That copy can be torn: once the producer has advanced _tail past a full
+// queue's oldest item, it writes the new item into the same slot while the
+// consumer may still be reading it. The consumer only keeps a copy if its
+// exchange from the _tail it read before copying succeeds, and the producer
+// only writes the slot after its own exchange has moved _tail on, so a kept
+// copy was never written to concurrently and a torn one is always thrown
+// away. Throwing it away is only harmless for trivially copyable T, which
+// has no copy assignment that could act on half-written members.
+template <typename T, size_t Capacity>
+class SpscQueue
+{
+    static_assert(Capacity >= 2, "SpscQueue needs room for at least two items");
+    static_assert(std::is_trivially_copyable<T>::value, "SpscQueue items are copied racily; T must be a plain struct");
+
+public:
+    explicit SpscQueue(SpscOverflowPolicy policy = SPSC_DROP_OLDEST, uint32_t block_timeout_ms = 1000)
+        : _head(0), _tail(0), _policy(policy), _block_timeout_ms(block_timeout_ms), _stats()
+    {
+    }
+
+    // Producer side. Returns false if the item was not queued.
+    bool push(const T &item);
+
+    // Consumer side. Returns false if the queue is empty.
+    bool pop(T &item);
+
+    size_t size() const
+    {
+        size_t tail = _tail.load(std::memory_order_acquire); // Tail first, so head >= tail
+        return _head.load(std::memory_order_acquire) - tail;
+    }
+    bool empty() const { return size() == 0; }
+    static constexpr size_t capacity() { return Capacity; }
+
+    SpscOverflowPolicy policy() const { return _policy; }
+
+    // Counters are written by one side each and can be read from any task
+    SpscQueueStats stats() const { return _stats; }
+    uint32_t dropped() const { return _stats.dropped_newest + _stats.dropped_oldest; }
+
+private:
+    static void pause()
+    {
+#if defined(ARDUINO)
+        delay(1); // Lets lower-priority consumers run
+#else
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+#endif
+    }
+
+    bool dropOldest(size_t head);
+
+    T _items[Capacity];
+    // Free-running indices; the slot is index % Capacity
+    std::atomic<size_t> _head;
+    std::atomic<size_t> _tail;
+    SpscOverflowPolicy _policy;
+    uint32_t _block_timeout_ms;
+    SpscQueueStats _stats;
+};
+
+template <typename T, size_t Capacity>
+bool SpscQueue<T, Capacity>::push(const T &item)
+{
+    size_t head = _head.load(std::memory_order_relaxed);
+    if (head - _tail.load(std::memory_order_acquire) >= Capacity)
+    {
+        if (_policy == SPSC_DROP_NEWEST)
+        {
+            _stats.dropped_newest++;
+            return false;
+        }
+        if (_policy == SPSC_DROP_OLDEST)
+        {
+            dropOldest(head);
+        }
+        else
+        {
+            _stats.blocked++;
+            uint32_t waited_ms = 0;
+            while (head - _tail.load(std::memory_order_acquire) >= Capacity)
+            {
+                if (waited_ms++ >= _block_timeout_ms)
+                {
+                    _stats.dropped_newest++;
+                    return false;
+                }
+                pause();
+            }
+        }
+    }
+
+    _items[head % Capacity] = item;
+    _head.store(head + 1, std::memory_order_release);
+    _stats.pushed++;
+
+    size_t used = head + 1 - _tail.load(std::memory_order_acquire);
+    if (used > _stats.high_water)
+        _stats.high_water = used;
+    return true;
+}
+
+template <typename T, size_t Capacity>
+bool SpscQueue<T, Capacity>::dropOldest(size_t head)
+{
+    size_t tail = _tail.load(std::memory_order_acquire);
+    if (head - tail < Capacity)
+        return false; // The consumer made room in the meantime
+
+    // Fails only if the consumer claimed the same item, which frees a slot too
+    if (_tail.compare_exchange_strong(tail, tail + 1, std::memory_order_acq_rel))
+    {
+        _stats.dropped_oldest++;
+        return true;
+    }
+    return false;
+}
+
+template <typename T, size_t Capacity>
+bool SpscQueue<T, Capacity>::pop(T &item)
+{
+    size_t tail = _tail.load(std::memory_order_acquire);
+    for (;;)
+    {
+        if (tail == _head.load(std::memory_order_acquire))
+            return false;
+
+        item = _items[tail % Capacity];
+        if (_policy != SPSC_DROP_OLDEST)
+        {
+            _tail.store(tail + 1, std::memory_order_release);
+            break;
+        }
+        // The producer may have dropped this item while it was being copied,
+        // leaving a torn copy in item; tail is reloaded by a failed exchange
+        // and the copy is retried
+        if (_tail.compare_exchange_strong(tail, tail + 1, std::memory_order_acq_rel))
+            break;
+    }
+    _stats.popped++;
+    return true;
+}
+
+#endif // SPSC_QUEUE_H
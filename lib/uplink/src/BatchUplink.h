@@ -0,0 +1,231 @@
+#ifndef BATCH_UPLINK_H
+#define BATCH_UPLINK_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Outcome of one write request, as reported by the transport
+enum UplinkWriteResult
+{
+    UPLINK_WRITE_OK = 0,
+    UPLINK_WRITE_RETRY,   // Network error, timeout, 5xx, 429: send the batch again later
+    UPLINK_WRITE_REJECTED // Server refused the data (4xx); retrying will not help
+};
+
+// Outcome of an InfluxDB write by HTTP status code. 400 (malformed lines),
+// 413 (too large) and 422 (outside retention) refuse the data itself.
+// Everything else, including network errors (negative codes) and
+// authorization failures, is worth another attempt.
+inline UplinkWriteResult classifyInfluxStatus(int statusCode)
+{
+    if (statusCode == 200 || statusCode == 204)
+        return UPLINK_WRITE_OK;
+    if (statusCode == 400 || statusCode == 413 || statusCode == 422)
+        return UPLINK_WRITE_REJECTED;
+    return UPLINK_WRITE_RETRY;
+}
+
+enum UplinkFlushResult
+{
+    UPLINK_FLUSH_IDLE = 0, // Nothing due
+    UPLINK_FLUSH_SENT,
+    UPLINK_FLUSH_FAILED,  // Kept for a retry after the backoff
+    UPLINK_FLUSH_DROPPED  // Rejected by the server and discarded
+};
+
+struct BatchUplinkConfig
+{
+    uint16_t max_points;     // Flush once this many lines are buffered
+    uint32_t max_age_ms;     // ... or once the oldest line is this old
+    uint32_t retry_ms;       // First retry delay; doubles per failure
+    uint32_t max_retry_ms;   // Upper bound of the retry delay
+};
+
+struct BatchUplinkStats
+{
+    uint32_t requests;          // Successful write requests
+    uint32_t requests_failed;   // Failed attempts, including retries
+    uint32_t points_sent;
+    uint32_t points_dropped;    // Rejected by the server
+    uint32_t points_overflowed; // Not accepted because the buffer was full
+    uint32_t bytes_sent;
+    uint16_t max_points_per_request;
+    uint32_t last_request_ms;   // Duration of the last attempt
+    uint32_t max_request_ms;
+    uint64_t total_request_ms;  // Over all attempts, successful or not
+};
+
+// Collects line protocol lines in a fixed buffer of Capacity bytes and writes
+// them as one multi-line request, once max_points lines are buffered,
+// max_age_ms passed since the first one, or the buffer is three quarters
+// full. A failed request is retried with the whole batch after an
+// exponential backoff; lines added in the meantime join it. When the buffer
+// is full, add() refuses new lines, so the caller can keep them elsewhere
+// (e.g. in the journal). Lines can also be serialized straight into the
+// buffer with reserve() and commit(). Memory use is fixed at Capacity bytes.
+//
+// The Transport policy sends a request and provides the clock:
+//
+//   UplinkWriteResult write(const char *body, size_t len); // body is NUL-terminated
+//   unsigned long millis();
+template <class Transport, size_t Capacity>
+class BatchUplink
+{
+public:
+    BatchUplink(Transport &transport, const BatchUplinkConfig &config)
+        : _transport(transport), _config(config), _used(0), _points(0), _first_ms(0), _failures(0), _retry_at_ms(0),
+          _stats()
+    {
+        _buffer[0] = '\0';
+    }
+
+    // Appends one line (without trailing newline); false if it does not fit
+    bool add(const char *line, size_t len)
+    {
+        size_t room = 0;
+        char *tail = reserve(room);
+        if (len >= room)
+            len = 0;
+        else
+            memcpy(tail, line, len);
+        return commit(len);
+    }
+
+    // Free space for writing the next line in place, e.g. with a
+    // LineProtocolWriter of size room, so that no separate line buffer is
+    // needed. The line must then be committed with its length.
+    char *reserve(size_t &room)
+    {
+        room = Capacity - _used - 1;
+        return _buffer + _used;
+    }
+
+    // Adds the line written at reserve(); a length of 0 (the line did not
+    // fit) counts as overflowed and returns false
+    bool commit(size_t len)
+    {
+        if (len == 0 || _used + len + 1 >= Capacity)
+        {
+            _stats.points_overflowed++;
+            _buffer[_used] = '\0';
+            return false;
+        }
+        if (_points == 0)
+            _first_ms = _transport.millis();
+        _used += len;
+        _buffer[_used++] = '\n';
+        _buffer[_used] = '\0';
+        _points++;
+        return true;
+    }
+
+    // True if a flush would send now: the batch is full or old enough and
+    // no retry backoff is pending
+    bool due()
+    {
+        if (_points == 0)
+            return false;
+        unsigned long now = _transport.millis();
+        if (_failures > 0)
+            return (long)(now - _retry_at_ms) >= 0;
+        return _points >= _config.max_points || now - _first_ms >= _config.max_age_ms || _used >= Capacity * 3 / 4;
+    }
+
+    // Milliseconds until due() turns true by itself, for the caller's wait;
+    // 0 if it already is, UINT32_MAX if the batch is empty
+    uint32_t msUntilDue()
+    {
+        if (_points == 0)
+            return UINT32_MAX;
+        if (due())
+            return 0;
+        unsigned long now = _transport.millis();
+        if (_failures > 0)
+            return (uint32_t)(_retry_at_ms - now);
+        return (uint32_t)(_config.max_age_ms - (now - _first_ms));
+    }
+
+    // Sends the batch if it is due; force sends any buffered lines now
+    UplinkFlushResult flush(bool force = false)
+    {
+        if (_points == 0 || (!force && !due()))
+            return UPLINK_FLUSH_IDLE;
+
+        unsigned long started = _transport.millis();
+        UplinkWriteResult result = _transport.write(_buffer, _used);
+        uint32_t elapsed = (uint32_t)(_transport.millis() - started);
+        _stats.last_request_ms = elapsed;
+        if (elapsed > _stats.max_request_ms)
+            _stats.max_request_ms = elapsed;
+        _stats.total_request_ms += elapsed;
+
+        if (result == UPLINK_WRITE_OK)
+        {
+            _stats.requests++;
+            _stats.points_sent += _points;
+            _stats.bytes_sent += _used;
+            if (_points > _stats.max_points_per_request)
+                _stats.max_points_per_request = _points;
+            clear();
+            return UPLINK_FLUSH_SENT;
+        }
+
+        _stats.requests_failed++;
+        if (result == UPLINK_WRITE_REJECTED)
+        {
+            _stats.points_dropped += _points;
+            clear();
+            return UPLINK_FLUSH_DROPPED;
+        }
+
+        uint32_t delay = _config.retry_ms;
+        for (uint8_t i = 0; i < _failures && delay < _config.max_retry_ms; i++)
+            delay *= 2;
+        if (delay > _config.max_retry_ms)
+            delay = _config.max_retry_ms;
+        if (_failures < 255)
+            _failures++;
+        _retry_at_ms = _transport.millis() + delay;
+        return UPLINK_FLUSH_FAILED;
+    }
+
+    // Discards the buffered lines and any pending retry, e.g. once the
+    // caller has kept them elsewhere
+    void clear()
+    {
+        _used = 0;
+        _points = 0;
+        _failures = 0;
+        _buffer[0] = '\0';
+    }
+
+    // The buffered lines, each terminated by '\n'
+    const char *lines() const { return _buffer; }
+    uint16_t points() const { return _points; }
+    size_t bytes() const { return _used; }
+    size_t capacity() const { return Capacity; }
+    bool retrying() const { return _failures > 0; }
+    const BatchUplinkStats &stats() const { return _stats; }
+
+    float pointsPerRequest() const { return _stats.requests ? (float)_stats.points_sent / _stats.requests : 0.0f; }
+
+    uint32_t averageRequestMs() const
+    {
+        uint32_t attempts = _stats.requests + _stats.requests_failed;
+        return attempts ? (uint32_t)(_stats.total_request_ms / attempts) : 0;
+    }
+
+private:
+    Transport &_transport;
+    BatchUplinkConfig _config;
+    char _buffer[Capacity];
+    size_t _used;
+    uint16_t _points;
+    unsigned long _first_ms;
+    uint8_t _failures;
+    unsigned long _retry_at_ms;
+    BatchUplinkStats _stats;
+};
+
+#endif // BATCH_UPLINK_H
@@ -0,0 +1,203 @@
+#ifndef GZIP_COMPRESSOR_H
+#define GZIP_COMPRESSOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Small gzip (RFC 1952) compressor for request bodies that are already in RAM.
+// It emits a single deflate block with the fixed Huffman code and finds
+// matches through a hash table of the last position of every 3-byte prefix.
+// The input itself serves as the LZ77 window, so the only state is the hash
+// table: 2^HashBits 16-bit entries (4 KB by default), independent of the
+// input size. Line protocol repeats its field names on every line and
+// typically shrinks 4-8x.
+//
+// Inputs are limited to 64 KB, because positions are kept in 16 bits.
+template <uint8_t HashBits = 11>
+class GzipCompressorT
+{
+public:
+    static const size_t MAX_INPUT_SIZE = 65535;
+    static const size_t HEADER_SIZE = 10;
+    static const size_t TRAILER_SIZE = 8;
+
+    // Compresses len bytes of in into out. Returns the gzip size, or 0 if the
+    // result did not fit into size bytes (send the data uncompressed then).
+    size_t compress(const uint8_t *in, size_t len, uint8_t *out, size_t size)
+    {
+        if (len > MAX_INPUT_SIZE || size < HEADER_SIZE + TRAILER_SIZE + 2)
+            return 0;
+        memset(_head, 0, sizeof(_head));
+        _out = out;
+        _size = size - TRAILER_SIZE;
+        _pos = 0;
+        _bits = 0;
+        _bit_count = 0;
+        _ok = true;
+
+        static const uint8_t HEADER[HEADER_SIZE] = {0x1F, 0x8B, 8, 0, 0, 0, 0, 0, 0, 0xFF};
+        memcpy(_out, HEADER, HEADER_SIZE);
+        _pos = HEADER_SIZE;
+
+        putBits(1, 1); // Final block
+        putBits(1, 2); // Fixed Huffman codes
+        size_t i = 0;
+        while (i < len && _ok)
+        {
+            size_t match_len = 0;
+            size_t distance = 0;
+            if (i + 3 <= len)
+            {
+                uint32_t h = hash(in + i);
+                size_t candidate = _head[h];
+                _head[h] = (uint16_t)(i + 1);
+                if (candidate > 0 && i - (candidate - 1) <= MAX_DISTANCE)
+                {
+                    const uint8_t *a = in + candidate - 1;
+                    const uint8_t *b = in + i;
+                    size_t limit = len - i < MAX_MATCH ? len - i : MAX_MATCH;
+                    while (match_len < limit && a[match_len] == b[match_len])
+                        match_len++;
+                    distance = i - (candidate - 1);
+                }
+            }
+
+            if (match_len >= 3)
+            {
+                putMatch(match_len, distance);
+                // Index the skipped positions so later lines find them
+                for (size_t k = i + 1; k < i + match_len && k + 3 <= len; k++)
+                    _head[hash(in + k)] = (uint16_t)(k + 1);
+                i += match_len;
+            }
+            else
+            {
+                putLiteral(in[i]);
+                i++;
+            }
+        }
+        putSymbol(256); // End of block
+        if (_bit_count > 0)
+            putByte((uint8_t)_bits);
+        if (!_ok)
+            return 0;
+
+        uint32_t crc = crc32(in, len);
+        for (int k = 0; k < 4; k++)
+            _out[_pos++] = (uint8_t)(crc >> (8 * k));
+        for (int k = 0; k < 4; k++)
+            _out[_pos++] = (uint8_t)(len >> (8 * k));
+        return _pos;
+    }
+
+    // CRC-32 (IEEE, reflected) with a 16-entry table
+    static uint32_t crc32(const uint8_t *data, size_t len)
+    {
+        static const uint32_t TABLE[16] = {
+            0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+            0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C};
+        uint32_t crc = 0xFFFFFFFF;
+        for (size_t i = 0; i < len; i++)
+        {
+            crc ^= data[i];
+            crc = (crc >> 4) ^ TABLE[crc & 0x0F];
+            crc = (crc >> 4) ^ TABLE[crc & 0x0F];
+        }
+        return ~crc;
+    }
+
+private:
+    static const size_t MAX_MATCH = 258;
+    static const size_t MAX_DISTANCE = 32768;
+
+    static uint32_t hash(const uint8_t *p)
+    {
+        uint32_t v = (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16);
+        return (v * 2654435761u) >> (32 - HashBits);
+    }
+
+    void putByte(uint8_t value)
+    {
+        if (_pos < _size)
+            _out[_pos++] = value;
+        else
+            _ok = false;
+    }
+
+    // Deflate packs bits starting at the least significant one
+    void putBits(uint32_t value, uint8_t count)
+    {
+        _bits |= value << _bit_count;
+        _bit_count += count;
+        while (_bit_count >= 8)
+        {
+            putByte((uint8_t)_bits);
+            _bits >>= 8;
+            _bit_count -= 8;
+        }
+    }
+
+    // Huffman codes are defined most significant bit first
+    void putCode(uint32_t code, uint8_t length)
+    {
+        uint32_t reversed = 0;
+        for (uint8_t i = 0; i < length; i++)
+        {
+            reversed = (reversed << 1) | (code & 1);
+            code >>= 1;
+        }
+        putBits(reversed, length);
+    }
+
+    // Fixed literal/length code (RFC 1951, 3.2.6)
+    void putSymbol(uint16_t symbol)
+    {
+        if (symbol < 144)
+            putCode(0x30 + symbol, 8);
+        else if (symbol < 256)
+            putCode(0x190 + symbol - 144, 9);
+        else if (symbol < 280)
+            putCode(symbol - 256, 7);
+        else
+            putCode(0xC0 + symbol - 280, 8);
+    }
+
+    void putLiteral(uint8_t value) { putSymbol(value); }
+
+    void putMatch(size_t length, size_t distance)
+    {
+        static const uint16_t LENGTH_BASE[29] = {3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+                                                 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+        static const uint8_t LENGTH_EXTRA[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                                                 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+        static const uint16_t DIST_BASE[30] = {1,    2,    3,    4,    5,    7,     9,     13,    17,  25,
+                                               33,   49,   65,   97,   129,  193,   257,   385,   513, 769,
+                                               1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+        static const uint8_t DIST_EXTRA[30] = {0, 0, 0, 0, 1, 1, 2, 2,  3,  3,  4,  4,  5,  5,  6,
+                                               6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+        int l = 28;
+        while (LENGTH_BASE[l] > length)
+            l--;
+        putSymbol((uint16_t)(257 + l));
+        putBits((uint32_t)(length - LENGTH_BASE[l]), LENGTH_EXTRA[l]);
+
+        int d = 29;
+        while (DIST_BASE[d] > distance)
+            d--;
+        putCode((uint32_t)d, 5);
+        putBits((uint32_t)(distance - DIST_BASE[d]), DIST_EXTRA[d]);
+    }
+
+    uint16_t _head[1u << HashBits];
+    uint8_t *_out;
+    size_t _size;
+    size_t _pos;
+    uint32_t _bits;
+    uint8_t _bit_count;
+    bool _ok;
+};
+
+typedef GzipCompressorT<> GzipCompressor;
+
+#endif // GZIP_COMPRESSOR_H
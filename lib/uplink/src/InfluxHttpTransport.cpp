@@ -0,0 +1,200 @@
+#include "InfluxHttpTransport.h"
+
+static String urlEncode(const char *text)
+{
+    static const char HEX_DIGITS[] = "0123456789ABCDEF";
+    String encoded;
+    for (; *text; text++)
+    {
+        char c = *text;
+        if (isalnum((unsigned char)c) || c == '-' || c == '_' || c == '.' || c == '~')
+        {
+            encoded += c;
+        }
+        else
+        {
+            encoded += '%';
+            encoded += HEX_DIGITS[(uint8_t)c >> 4];
+            encoded += HEX_DIGITS[(uint8_t)c & 0x0F];
+        }
+    }
+    return encoded;
+}
+
+InfluxHttpTransport::InfluxHttpTransport(const char *url, const char *org, const char *bucket, const char *token,
+                                         const char *caCert)
+    : _port(80), _secure(false), _keepAlive(true), _caCert(caCert), _gzipBuffer(nullptr), _gzipSize(0),
+      _lastStatusCode(0), _stats()
+{
+    _writeUrl = url;
+    if (_writeUrl.endsWith("/"))
+    {
+        _writeUrl.remove(_writeUrl.length() - 1);
+    }
+
+    // Host and port, connected to directly so handshakes can be counted
+    _secure = _writeUrl.startsWith("https:");
+    _port = _secure ? 443 : 80;
+    int hostStart = _writeUrl.indexOf("://") + 3;
+    int hostEnd = _writeUrl.indexOf('/', hostStart);
+    _host = hostEnd < 0 ? _writeUrl.substring(hostStart) : _writeUrl.substring(hostStart, hostEnd);
+    int colon = _host.indexOf(':');
+    if (colon >= 0)
+    {
+        _port = (uint16_t)_host.substring(colon + 1).toInt();
+        _host.remove(colon);
+    }
+
+    _writeUrl += "/api/v2/write?org=" + urlEncode(org) + "&bucket=" + urlEncode(bucket) + "&precision=s";
+    _authorization = String("Token ") + token;
+
+    if (_caCert)
+    {
+        _tls.setCACert(_caCert);
+    }
+    else
+    {
+        _tls.setInsecure();
+    }
+    _http.setReuse(true);
+    _http.setConnectTimeout(HTTP_TIMEOUT_MS);
+    _http.setTimeout(HTTP_TIMEOUT_MS);
+}
+
+void InfluxHttpTransport::setCompression(uint8_t *buffer, size_t size)
+{
+    _gzipBuffer = buffer;
+    _gzipSize = buffer ? size : 0;
+}
+
+void InfluxHttpTransport::setKeepAlive(bool enabled)
+{
+    _keepAlive = enabled;
+    _http.setReuse(enabled);
+}
+
+// Opens a connection unless the previous one is still open; reused tells
+// which of the two happened
+bool InfluxHttpTransport::connect(bool &reused)
+{
+    WiFiClient &connection = _secure ? _tls : _plain;
+    reused = connection.connected();
+    if (reused)
+    {
+        _stats.reused++;
+        return true;
+    }
+    connection.stop();
+    unsigned long startedMs = ::millis();
+    bool ok = _secure ? _tls.connect(_host.c_str(), _port, HTTP_TIMEOUT_MS)
+                      : _plain.connect(_host.c_str(), _port, HTTP_TIMEOUT_MS);
+    _stats.handshake_ms += ::millis() - startedMs;
+    _stats.handshakes++;
+    if (!ok)
+    {
+        _stats.connect_failures++;
+    }
+    return ok;
+}
+
+void InfluxHttpTransport::recordRequest(uint32_t elapsedMs)
+{
+    _stats.last_request_ms = elapsedMs;
+    if (elapsedMs > _stats.max_request_ms)
+    {
+        _stats.max_request_ms = elapsedMs;
+    }
+}
+
+UplinkWriteResult InfluxHttpTransport::write(const char *body, size_t len)
+{
+    const uint8_t *payload = (const uint8_t *)body;
+    size_t payloadLen = len;
+    bool compressed = false;
+    if (_gzipBuffer && len >= GZIP_MIN_BYTES)
+    {
+        uint32_t startedUs = micros();
+        size_t gzipLen = _gzip.compress(payload, len, _gzipBuffer, _gzipSize);
+        _stats.compress_us += micros() - startedUs;
+        if (gzipLen > 0 && gzipLen < len)
+        {
+            payload = _gzipBuffer;
+            payloadLen = gzipLen;
+            compressed = true;
+        }
+    }
+
+    unsigned long startedMs = ::millis();
+    WiFiClient &connection = _secure ? _tls : _plain;
+    int code = HTTPC_ERROR_CONNECTION_REFUSED;
+    for (uint8_t attempt = 0; attempt < 2; attempt++)
+    {
+        bool reused = false;
+        if (!connect(reused))
+        {
+            recordRequest(::millis() - startedMs);
+            _lastStatusCode = HTTPC_ERROR_CONNECTION_REFUSED;
+            _lastError = String("connection to ") + _host + " failed";
+            return UPLINK_WRITE_RETRY;
+        }
+
+        _http.begin(connection, _writeUrl);
+        _http.addHeader("Authorization", _authorization);
+        _http.addHeader("Content-Type", "text/plain; charset=utf-8");
+        if (compressed)
+        {
+            _http.addHeader("Content-Encoding", "gzip");
+        }
+        unsigned long sendStartedMs = ::millis();
+        code = _http.POST(const_cast<uint8_t *>(payload), payloadLen);
+        _stats.send_ms += ::millis() - sendStartedMs;
+        _stats.bodies++;
+        if (code < 0 && reused)
+        {
+            // The server closed the idle connection; resend on a new one
+            _http.end();
+            connection.stop();
+            continue;
+        }
+        break;
+    }
+    if (!compressed)
+    {
+        _stats.bodies_uncompressed++;
+    }
+    _stats.bytes_in += len;
+    _stats.bytes_out += payloadLen;
+
+    _lastStatusCode = code;
+    bool ok = code == HTTP_CODE_NO_CONTENT || code == HTTP_CODE_OK;
+    if (ok)
+    {
+        _lastError = "";
+    }
+    else
+    {
+        _lastError = code < 0 ? HTTPClient::errorToString(code) : String(code) + " " + _http.getString();
+    }
+    _http.end();
+    // A connection in an unknown state is not reused
+    if (code < 0 || !_keepAlive)
+    {
+        connection.stop();
+    }
+    recordRequest(::millis() - startedMs);
+    return classify(code);
+}
+
+float InfluxHttpTransport::compressionRatio() const
+{
+    return _stats.bytes_out ? (float)_stats.bytes_in / _stats.bytes_out : 1.0f;
+}
+
+uint32_t InfluxHttpTransport::estimatedAirtimeSavedMs() const
+{
+    if (_stats.bytes_out == 0)
+    {
+        return 0;
+    }
+    return (uint32_t)((_stats.bytes_in - _stats.bytes_out) * _stats.send_ms / _stats.bytes_out);
+}
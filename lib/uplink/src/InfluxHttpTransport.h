@@ -0,0 +1,92 @@
+#ifndef INFLUX_HTTP_TRANSPORT_H
+#define INFLUX_HTTP_TRANSPORT_H
+
+#include <Arduino.h>
+#include <HTTPClient.h>
+#include <WiFiClient.h>
+#include <WiFiClientSecure.h>
+#include "BatchUplink.h"
+#include "GzipCompressor.h"
+
+struct UplinkTransportStats
+{
+    uint32_t bodies;              // Write requests sent, including resends
+    uint32_t bodies_uncompressed; // Sent as is: compression off, too small or no gain
+    uint64_t bytes_in;            // Line protocol before compression
+    uint64_t bytes_out;           // Request bodies as sent
+    uint64_t compress_us;         // CPU time spent compressing
+    uint64_t send_ms;             // Time spent in the HTTP requests
+    uint32_t handshakes;          // New (TLS) connections opened
+    uint32_t reused;              // Requests sent on an already open connection
+    uint32_t connect_failures;
+    uint64_t handshake_ms;        // Time spent connecting, including TLS
+    uint32_t last_request_ms;     // Last write, including any handshake
+    uint32_t max_request_ms;
+};
+
+// BatchUplink transport that posts line protocol to the InfluxDB v2 write
+// API (/api/v2/write, precision s) over HTTP(S). With a compression buffer
+// set, bodies are gzip-compressed and sent with Content-Encoding: gzip;
+// bodies that would not fit the buffer or not shrink go out uncompressed.
+//
+// The connection is kept open between requests (HTTP keep-alive), so the TLS
+// handshake is only repeated after the server or a network error closed it.
+// An open TLS connection holds about 40 KB of heap; setKeepAlive(false)
+// closes it after every request instead.
+class InfluxHttpTransport
+{
+public:
+    // url is the server base URL, e.g. https://influx.example.com. caCert
+    // (PEM) is used for https; without it the server is not verified.
+    InfluxHttpTransport(const char *url, const char *org, const char *bucket, const char *token,
+                        const char *caCert = nullptr);
+
+    // Enables gzip bodies compressed into buffer; nullptr turns it off
+    void setCompression(uint8_t *buffer, size_t size);
+
+    void setKeepAlive(bool enabled);
+
+    UplinkWriteResult write(const char *body, size_t len);
+
+    unsigned long millis() { return ::millis(); }
+
+    const String &lastError() const { return _lastError; }
+    int lastStatusCode() const { return _lastStatusCode; }
+    const UplinkTransportStats &stats() const { return _stats; }
+
+    // Uncompressed / sent bytes; 1 without compression
+    float compressionRatio() const;
+    // Request time saved by sending fewer bytes, at the average rate
+    // observed so far (an estimate, since request time also includes server
+    // latency)
+    uint32_t estimatedAirtimeSavedMs() const;
+
+    // See classifyInfluxStatus()
+    static UplinkWriteResult classify(int statusCode) { return classifyInfluxStatus(statusCode); }
+
+private:
+    static constexpr uint32_t HTTP_TIMEOUT_MS = 10000;
+    static constexpr size_t GZIP_MIN_BYTES = 256; // Smaller bodies gain little
+
+    bool connect(bool &reused);
+    void recordRequest(uint32_t elapsedMs);
+
+    String _writeUrl;
+    String _host;
+    uint16_t _port;
+    bool _secure;
+    bool _keepAlive;
+    WiFiClientSecure _tls;
+    WiFiClient _plain;
+    HTTPClient _http;
+    String _authorization;
+    const char *_caCert;
+    uint8_t *_gzipBuffer;
+    size_t _gzipSize;
+    GzipCompressor _gzip;
+    String _lastError;
+    int _lastStatusCode;
+    UplinkTransportStats _stats;
+};
+
+#endif // INFLUX_HTTP_TRANSPORT_H
@@ -0,0 +1,223 @@
+#ifndef LINE_PROTOCOL_WRITER_H
+#define LINE_PROTOCOL_WRITER_H
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Writes InfluxDB line protocol straight into a caller-provided buffer,
+// without heap allocations:
+//
+//   LineProtocolWriter line(buf, sizeof(buf));
+//   line.measurement("full");
+//   line.tag("device", "ESP32");
+//   line.field("opc_pm1", 3.5f);   // opc_pm1=3.50
+//   line.field("scd41_co2", 812);  // scd41_co2=812i
+//   line.timestamp(1760000000);
+//
+// Output matches the InfluxDB Arduino client's Point: floats with two
+// decimals, integers with an i suffix, booleans as true/false. NaN and
+// infinite floats are skipped, because InfluxDB rejects them. If the buffer
+// runs out, ok() turns false and the (truncated) line must not be sent.
+// Field and measurement names are written as given; tag values are escaped.
+class LineProtocolWriter
+{
+public:
+    LineProtocolWriter(char *buffer, size_t size) : _buffer(buffer), _size(size), _pos(0), _fields(0), _ok(size > 0)
+    {
+        if (_ok)
+            _buffer[0] = '\0';
+    }
+
+    // Starts a new line, e.g. after a previous line in the same buffer. name
+    // may also be a pre-built "measurement,tag=value" prefix.
+    void measurement(const char *name)
+    {
+        if (_pos > 0)
+            put('\n');
+        _fields = 0;
+        append(name);
+    }
+
+    void tag(const char *key, const char *value)
+    {
+        put(',');
+        append(key);
+        put('=');
+        appendEscaped(value);
+    }
+
+    void field(const char *key, float value, uint8_t decimals = 2)
+    {
+        if (isnan(value) || isinf(value))
+            return;
+        fieldKey(key);
+        appendFloat(value, decimals);
+    }
+
+    void field(const char *key, long long value)
+    {
+        fieldKey(key);
+        if (value < 0)
+        {
+            put('-');
+            appendUInt(0ull - (unsigned long long)value);
+        }
+        else
+        {
+            appendUInt((unsigned long long)value);
+        }
+        put('i');
+    }
+
+    void field(const char *key, unsigned long long value)
+    {
+        fieldKey(key);
+        appendUInt(value);
+        put('i');
+    }
+
+    // One overload per integer type, so every width resolves unambiguously
+    void field(const char *key, int value) { field(key, (long long)value); }
+    void field(const char *key, long value) { field(key, (long long)value); }
+    void field(const char *key, short value) { field(key, (long long)value); }
+    void field(const char *key, unsigned int value) { field(key, (unsigned long long)value); }
+    void field(const char *key, unsigned long value) { field(key, (unsigned long long)value); }
+    void field(const char *key, unsigned short value) { field(key, (unsigned long long)value); }
+    void field(const char *key, unsigned char value) { field(key, (unsigned long long)value); }
+
+    void field(const char *key, bool value)
+    {
+        fieldKey(key);
+        append(value ? "true" : "false");
+    }
+
+    void timestamp(uint64_t value)
+    {
+        put(' ');
+        appendUInt(value);
+    }
+
+    bool ok() const { return _ok; }
+    uint16_t fieldCount() const { return _fields; } // Of the current line
+    size_t length() const { return _pos; }
+    const char *c_str() const { return _buffer; }
+
+    // Escapes a tag value (commas, spaces, equal signs) into out; used to
+    // build a constant prefix once. Returns false if it did not fit.
+    static bool escapeTag(const char *value, char *out, size_t size)
+    {
+        LineProtocolWriter writer(out, size);
+        writer.appendEscaped(value);
+        return writer.ok();
+    }
+
+private:
+    void put(char c)
+    {
+        if (_pos + 1 < _size)
+        {
+            _buffer[_pos++] = c;
+            _buffer[_pos] = '\0';
+        }
+        else
+        {
+            _ok = false;
+        }
+    }
+
+    void append(const char *text)
+    {
+        size_t len = strlen(text);
+        if (_pos + len < _size)
+        {
+            memcpy(_buffer + _pos, text, len + 1);
+            _pos += len;
+        }
+        else
+        {
+            _ok = false;
+        }
+    }
+
+    void appendEscaped(const char *text)
+    {
+        for (; *text; text++)
+        {
+            if (*text == ',' || *text == ' ' || *text == '=')
+                put('\\');
+            put(*text);
+        }
+    }
+
+    void fieldKey(const char *key)
+    {
+        put(_fields++ == 0 ? ' ' : ',');
+        append(key);
+        put('=');
+    }
+
+    void appendUInt(unsigned long long value)
+    {
+        char digits[20];
+        int n = 0;
+        do
+        {
+            digits[n++] = (char)('0' + value % 10);
+            value /= 10;
+        } while (value);
+        while (n)
+            put(digits[--n]);
+    }
+
+    // Fixed-point formatting without floating-point math: the float is split
+    // into its 24-bit mantissa and binary exponent, the mantissa is scaled by
+    // 10^decimals and shifted into place with a single round-half-up, then
+    // the integer and fractional digits are printed. Values whose scaled
+    // magnitude exceeds CLAMPED are printed as CLAMPED / 10^decimals.
+    void appendFloat(float value, uint8_t decimals)
+    {
+        static const uint32_t POW10[] = {1, 10, 100, 1000, 10000, 100000, 1000000};
+        static const unsigned long long CLAMPED = 18000000000000000000ull; // Divisible by every POW10
+        if (decimals > 6)
+            decimals = 6;
+
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        int exponent = (int)((bits >> 23) & 0xFF);
+        unsigned long long mantissa = bits & 0x7FFFFF;
+        if (exponent > 0)
+            mantissa |= 0x800000; // Implicit leading one of normal numbers
+        else
+            exponent = 1; // Subnormal
+        int shift = exponent - 150; // |value| = mantissa * 2^shift
+
+        unsigned long long scaled = mantissa * POW10[decimals]; // Below 2^44
+        unsigned long long fixed;
+        if (shift >= 0)
+            fixed = shift >= 64 || scaled > (CLAMPED >> shift) ? CLAMPED : scaled << shift;
+        else if (shift > -64)
+            fixed = (scaled + (1ull << (-shift - 1))) >> -shift;
+        else
+            fixed = 0;
+
+        if ((bits >> 31) && fixed > 0)
+            put('-');
+        appendUInt(fixed / POW10[decimals]);
+        if (decimals == 0)
+            return;
+        put('.');
+        uint32_t fraction = (uint32_t)(fixed % POW10[decimals]);
+        for (uint32_t div = POW10[decimals] / 10; div > 0; div /= 10)
+            put((char)('0' + (fraction / div) % 10));
+    }
+
+    char *_buffer;
+    size_t _size;
+    size_t _pos;
+    uint16_t _fields;
+    bool _ok;
+};
+
+#endif // LINE_PROTOCOL_WRITER_H
@@ -0,0 +1,357 @@
+#pragma once
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef AQI_BUCKET_S
+#define AQI_BUCKET_S 300 // Resolution of the sliding 1 h / 8 h / 24 h windows
+#endif
+
+// One segment of a piecewise-linear index: concentrations c_low..c_high map
+// to index values i_low..i_high
+struct AqiBreakpoint
+{
+    float c_low, c_high, i_low, i_high;
+};
+
+// Index of a concentration; above the last segment its slope is continued.
+// NAN for a NAN concentration.
+inline float interpolateIndex(float concentration, const AqiBreakpoint *table, int rows)
+{
+    if (isnan(concentration))
+        return NAN;
+    if (concentration < 0.0f)
+        concentration = 0.0f;
+    const AqiBreakpoint *row = &table[rows - 1];
+    for (int i = 0; i < rows; i++)
+    {
+        if (concentration <= table[i].c_high)
+        {
+            row = &table[i];
+            break;
+        }
+    }
+    return row->i_low + (row->i_high - row->i_low) / (row->c_high - row->c_low) * (concentration - row->c_low);
+}
+
+// European Common Air Quality Index (CAQI, CiteAIR) from hourly means of
+// PM2.5 and PM10 in ug/m3: the larger sub-index, 0-100 and above
+inline float calculateCaqiHourly(float pm2_5, float pm10)
+{
+    static const AqiBreakpoint PM2_5[] = {{0, 15, 0, 25}, {15, 30, 25, 50}, {30, 55, 50, 75}, {55, 110, 75, 100}};
+    static const AqiBreakpoint PM10[] = {{0, 25, 0, 25}, {25, 50, 25, 50}, {50, 90, 50, 75}, {90, 180, 75, 100}};
+    return fmaxf(interpolateIndex(pm2_5, PM2_5, 4), interpolateIndex(pm10, PM10, 4)); // fmaxf skips a NAN
+}
+
+// CAQI from 24-hour means
+inline float calculateCaqiDaily(float pm2_5, float pm10)
+{
+    static const AqiBreakpoint PM2_5[] = {{0, 10, 0, 25}, {10, 20, 25, 50}, {20, 30, 50, 75}, {30, 60, 75, 100}};
+    static const AqiBreakpoint PM10[] = {{0, 15, 0, 25}, {15, 30, 25, 50}, {30, 50, 50, 75}, {50, 100, 75, 100}};
+    return fmaxf(interpolateIndex(pm2_5, PM2_5, 4), interpolateIndex(pm10, PM10, 4));
+}
+
+// US EPA NowCast of hourly means, most recent first (hourly[0]); NAN marks a
+// missing hour. Needs two of the three most recent hours, else NAN.
+inline float calculateNowCast(const float *hourly, int hours)
+{
+    int recent = 0;
+    float lowest = INFINITY, highest = -INFINITY;
+    for (int i = 0; i < hours; i++)
+    {
+        if (isnan(hourly[i]))
+            continue;
+        if (i < 3)
+            recent++;
+        lowest = fminf(lowest, hourly[i]);
+        highest = fmaxf(highest, hourly[i]);
+    }
+    if (recent < 2)
+        return NAN;
+    float weight = highest > 0.0f ? lowest / highest : 1.0f;
+    if (weight < 0.5f)
+        weight = 0.5f;
+    float sum = 0.0f, weights = 0.0f, factor = 1.0f;
+    for (int i = 0; i < hours; i++, factor *= weight)
+    {
+        if (isnan(hourly[i]))
+            continue;
+        sum += factor * hourly[i];
+        weights += factor;
+    }
+    return sum / weights;
+}
+
+// US AQI (2024 PM2.5 breakpoints) from the NowCasts of PM2.5 and PM10: the
+// larger sub-index, rounded. Concentrations are truncated to 0.1 and 1 ug/m3
+// first, as the EPA specifies.
+inline float calculateUsAqi(float nowcast_pm2_5, float nowcast_pm10)
+{
+    static const AqiBreakpoint PM2_5[] = {{0.0f, 9.0f, 0, 50},       {9.1f, 35.4f, 51, 100},
+                                          {35.5f, 55.4f, 101, 150},  {55.5f, 125.4f, 151, 200},
+                                          {125.5f, 225.4f, 201, 300}, {225.5f, 325.4f, 301, 500}};
+    static const AqiBreakpoint PM10[] = {{0, 54, 0, 50},      {55, 154, 51, 100},  {155, 254, 101, 150},
+                                         {255, 354, 151, 200}, {355, 424, 201, 300}, {425, 604, 301, 500}};
+    float pm2_5 = interpolateIndex(floorf(nowcast_pm2_5 * 10.0f + 1e-3f) / 10.0f, PM2_5, 6);
+    float pm10 = interpolateIndex(floorf(nowcast_pm10), PM10, 6);
+    float aqi = fmaxf(pm2_5, pm10);
+    return isnan(aqi) ? NAN : roundf(aqi);
+}
+
+enum CaqiLevel
+{
+    CAQI_VERY_LOW = 0,
+    CAQI_LOW,
+    CAQI_MEDIUM,
+    CAQI_HIGH,
+    CAQI_VERY_HIGH
+};
+
+inline uint8_t classifyCaqi(float caqi)
+{
+    if (caqi < 25.0f)
+        return CAQI_VERY_LOW;
+    else if (caqi < 50.0f)
+        return CAQI_LOW;
+    else if (caqi < 75.0f)
+        return CAQI_MEDIUM;
+    else if (caqi <= 100.0f)
+        return CAQI_HIGH;
+    else
+        return CAQI_VERY_HIGH;
+}
+
+inline const char *caqiLevelName(uint8_t level)
+{
+    switch (level)
+    {
+    case CAQI_VERY_LOW:
+        return "very_low";
+    case CAQI_LOW:
+        return "low";
+    case CAQI_MEDIUM:
+        return "medium";
+    case CAQI_HIGH:
+        return "high";
+    default:
+        return "very_high";
+    }
+}
+
+// Running means (ug/m3) and indices; NAN while a window has too little data
+struct AirQualityIndices
+{
+    float pm2_5_1h, pm2_5_8h, pm2_5_24h;
+    float pm10_1h, pm10_8h, pm10_24h;
+    float caqi_hourly; // From the 1 h means
+    float caqi_daily;  // From the 24 h means
+    float nowcast_pm2_5, nowcast_pm10;
+    float aqi_us; // From the NowCasts
+};
+
+// Keeps sliding 1 h, 8 h and 24 h means of PM2.5 and PM10 and the indices
+// derived from them. Samples are summed into a ring of AQI_BUCKET_S buckets
+// spanning 24 h; each window keeps a running sum that a bucket is added to
+// when it starts and subtracted from when it leaves the window, so a sample
+// costs the same whatever the sample rate, and memory is fixed (about
+// 3.5 KB with 5-minute buckets). Clock hours are averaged separately for the
+// NowCast, which is recomputed once per hour.
+//
+// A window's mean is only reported once at least 75 % of its buckets hold
+// data. Samples older than the newest bucket are ignored.
+class AirQualityTracker
+{
+public:
+    static const uint32_t BUCKET_S = AQI_BUCKET_S;
+    static const int BUCKETS_PER_HOUR = 3600 / AQI_BUCKET_S;
+    static const int BUCKET_COUNT = 24 * BUCKETS_PER_HOUR;
+    static const int NOWCAST_HOURS = 12;
+    static_assert(3600 % AQI_BUCKET_S == 0, "AQI_BUCKET_S must divide an hour");
+
+    AirQualityTracker() { reset(); }
+
+    void reset()
+    {
+        memset(_buckets, 0, sizeof(_buckets));
+        static const int WINDOW_HOURS[WINDOW_COUNT] = {1, 8, 24};
+        for (int w = 0; w < WINDOW_COUNT; w++)
+        {
+            _windows[w] = Window();
+            _windows[w].buckets = WINDOW_HOURS[w] * BUCKETS_PER_HOUR;
+        }
+        for (int p = 0; p < POLLUTANTS; p++)
+        {
+            for (int h = 0; h < NOWCAST_HOURS; h++)
+                _hourly[p][h] = NAN;
+            _hour_sum[p] = 0.0;
+            _hour_count[p] = 0;
+            _nowcast[p] = NAN;
+        }
+        _bucket = 0;
+        _hour = 0;
+        update();
+    }
+
+    // Adds a sample (NAN values are skipped); false if it is out of order
+    bool add(time_t timestamp, float pm2_5, float pm10)
+    {
+        uint32_t bucket = (uint32_t)(timestamp / BUCKET_S);
+        if (bucket < _bucket)
+            return false;
+        advanceTo(bucket);
+        uint32_t hour = (uint32_t)(timestamp / 3600);
+        if (hour != _hour)
+            closeHours(hour);
+
+        Bucket &current = _buckets[bucket % BUCKET_COUNT];
+        bool wasEmpty = current.count[PM2_5] == 0 && current.count[PM10] == 0;
+        const float values[POLLUTANTS] = {pm2_5, pm10};
+        for (int p = 0; p < POLLUTANTS; p++)
+        {
+            if (isnan(values[p]))
+                continue;
+            current.sum[p] += values[p];
+            current.count[p]++;
+            _hour_sum[p] += values[p];
+            _hour_count[p]++;
+            for (int w = 0; w < WINDOW_COUNT; w++)
+            {
+                _windows[w].sum[p] += values[p];
+                _windows[w].count[p]++;
+            }
+        }
+        if (wasEmpty && (current.count[PM2_5] > 0 || current.count[PM10] > 0))
+        {
+            for (int w = 0; w < WINDOW_COUNT; w++)
+                _windows[w].filled++;
+        }
+        update();
+        return true;
+    }
+
+    const AirQualityIndices &indices() const { return _indices; }
+
+private:
+    enum
+    {
+        PM2_5 = 0,
+        PM10,
+        POLLUTANTS
+    };
+    enum
+    {
+        WINDOW_1H = 0,
+        WINDOW_8H,
+        WINDOW_24H,
+        WINDOW_COUNT
+    };
+
+    struct Bucket
+    {
+        float sum[POLLUTANTS];
+        uint16_t count[POLLUTANTS];
+    };
+
+    struct Window
+    {
+        int buckets;
+        int filled; // Buckets in the window that hold data
+        double sum[POLLUTANTS];
+        uint32_t count[POLLUTANTS];
+    };
+
+    // Starts the buckets up to and including bucket; each window drops the
+    // bucket that falls out of it
+    void advanceTo(uint32_t bucket)
+    {
+        if (bucket - _bucket >= (uint32_t)BUCKET_COUNT)
+        {
+            memset(_buckets, 0, sizeof(_buckets));
+            for (int w = 0; w < WINDOW_COUNT; w++)
+            {
+                int buckets = _windows[w].buckets;
+                _windows[w] = Window();
+                _windows[w].buckets = buckets;
+            }
+            _bucket = bucket;
+            return;
+        }
+        while (_bucket < bucket)
+        {
+            _bucket++;
+            for (int w = 0; w < WINDOW_COUNT; w++)
+            {
+                Window &window = _windows[w];
+                const Bucket &leaving = _buckets[(_bucket - window.buckets) % BUCKET_COUNT];
+                if (leaving.count[PM2_5] == 0 && leaving.count[PM10] == 0)
+                    continue;
+                window.filled--;
+                for (int p = 0; p < POLLUTANTS; p++)
+                {
+                    window.sum[p] -= leaving.sum[p];
+                    window.count[p] -= leaving.count[p];
+                    if (window.count[p] == 0)
+                        window.sum[p] = 0.0; // No rounding residue
+                }
+            }
+            memset(&_buckets[_bucket % BUCKET_COUNT], 0, sizeof(Bucket));
+        }
+    }
+
+    // Moves the finished hour (and a NAN per hour without samples) into the
+    // NowCast history
+    void closeHours(uint32_t hour)
+    {
+        uint32_t elapsed = hour - _hour;
+        bool stale = elapsed >= (uint32_t)NOWCAST_HOURS; // The finished hour drops out as well
+        if (stale)
+            elapsed = NOWCAST_HOURS;
+        for (int p = 0; p < POLLUTANTS; p++)
+        {
+            for (uint32_t i = 0; i < elapsed; i++)
+            {
+                bool finished = i == 0 && !stale && _hour_count[p] > 0;
+                memmove(&_hourly[p][1], &_hourly[p][0], (NOWCAST_HOURS - 1) * sizeof(float));
+                _hourly[p][0] = finished ? (float)(_hour_sum[p] / _hour_count[p]) : NAN;
+            }
+            _hour_sum[p] = 0.0;
+            _hour_count[p] = 0;
+            _nowcast[p] = calculateNowCast(_hourly[p], NOWCAST_HOURS);
+        }
+        _hour = hour;
+    }
+
+    float mean(int w, int p) const
+    {
+        const Window &window = _windows[w];
+        if (window.count[p] == 0 || window.filled * 4 < window.buckets * 3)
+            return NAN;
+        return (float)(window.sum[p] / window.count[p]);
+    }
+
+    void update()
+    {
+        _indices.pm2_5_1h = mean(WINDOW_1H, PM2_5);
+        _indices.pm2_5_8h = mean(WINDOW_8H, PM2_5);
+        _indices.pm2_5_24h = mean(WINDOW_24H, PM2_5);
+        _indices.pm10_1h = mean(WINDOW_1H, PM10);
+        _indices.pm10_8h = mean(WINDOW_8H, PM10);
+        _indices.pm10_24h = mean(WINDOW_24H, PM10);
+        _indices.caqi_hourly = calculateCaqiHourly(_indices.pm2_5_1h, _indices.pm10_1h);
+        _indices.caqi_daily = calculateCaqiDaily(_indices.pm2_5_24h, _indices.pm10_24h);
+        _indices.nowcast_pm2_5 = _nowcast[PM2_5];
+        _indices.nowcast_pm10 = _nowcast[PM10];
+        _indices.aqi_us = calculateUsAqi(_nowcast[PM2_5], _nowcast[PM10]);
+    }
+
+    Bucket _buckets[BUCKET_COUNT];
+    Window _windows[WINDOW_COUNT];
+    uint32_t _bucket; // Index of the newest bucket since the epoch
+    uint32_t _hour;   // Current clock hour since the epoch
+    double _hour_sum[POLLUTANTS];
+    uint32_t _hour_count[POLLUTANTS];
+    float _hourly[POLLUTANTS][NOWCAST_HOURS]; // Finished hours, most recent first
+    float _nowcast[POLLUTANTS];
+    AirQualityIndices _indices;
+};
@@ -1,5 +1,6 @@
 #pragma once
 #include "OpcN3.h"
+#include "OpcN3Accumulator.h"
 
 inline uint32_t calculatePollenCount(const OpcN3Data &data)
 {
@@ -11,6 +12,20 @@ inline uint32_t calculatePollenCount(const OpcN3Data &data)
     return count;
 }
 
+// Pollen-sized particles (bins 13-24) per m^3 of sampled air, so windows of
+// any length and flow rate compare; NAN if no volume was sampled
+inline float calculatePollenConcentration(const OpcN3Accumulator &histograms)
+{
+    return histograms.concentration(12, 23) * 1e6f;
+}
+
+inline float calculatePollenConcentration(const OpcN3Data &data)
+{
+    OpcN3Accumulator histogram;
+    histogram.add(data);
+    return calculatePollenConcentration(histogram);
+}
+
 enum PollenLevel
 {
     POLLEN_VERY_LOW = 0,
@@ -0,0 +1,207 @@
+#pragma once
+#include <stdio.h>
+#include "OpcN3Accumulator.h"
+#include "SampleRecord.h"
+#include "SampleSerializer.h"
+#include "WindowStats.h"
+
+#ifndef AGGREGATE_MAX_SAMPLES
+#define AGGREGATE_MAX_SAMPLES 64 // Per window for exact percentiles; p95 is estimated beyond
+#endif
+#ifndef AGGREGATE_FLUSH_GRACE_S
+#define AGGREGATE_FLUSH_GRACE_S 10 // Wait for samples still in the pipeline before flush() closes a window
+#endif
+
+// Condenses the samples of fixed, clock-aligned windows (e.g. 00:00-00:05)
+// into one line with min/max/mean/stddev/p95 per value, the summed bin
+// counts and the per-bin number concentrations over the window. A window is
+// emitted when the first sample of a later window arrives, or by flush()
+// once its end has passed, with the window's end as timestamp; PM-only
+// samples contribute to the PM values only. With models, the size
+// distribution of the window and its PM recomputed from the summed
+// histogram (corrected at the mean sensor humidity) are added as well, if
+// all its histograms were read under the configuration of the models.
+// Samples whose spike check says to suppress them are left out of the
+// statistics; flagged samples are counted in "spikes".
+class SampleAggregator
+{
+public:
+    explicit SampleAggregator(uint32_t window_s, const SampleModels *models = nullptr)
+        : _window_s(window_s ? window_s : 60), _models(models)
+    {
+        snprintf(_window_tag, sizeof(_window_tag), "%lus", (unsigned long)_window_s);
+        _flushed_start = -1;
+        reset(0);
+    }
+
+    uint32_t windowSeconds() const { return _window_s; }
+
+    // Adds a sample. If it belongs to a later window than the samples so far,
+    // the finished window is first written to line (after prefix, see
+    // buildLinePrefix()), with the air quality indices of state if given;
+    // returns that line's length, or 0 if no window was finished or the line
+    // did not fit.
+    size_t add(const SampleRecord &sample, const char *prefix, char *line, size_t size,
+               const SampleState *state = nullptr)
+    {
+        time_t start = sample.timestamp - sample.timestamp % _window_s;
+        if (start == _flushed_start)
+            return 0; // Late for a window flush() already wrote
+        size_t length = 0;
+        if (start != _start)
+        {
+            if (_samples > 0 || _spikes > 0)
+                length = serialize(prefix, line, size, state ? state->airQuality : nullptr);
+            reset(start);
+        }
+
+        const SpikeCheck *spike = state ? state->spike : nullptr;
+        if (spike)
+        {
+            _spikes_checked = true;
+            if (spike->flags)
+                _spikes++;
+            if (spike->suppress)
+                return length;
+        }
+        _samples++;
+        _values[PM1].add(sample.opc.pm_a);
+        _values[PM2_5].add(sample.opc.pm_b);
+        _values[PM10].add(sample.opc.pm_c);
+        if (sample.kind == SAMPLE_FULL)
+        {
+            _values[OPC_TEMPERATURE].add(sample.opc.temperature_c);
+            _values[OPC_HUMIDITY].add(sample.opc.humidity_rh);
+            _values[CO2].add(sample.co2);
+            _values[SCD_TEMPERATURE].add(sample.scd_temperature_c);
+            _values[SCD_HUMIDITY].add(sample.scd_humidity_rh);
+            if (_histograms.add(sample.opc))
+            {
+                if (_histograms.samples() > 1 && sample.opc.config_version != _config_version)
+                    _mixed_configs = true;
+                _config_version = sample.opc.config_version;
+            }
+            _full_samples++;
+        }
+        return length;
+    }
+
+    // Writes the current window if its end is more than
+    // AGGREGATE_FLUSH_GRACE_S before now (seconds, the clock of the sample
+    // timestamps), so the last window before a pause in the samples is not
+    // held back until the next one arrives. Returns the line length as add()
+    // does; samples of that window that still come in are dropped, so no
+    // window is written twice.
+    size_t flush(time_t now, const char *prefix, char *line, size_t size, const AirQualityIndices *airQuality = nullptr)
+    {
+        if ((_samples == 0 && _spikes == 0) || now < _start + (time_t)(_window_s + AGGREGATE_FLUSH_GRACE_S))
+            return 0;
+        size_t length = serialize(prefix, line, size, airQuality);
+        _flushed_start = _start;
+        reset(_start);
+        return length;
+    }
+
+private:
+    enum Value
+    {
+        PM1,
+        PM2_5,
+        PM10,
+        OPC_TEMPERATURE,
+        OPC_HUMIDITY,
+        CO2,
+        SCD_TEMPERATURE,
+        SCD_HUMIDITY,
+        VALUE_COUNT
+    };
+
+    void reset(time_t start)
+    {
+        _start = start;
+        _samples = 0;
+        _full_samples = 0;
+        _spikes = 0;
+        _spikes_checked = false;
+        _config_version = 0;
+        _mixed_configs = false;
+        for (int i = 0; i < VALUE_COUNT; i++)
+            _values[i].reset();
+        _histograms.reset();
+    }
+
+    size_t serialize(const char *prefix, char *line, size_t size, const AirQualityIndices *airQuality)
+    {
+        // Field names per value and statistic, so nothing is formatted per window
+        static const char *const FIELDS[VALUE_COUNT][5] = {
+            {"opc_pm1_min", "opc_pm1_max", "opc_pm1_mean", "opc_pm1_stddev", "opc_pm1_p95"},
+            {"opc_pm2_5_min", "opc_pm2_5_max", "opc_pm2_5_mean", "opc_pm2_5_stddev", "opc_pm2_5_p95"},
+            {"opc_pm10_min", "opc_pm10_max", "opc_pm10_mean", "opc_pm10_stddev", "opc_pm10_p95"},
+            {"opc_temperature_min", "opc_temperature_max", "opc_temperature_mean", "opc_temperature_stddev",
+             "opc_temperature_p95"},
+            {"opc_humidity_min", "opc_humidity_max", "opc_humidity_mean", "opc_humidity_stddev", "opc_humidity_p95"},
+            {"scd41_co2_min", "scd41_co2_max", "scd41_co2_mean", "scd41_co2_stddev", "scd41_co2_p95"},
+            {"scd41_temperature_min", "scd41_temperature_max", "scd41_temperature_mean", "scd41_temperature_stddev",
+             "scd41_temperature_p95"},
+            {"scd41_humidity_min", "scd41_humidity_max", "scd41_humidity_mean", "scd41_humidity_stddev",
+             "scd41_humidity_p95"}};
+
+        LineProtocolWriter writer(line, size);
+        writer.measurement(prefix);
+        writer.tag("window", _window_tag);
+        writer.field("samples", _samples);
+        writer.field("full_samples", _full_samples);
+        if (_spikes_checked)
+            writer.field("spikes", _spikes);
+        if (airQuality)
+            writeAirQuality(writer, *airQuality);
+        for (int v = 0; v < VALUE_COUNT; v++)
+        {
+            WindowStats<AGGREGATE_MAX_SAMPLES> &stats = _values[v];
+            if (stats.count() == 0)
+                continue;
+            writer.field(FIELDS[v][0], stats.min());
+            writer.field(FIELDS[v][1], stats.max());
+            writer.field(FIELDS[v][2], stats.mean());
+            writer.field(FIELDS[v][3], stats.stddev());
+            writer.field(FIELDS[v][4], stats.percentile(95.0f));
+        }
+        if (_histograms.samples() > 0)
+        {
+            float concentrations[OpcN3Accumulator::BIN_COUNT];
+            _histograms.concentrations(concentrations);
+            writer.field("opc_sampled_volume_ml", _histograms.sampledVolumeMl());
+            writer.field("opc_conc_total", _histograms.concentration(0, 23), 4);
+            for (int i = 0; i < OpcN3Accumulator::BIN_COUNT; i++)
+                writer.field(OPC_BIN_FIELDS[i], _histograms.count(i));
+            for (int i = 0; i < OpcN3Accumulator::BIN_COUNT; i++)
+                writer.field(OPC_CONC_FIELDS[i], concentrations[i], 4);
+            writer.field("calc_pollen_m3", calculatePollenConcentration(_histograms), 0);
+            OpcN3SizeDistribution distribution;
+            if (_models && _models->geometry && !_mixed_configs &&
+                _models->geometry->config_version == _config_version &&
+                computeSizeDistribution(*_models->geometry, concentrations, distribution))
+                writeSizeDistribution(writer, distribution);
+            OpcN3MassConcentration mass;
+            if (_models && _models->mass && !_mixed_configs && _models->mass->configVersion() == _config_version &&
+                _models->mass->compute(concentrations, _values[OPC_HUMIDITY].mean(), mass))
+                writeMassConcentration(writer, mass);
+        }
+        writer.timestamp((uint64_t)(_start + _window_s));
+        return writer.ok() ? writer.length() : 0;
+    }
+
+    uint32_t _window_s;
+    const SampleModels *_models;
+    char _window_tag[12];
+    time_t _start;
+    time_t _flushed_start; // Window last written by flush(), -1 for none
+    uint32_t _samples;
+    uint32_t _full_samples;
+    uint32_t _spikes;
+    bool _spikes_checked;
+    uint16_t _config_version; // Of the window's histograms
+    bool _mixed_configs;      // Histograms from more than one configuration
+    WindowStats<AGGREGATE_MAX_SAMPLES> _values[VALUE_COUNT];
+    OpcN3Accumulator _histograms;
+};
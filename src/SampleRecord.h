@@ -0,0 +1,116 @@
+#pragma once
+#include <time.h>
+#include "OpcN3.h"
+#include "OpcN3Codec.h"
+#include "OpenMeteoClient.h"
+
+enum SampleKind : uint8_t
+{
+    SAMPLE_FULL = 0, // Histogram read with SCD41 and weather data
+    SAMPLE_PM        // Fast PM-only read; only opc.pm_a/b/c are set
+};
+
+// One measurement handed from the acquisition task to the uplink task. It is
+// copied through the sample queue, so it holds values rather than pointers.
+struct SampleRecord
+{
+    SampleKind kind;
+    time_t timestamp;     // Time of the sensor read, in seconds
+    uint32_t acquired_ms; // millis() at the sensor read, for stage latencies
+    OpcN3Data opc;
+    uint16_t co2;
+    float scd_temperature_c;
+    float scd_humidity_rh;
+    OpenMeteoData weather; // Latest weather at the time of the read
+};
+
+#ifndef UPLINK_LINE_SIZE
+#if defined(STREAM_STATS_BINS) && STREAM_STATS_BINS
+#define UPLINK_LINE_SIZE 4096 // Per-bin streaming statistics make a full line about 3.7 KB
+#else
+#define UPLINK_LINE_SIZE 3072 // An aggregate line with concentrations is about 2.3 KB
+#endif
+#endif
+
+// Journal payload formats, given by the first byte. RAW is the SampleRecord
+// memory image; PACKED is the compact encoding of packSample(). Both are
+// accepted on replay, so journals survive a firmware update. LINE holds
+// serialized line protocol, for lines without a kept sample (aggregates).
+const uint8_t JOURNAL_RECORD_RAW = 1;
+const uint8_t JOURNAL_RECORD_PACKED = 2;
+const uint8_t JOURNAL_RECORD_LINE = 3;
+const size_t JOURNAL_RECORD_MAX_SIZE =
+    1 + (sizeof(SampleRecord) > UPLINK_LINE_SIZE ? sizeof(SampleRecord) : UPLINK_LINE_SIZE);
+
+// PACKED layout: format byte, kind, timestamp and SCD41 values as varints,
+// the OPC-N3 data as a self-contained OpcN3RecordEncoder keyframe, then the
+// weather block as raw bytes if it is valid. About 65 bytes without weather
+// and 155 with it, instead of ~225 for the raw record.
+inline size_t packSample(const SampleRecord &sample, uint8_t *out, size_t size)
+{
+    opcn3_codec::Writer writer(out, size);
+    writer.byte(JOURNAL_RECORD_PACKED);
+    writer.byte(sample.kind);
+    writer.varint((uint32_t)sample.timestamp);
+    writer.varint(sample.co2);
+    writer.svarint(opcn3_codec::toFixed(sample.scd_temperature_c));
+    writer.svarint(opcn3_codec::toFixed(sample.scd_humidity_rh));
+    writer.byte(sample.weather.valid ? 1 : 0);
+    if (!writer.ok())
+        return 0;
+
+    // Every journal record is a keyframe; older segments may be evicted
+    OpcN3RecordEncoder encoder(1);
+    size_t used = writer.length();
+    size_t opcLen = encoder.encode(sample.opc, out + used, size - used);
+    if (opcLen == 0)
+        return 0;
+    used += opcLen;
+
+    if (sample.weather.valid)
+    {
+        if (used + sizeof(sample.weather) > size)
+            return 0;
+        memcpy(out + used, &sample.weather, sizeof(sample.weather));
+        used += sizeof(sample.weather);
+    }
+    return used;
+}
+
+// Restores a journal payload in either format; false if it is malformed
+inline bool unpackSample(const uint8_t *in, size_t len, SampleRecord &sample)
+{
+    memset(&sample, 0, sizeof(sample));
+    if (len == 1 + sizeof(SampleRecord) && in[0] == JOURNAL_RECORD_RAW)
+    {
+        memcpy(&sample, in + 1, sizeof(sample));
+        return true;
+    }
+    if (len == 0 || in[0] != JOURNAL_RECORD_PACKED)
+        return false;
+
+    opcn3_codec::Reader reader(in + 1, len - 1);
+    sample.kind = (SampleKind)reader.byte();
+    sample.timestamp = (time_t)reader.varint();
+    sample.co2 = (uint16_t)reader.varint();
+    sample.scd_temperature_c = opcn3_codec::fromFixed(reader.svarint());
+    sample.scd_humidity_rh = opcn3_codec::fromFixed(reader.svarint());
+    bool hasWeather = reader.byte() != 0;
+    if (!reader.ok())
+        return false;
+
+    size_t used = 1 + reader.position();
+    OpcN3RecordDecoder decoder;
+    size_t opcLen = decoder.decode(in + used, len - used, sample.opc);
+    if (opcLen == 0)
+        return false;
+    used += opcLen;
+
+    if (hasWeather)
+    {
+        if (used + sizeof(sample.weather) != len)
+            return false;
+        memcpy(&sample.weather, in + used, sizeof(sample.weather));
+    }
+    return true;
+}
@@ -0,0 +1,203 @@
+#pragma once
+#include "AirQualityIndex.h"
+#include "DerivedMetrics.h"
+#include "LineProtocolWriter.h"
+#include "OpcN3Distribution.h"
+#include "OpcN3Mass.h"
+#include "SampleRecord.h"
+#include "SampleSpikeFilter.h"
+#include "SampleStreamStats.h"
+
+// Field names of the histogram bins, so no name is formatted per sample
+static const char *const OPC_BIN_FIELDS[24] = {
+    "opc_bin_00", "opc_bin_01", "opc_bin_02", "opc_bin_03", "opc_bin_04", "opc_bin_05",
+    "opc_bin_06", "opc_bin_07", "opc_bin_08", "opc_bin_09", "opc_bin_10", "opc_bin_11",
+    "opc_bin_12", "opc_bin_13", "opc_bin_14", "opc_bin_15", "opc_bin_16", "opc_bin_17",
+    "opc_bin_18", "opc_bin_19", "opc_bin_20", "opc_bin_21", "opc_bin_22", "opc_bin_23"};
+
+// Field names of the per-bin number concentrations (particles per cm^3)
+static const char *const OPC_CONC_FIELDS[24] = {
+    "opc_conc_00", "opc_conc_01", "opc_conc_02", "opc_conc_03", "opc_conc_04", "opc_conc_05",
+    "opc_conc_06", "opc_conc_07", "opc_conc_08", "opc_conc_09", "opc_conc_10", "opc_conc_11",
+    "opc_conc_12", "opc_conc_13", "opc_conc_14", "opc_conc_15", "opc_conc_16", "opc_conc_17",
+    "opc_conc_18", "opc_conc_19", "opc_conc_20", "opc_conc_21", "opc_conc_22", "opc_conc_23"};
+
+// Size distribution summary: total number (#/cm^3), surface (um^2/cm^3) and
+// volume (um^3/cm^3) concentrations, count median and geometric mean
+// diameters (um) and the geometric standard deviation
+inline void writeSizeDistribution(LineProtocolWriter &writer, const OpcN3SizeDistribution &distribution)
+{
+    writer.field("calc_number_cm3", distribution.number_cm3, 3);
+    writer.field("calc_surface_um2_cm3", distribution.surface_um2_cm3, 1);
+    writer.field("calc_volume_um3_cm3", distribution.volume_um3_cm3, 1);
+    writer.field("calc_cmd_um", distribution.cmd_um, 3);
+    writer.field("calc_gmd_um", distribution.gmd_um, 3);
+    writer.field("calc_gsd", distribution.gsd, 3);
+}
+
+// PM recomputed from the histogram (ug/m3), the same corrected for water
+// uptake at the sample humidity, and the growth factor used
+inline void writeMassConcentration(LineProtocolWriter &writer, const OpcN3MassConcentration &mass)
+{
+    writer.field("calc_pm1", mass.pm1);
+    writer.field("calc_pm2_5", mass.pm2_5);
+    writer.field("calc_pm10", mass.pm10);
+    writer.field("calc_pm1_dry", mass.pm1_dry);
+    writer.field("calc_pm2_5_dry", mass.pm2_5_dry);
+    writer.field("calc_pm10_dry", mass.pm10_dry);
+    writer.field("calc_growth_factor", mass.growth_factor, 3);
+}
+
+// Sliding-window PM means and air quality indices; values without enough
+// data are left out
+inline void writeAirQuality(LineProtocolWriter &writer, const AirQualityIndices &indices)
+{
+    writer.field("calc_pm2_5_1h", indices.pm2_5_1h);
+    writer.field("calc_pm2_5_8h", indices.pm2_5_8h);
+    writer.field("calc_pm2_5_24h", indices.pm2_5_24h);
+    writer.field("calc_pm10_1h", indices.pm10_1h);
+    writer.field("calc_pm10_8h", indices.pm10_8h);
+    writer.field("calc_pm10_24h", indices.pm10_24h);
+    writer.field("calc_caqi_hourly", indices.caqi_hourly, 1);
+    writer.field("calc_caqi_daily", indices.caqi_daily, 1);
+    if (!isnan(indices.caqi_hourly))
+        writer.field("calc_caqi_level", classifyCaqi(indices.caqi_hourly));
+    writer.field("calc_nowcast_pm2_5", indices.nowcast_pm2_5, 1);
+    writer.field("calc_nowcast_pm10", indices.nowcast_pm10, 0);
+    if (!isnan(indices.aqi_us))
+        writer.field("calc_aqi_us", (int)indices.aqi_us);
+}
+
+// Spike check of the sample: the flagged channels (SpikeChannel bits) and
+// the highest robust score
+inline void writeSpikeCheck(LineProtocolWriter &writer, const SpikeCheck &spike)
+{
+    writer.field("calc_spike", spike.flags);
+    writer.field("calc_spike_score", spike.score);
+}
+
+// State of the processing task written along with a sample; any pointer may
+// be null. It describes the time of processing, so replayed samples go
+// without.
+struct SampleState
+{
+    const AirQualityIndices *airQuality; // Every sample
+    const SampleStreamSnapshot *stats;   // Full samples
+    const SpikeCheck *spike;             // Every sample
+};
+
+// A sample and the processing state to write with it, handed from the
+// processing task to the uplink task. The uplink task serializes it straight
+// into its batch buffer, so the queue carries no line buffers: about 600
+// bytes per entry instead of a 3-4 KB line.
+struct UplinkRecord
+{
+    SampleRecord sample;
+    AirQualityIndices airQuality;
+    SpikeCheck spike;
+    SampleStreamSnapshot stats;
+    bool has_spike;
+    bool has_stats;
+
+    SampleState state() const { return {&airQuality, has_stats ? &stats : nullptr, has_spike ? &spike : nullptr}; }
+};
+
+// Optional models for the derived fields of full samples and windows; either
+// pointer may be null
+struct SampleModels
+{
+    const OpcN3BinGeometry *geometry; // Size distribution
+    const OpcN3MassEngine *mass;      // Recomputed and humidity-corrected PM
+};
+
+// Builds the constant "measurement,device=...,ssid=..." start of every line
+inline bool buildLinePrefix(const char *measurement, const char *device, const char *ssid, char *out, size_t size)
+{
+    LineProtocolWriter prefix(out, size);
+    prefix.measurement(measurement);
+    prefix.tag("device", device);
+    prefix.tag("ssid", ssid);
+    return prefix.ok();
+}
+
+// Writes one sample as a line of InfluxDB line protocol into line, starting
+// with the prefix from buildLinePrefix(). With models, full samples also get
+// the size distribution and recomputed PM fields. With a state, the fields
+// of its parts are added as well. Does not allocate and can be called
+// from several tasks at once. Returns the line length, or 0 if it does not
+// fit into size bytes.
+inline size_t serializeSample(const SampleRecord &sample, const char *prefix, char *line, size_t size,
+                              const SampleModels *models = nullptr,
+                              const SampleState *state = nullptr)
+{
+    LineProtocolWriter writer(line, size);
+    writer.measurement(prefix);
+
+    const OpcN3Data &opc = sample.opc;
+    writer.field("opc_pm1", opc.pm_a);
+    writer.field("opc_pm2_5", opc.pm_b);
+    writer.field("opc_pm10", opc.pm_c);
+    if (state && state->airQuality)
+        writeAirQuality(writer, *state->airQuality);
+    if (state && state->spike)
+        writeSpikeCheck(writer, *state->spike);
+    if (sample.kind == SAMPLE_PM)
+    {
+        writer.timestamp((uint64_t)sample.timestamp);
+        // A line without fields (all NaN) would be rejected by InfluxDB
+        return writer.ok() && writer.fieldCount() > 0 ? writer.length() : 0;
+    }
+
+    // Derived metrics
+    uint32_t pollenCount = calculatePollenCount(opc);
+    writer.field("opc_temperature", opc.temperature_c);
+    writer.field("opc_humidity", opc.humidity_rh);
+    writer.field("scd41_co2", sample.co2);
+    writer.field("scd41_temperature", sample.scd_temperature_c);
+    writer.field("scd41_humidity", sample.scd_humidity_rh);
+    writer.field("calc_pollen_count", pollenCount);
+    writer.field("calc_pollen_m3", calculatePollenConcentration(opc), 0);
+    writer.field("calc_pollen_level", classifyPollenLevel(pollenCount));
+    writer.field("calc_co2_quality", classifyCo2Quality(sample.co2));
+    OpcN3SizeDistribution distribution;
+    if (models && models->geometry && computeSizeDistribution(*models->geometry, opc, distribution))
+        writeSizeDistribution(writer, distribution);
+    OpcN3MassConcentration mass;
+    if (models && models->mass && models->mass->compute(opc, mass))
+        writeMassConcentration(writer, mass);
+    if (state && state->stats)
+        state->stats->write(writer);
+
+    const OpenMeteoData &weather = sample.weather;
+    if (weather.valid)
+    {
+        writer.field("weather_temperature", weather.temperature_c);
+        writer.field("weather_humidity", weather.humidity_rh);
+        writer.field("weather_apparent_temperature", weather.apparent_temperature_c);
+        writer.field("weather_is_day", weather.is_day);
+        writer.field("weather_rain", weather.rain_mm);
+        writer.field("weather_cloud_cover_pct", weather.cloud_cover_pct);
+        writer.field("weather_pressure_msl", weather.pressure_msl_hpa);
+        writer.field("weather_surface_pressure", weather.surface_pressure_hpa);
+        writer.field("weather_wind_speed_kmh", weather.wind_speed_kmh);
+        writer.field("weather_wind_dir_deg", weather.wind_direction_deg);
+        writer.field("weather_wind_gusts_kmh", weather.wind_gusts_kmh);
+        writer.field("air_ragweed_pollen", weather.ragweed_pollen_grains_m3);
+        writer.field("air_olive_pollen", weather.olive_pollen_grains_m3);
+        writer.field("air_mugwort_pollen", weather.mugwort_pollen_grains_m3);
+        writer.field("air_grass_pollen", weather.grass_pollen_grains_m3);
+        writer.field("air_birch_pollen", weather.birch_pollen_grains_m3);
+        writer.field("air_alder_pollen", weather.alder_pollen_grains_m3);
+        writer.field("air_dust", weather.dust_ug_m3);
+        writer.field("air_carbon_monoxide", weather.carbon_monoxide_ug_m3);
+        writer.field("air_pm2_5", weather.pm2_5_ug_m3);
+        writer.field("air_pm10", weather.pm10_ug_m3);
+        writer.field("air_european_aqi", weather.european_aqi);
+    }
+
+    for (int i = 0; i < 24; i++)
+        writer.field(OPC_BIN_FIELDS[i], opc.bin_counts[i]);
+
+    writer.timestamp((uint64_t)sample.timestamp);
+    return writer.ok() ? writer.length() : 0;
+}
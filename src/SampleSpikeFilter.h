@@ -0,0 +1,126 @@
+#pragma once
+#include <stdio.h>
+#include "OpcN3Accumulator.h"
+#include "SampleRecord.h"
+#include "SpikeDetector.h"
+
+#ifndef SPIKE_WINDOW
+#define SPIKE_WINDOW 31 // Samples per channel the median and MAD are taken over
+#endif
+
+enum SpikeChannel : uint8_t
+{
+    SPIKE_PM1 = 1 << 0,
+    SPIKE_PM2_5 = 1 << 1,
+    SPIKE_PM10 = 1 << 2,
+    SPIKE_UPPER_BINS = 1 << 3 // Concentration of bins 13-24
+};
+
+// Outcome of the check of one sample
+struct SpikeCheck
+{
+    uint8_t flags;  // SpikeChannel bits of the channels that spiked
+    float score;    // Highest robust score over the channels; NAN during warm-up
+    bool suppress;  // Drop the sample from uploads and aggregates
+};
+
+struct SpikeFilterStats
+{
+    uint32_t checked;
+    uint32_t flagged;
+    uint32_t suppressed;
+    uint32_t last_check_us;
+    uint32_t max_check_us;
+    uint64_t total_check_us;
+};
+
+// Flags isolated spikes (a puff of smoke, a fan glitch) in PM1/PM2.5/PM10 and
+// in the concentration of the upper bins, with one SpikeDetector per channel.
+// PM-only samples are checked on the PM channels. With suppress set, flagged
+// samples are marked to be left out of uploads and aggregates; otherwise
+// they are only annotated. Used by the processing task only.
+class SampleSpikeFilter
+{
+public:
+    SampleSpikeFilter(float threshold, bool suppress, float min_scale_ug_m3 = 1.0f, float min_scale_cm3 = 0.05f)
+        : _suppress(suppress),
+          _detectors{SpikeDetector<SPIKE_WINDOW>(threshold, min_scale_ug_m3),
+                     SpikeDetector<SPIKE_WINDOW>(threshold, min_scale_ug_m3),
+                     SpikeDetector<SPIKE_WINDOW>(threshold, min_scale_ug_m3),
+                     SpikeDetector<SPIKE_WINDOW>(threshold, min_scale_cm3)},
+          _last{0, NAN, false}, _stats{}
+    {
+    }
+
+    const SpikeCheck &check(const SampleRecord &sample)
+    {
+        float values[CHANNEL_COUNT] = {sample.opc.pm_a, sample.opc.pm_b, sample.opc.pm_c, NAN};
+        OpcN3Accumulator histogram;
+        if (sample.kind == SAMPLE_FULL && histogram.add(sample.opc))
+            values[UPPER_BINS] = histogram.concentration(12, 23);
+
+        _last.flags = 0;
+        _last.score = NAN;
+        for (int c = 0; c < CHANNEL_COUNT; c++)
+        {
+            if (isnan(values[c]))
+                continue;
+            float score = _detectors[c].check(values[c]);
+            if (_detectors[c].isSpike(score))
+                _last.flags |= (uint8_t)(1 << c);
+            _last.score = fmaxf(_last.score, score);
+        }
+        _last.suppress = _suppress && _last.flags != 0;
+        _stats.checked++;
+        if (_last.flags)
+            _stats.flagged++;
+        if (_last.suppress)
+            _stats.suppressed++;
+        return _last;
+    }
+
+    // Time the caller measured for the last check()
+    void recordCheckTime(uint32_t us)
+    {
+        _stats.last_check_us = us;
+        if (us > _stats.max_check_us)
+            _stats.max_check_us = us;
+        _stats.total_check_us += us;
+    }
+
+    const SpikeCheck &last() const { return _last; }
+    const SpikeFilterStats &stats() const { return _stats; }
+    float averageCheckUs() const { return _stats.checked ? (float)_stats.total_check_us / _stats.checked : 0.0f; }
+
+private:
+    enum Channel
+    {
+        PM1,
+        PM2_5,
+        PM10,
+        UPPER_BINS,
+        CHANNEL_COUNT
+    };
+
+    bool _suppress;
+    SpikeDetector<SPIKE_WINDOW> _detectors[CHANNEL_COUNT];
+    SpikeCheck _last;
+    SpikeFilterStats _stats;
+};
+
+// Names of the channels in flags, for logs
+inline void spikeChannelNames(uint8_t flags, char *out, size_t size)
+{
+    static const char *const NAMES[4] = {"pm1", "pm2_5", "pm10", "upper_bins"};
+    size_t used = 0;
+    out[0] = '\0';
+    for (int c = 0; c < 4; c++)
+    {
+        if (!(flags & (1 << c)))
+            continue;
+        int written = snprintf(out + used, size - used, "%s%s", used ? "," : "", NAMES[c]);
+        if (written < 0 || (size_t)written >= size - used)
+            return;
+        used += written;
+    }
+}
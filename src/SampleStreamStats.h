@@ -0,0 +1,135 @@
+#pragma once
+#include "LineProtocolWriter.h"
+#include "OpcN3Accumulator.h"
+#include "SampleRecord.h"
+#include "StreamingStats.h"
+
+// Field names of the per-bin concentration statistics
+static const char *const OPC_CONC_EWMA_FIELDS[24] = {
+    "opc_conc_00_ewma", "opc_conc_01_ewma", "opc_conc_02_ewma", "opc_conc_03_ewma", "opc_conc_04_ewma",
+    "opc_conc_05_ewma", "opc_conc_06_ewma", "opc_conc_07_ewma", "opc_conc_08_ewma", "opc_conc_09_ewma",
+    "opc_conc_10_ewma", "opc_conc_11_ewma", "opc_conc_12_ewma", "opc_conc_13_ewma", "opc_conc_14_ewma",
+    "opc_conc_15_ewma", "opc_conc_16_ewma", "opc_conc_17_ewma", "opc_conc_18_ewma", "opc_conc_19_ewma",
+    "opc_conc_20_ewma", "opc_conc_21_ewma", "opc_conc_22_ewma", "opc_conc_23_ewma"};
+static const char *const OPC_CONC_P95_FIELDS[24] = {
+    "opc_conc_00_p95", "opc_conc_01_p95", "opc_conc_02_p95", "opc_conc_03_p95", "opc_conc_04_p95",
+    "opc_conc_05_p95", "opc_conc_06_p95", "opc_conc_07_p95", "opc_conc_08_p95", "opc_conc_09_p95",
+    "opc_conc_10_p95", "opc_conc_11_p95", "opc_conc_12_p95", "opc_conc_13_p95", "opc_conc_14_p95",
+    "opc_conc_15_p95", "opc_conc_16_p95", "opc_conc_17_p95", "opc_conc_18_p95", "opc_conc_19_p95",
+    "opc_conc_20_p95", "opc_conc_21_p95", "opc_conc_22_p95", "opc_conc_23_p95"};
+
+// The values SampleStreamStats writes, copied out so that a sample can be
+// serialized in another task than the one updating the statistics. NAN
+// marks a channel without values; NaN fields are not written.
+struct SampleStreamSnapshot
+{
+    static const int CHANNEL_COUNT = 6;
+    float channels[CHANNEL_COUNT][5]; // mean, stddev, ewma, p50, p95
+    float bins[OpcN3Accumulator::BIN_COUNT][2]; // ewma, p95
+    bool has_bins;
+
+    void write(LineProtocolWriter &writer) const
+    {
+        static const char *const FIELDS[CHANNEL_COUNT][5] = {
+            {"opc_pm1_mean", "opc_pm1_stddev", "opc_pm1_ewma", "opc_pm1_p50", "opc_pm1_p95"},
+            {"opc_pm2_5_mean", "opc_pm2_5_stddev", "opc_pm2_5_ewma", "opc_pm2_5_p50", "opc_pm2_5_p95"},
+            {"opc_pm10_mean", "opc_pm10_stddev", "opc_pm10_ewma", "opc_pm10_p50", "opc_pm10_p95"},
+            {"scd41_co2_mean", "scd41_co2_stddev", "scd41_co2_ewma", "scd41_co2_p50", "scd41_co2_p95"},
+            {"opc_temperature_mean", "opc_temperature_stddev", "opc_temperature_ewma", "opc_temperature_p50",
+             "opc_temperature_p95"},
+            {"scd41_temperature_mean", "scd41_temperature_stddev", "scd41_temperature_ewma",
+             "scd41_temperature_p50", "scd41_temperature_p95"}};
+
+        for (int c = 0; c < CHANNEL_COUNT; c++)
+        {
+            for (int f = 0; f < 5; f++)
+                writer.field(FIELDS[c][f], channels[c][f]);
+        }
+        if (!has_bins)
+            return;
+        for (int i = 0; i < OpcN3Accumulator::BIN_COUNT; i++)
+        {
+            writer.field(OPC_CONC_EWMA_FIELDS[i], bins[i][0], 4);
+            writer.field(OPC_CONC_P95_FIELDS[i], bins[i][1], 4);
+        }
+    }
+};
+
+// Streaming statistics of the PM, CO2 and temperature channels, and
+// optionally of the per-bin number concentrations, since boot. Written with
+// every full sample as <field>_mean, _stddev, _ewma, _p50 and _p95; bins get
+// only _ewma and _p95 to keep the line short. PM-only samples count towards
+// the PM channels. Used by the processing task only.
+class SampleStreamStats
+{
+public:
+    explicit SampleStreamStats(float ewma_alpha = 0.1f, bool bins = false) : _bins(bins)
+    {
+        for (int c = 0; c < CHANNEL_COUNT; c++)
+            _channels[c] = StreamingStats(ewma_alpha);
+        for (int i = 0; i < OpcN3Accumulator::BIN_COUNT; i++)
+            _concentrations[i] = StreamingStats(ewma_alpha);
+    }
+
+    void add(const SampleRecord &sample)
+    {
+        _channels[PM1].add(sample.opc.pm_a);
+        _channels[PM2_5].add(sample.opc.pm_b);
+        _channels[PM10].add(sample.opc.pm_c);
+        if (sample.kind != SAMPLE_FULL)
+            return;
+        _channels[CO2].add(sample.co2);
+        _channels[OPC_TEMPERATURE].add(sample.opc.temperature_c);
+        _channels[SCD_TEMPERATURE].add(sample.scd_temperature_c);
+        OpcN3Accumulator histogram;
+        if (_bins && histogram.add(sample.opc))
+        {
+            for (int i = 0; i < OpcN3Accumulator::BIN_COUNT; i++)
+                _concentrations[i].add(histogram.concentration(i));
+        }
+    }
+
+    void snapshot(SampleStreamSnapshot &out) const
+    {
+        for (int c = 0; c < CHANNEL_COUNT; c++)
+        {
+            const StreamingStats &stats = _channels[c];
+            bool empty = stats.count() == 0;
+            out.channels[c][0] = empty ? NAN : stats.mean();
+            out.channels[c][1] = empty ? NAN : stats.stddev();
+            out.channels[c][2] = empty ? NAN : stats.ewma();
+            out.channels[c][3] = empty ? NAN : stats.median();
+            out.channels[c][4] = empty ? NAN : stats.p95();
+        }
+        out.has_bins = _bins && _concentrations[0].count() > 0;
+        for (int i = 0; i < OpcN3Accumulator::BIN_COUNT; i++)
+        {
+            out.bins[i][0] = out.has_bins ? _concentrations[i].ewma() : NAN;
+            out.bins[i][1] = out.has_bins ? _concentrations[i].p95() : NAN;
+        }
+    }
+
+    void write(LineProtocolWriter &writer) const
+    {
+        SampleStreamSnapshot values;
+        snapshot(values);
+        values.write(writer);
+    }
+
+private:
+    enum Channel
+    {
+        PM1,
+        PM2_5,
+        PM10,
+        CO2,
+        OPC_TEMPERATURE,
+        SCD_TEMPERATURE,
+        CHANNEL_COUNT
+    };
+    static_assert(CHANNEL_COUNT == SampleStreamSnapshot::CHANNEL_COUNT, "Snapshot channels out of step");
+
+    bool _bins;
+    StreamingStats _channels[CHANNEL_COUNT];
+    StreamingStats _concentrations[OpcN3Accumulator::BIN_COUNT];
+};
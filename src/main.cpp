@@ -11,6 +11,14 @@
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 #include "DerivedMetrics.h"
+#include "SampleRecord.h"
+#include "SampleSerializer.h"
+#include "SampleAggregator.h"
+#include "SpscQueue.h"
+#include "PipelineStage.h"
+#include "JournalLittleFs.h"
+#include "BatchUplink.h"
+#include "InfluxHttpTransport.h"
 #include <time.h>
 
 // --- Pin Configuration ---
@@ -29,10 +37,57 @@ const unsigned long measurementSleepMs = SENSOR_SLEEP_MS;
 OpcN3 opc(OPC_SS_PIN);
 SensirionI2cScd4x scd4x;
 const int MAX_CONSECUTIVE_FAILURES = 5;
+const unsigned long FAILURE_RECOVERY_MS = 2500;
 OpenMeteoClient openMeteo(WEATHER_LATITUDE, WEATHER_LONGITUDE, WEATHER_UPDATE_INTERVAL_MS);
 OpenMeteoData latestWeatherData{};
 TaskHandle_t weatherTaskHandle = nullptr;
 
+// --- Pipeline ---
+// Acquisition (OPC-N3 SPI and SCD41 I2C) runs at high priority on core 1.
+// Processing (spike filter, indices, statistics) and uplink (line protocol,
+// InfluxDB HTTPS) run on core 0 next to the WiFi stack. The stages are
+// connected by lock-free queues, so a slow network never delays the next
+// sensor read.
+#ifndef SAMPLE_QUEUE_CAPACITY
+#define SAMPLE_QUEUE_CAPACITY 16
+#endif
+#ifndef SAMPLE_QUEUE_POLICY
+#define SAMPLE_QUEUE_POLICY SPSC_DROP_OLDEST
+#endif
+#ifndef UPLINK_QUEUE_CAPACITY
+#define UPLINK_QUEUE_CAPACITY 4
+#endif
+#ifndef ACQUISITION_STACK_SIZE
+#define ACQUISITION_STACK_SIZE 6144
+#endif
+#ifndef PROCESSING_STACK_SIZE
+#define PROCESSING_STACK_SIZE 6144
+#endif
+#ifndef UPLINK_STACK_SIZE
+#define UPLINK_STACK_SIZE 8192
+#endif
+#ifndef PIPELINE_TELEMETRY_MS
+#define PIPELINE_TELEMETRY_MS 60000
+#endif
+
+SpscQueue<SampleRecord, SAMPLE_QUEUE_CAPACITY> sampleQueue(SAMPLE_QUEUE_POLICY);
+// Processing only forwards a sample when there is room, so this never drops
+SpscQueue<UplinkRecord, UPLINK_QUEUE_CAPACITY> uplinkQueue(SPSC_DROP_NEWEST);
+
+static void acquisitionTask(void *pvParameters);
+static void processingTask(void *pvParameters);
+static void uplinkTask(void *pvParameters);
+
+PipelineStage acquisitionStage({"Acquisition", ACQUISITION_STACK_SIZE, 3, 1}, acquisitionTask);
+PipelineStage processingStage({"Processing", PROCESSING_STACK_SIZE, 2, 0}, processingTask);
+PipelineStage uplinkStage({"Uplink", UPLINK_STACK_SIZE, 1, 0}, uplinkTask);
+
+// --- Boot State ---
+volatile bool networkReady = false;
+unsigned long bootWifiMs = 0;
+unsigned long bootTimeSyncMs = 0;
+unsigned long bootInfluxMs = 0;
+
 #if defined(ESP32)
 #define DEVICE "ESP32"
 #else
@@ -40,7 +95,127 @@ TaskHandle_t weatherTaskHandle = nullptr;
 #endif
 
 InfluxDBClient client(INFLUXDB_URL, INFLUXDB_ORG, INFLUXDB_BUCKET, INFLUXDB_TOKEN, InfluxDbCloud2CACert);
-Point sensorPoint("full");
+// "full,device=...,ssid=..." start of every line, built once in setup()
+char linePrefix[96];
+// Bin geometry for the size distribution fields, from the sensor's bin edges
+OpcN3BinGeometry binGeometry;
+
+// --- Mass Concentration ---
+// PM1/PM2.5/PM10 are recomputed from the histogram with the particle density
+// and hygroscopicity (kappa) of OPC_DENSITY_PROFILE, once as measured and
+// once corrected for water uptake at the sensor's humidity reading.
+#ifndef OPC_DENSITY_PROFILE
+#define OPC_DENSITY_PROFILE OPCN3_PROFILE_URBAN
+#endif
+OpcN3MassEngine massEngine(OPC_DENSITY_PROFILE);
+const SampleModels sampleModels = {&binGeometry, &massEngine};
+
+// --- Air Quality Indices ---
+// Sliding 1 h / 8 h / 24 h PM means with the EU CAQI and the US NowCast/AQI,
+// updated by the processing task and written with every point
+AirQualityTracker airQuality;
+
+// --- Streaming Statistics ---
+// With STREAM_STATS set, full samples carry running mean/stddev, EWMA, median
+// and p95 since boot of the PM, CO2 and temperature channels (and with
+// STREAM_STATS_BINS of the per-bin concentrations).
+#ifndef STREAM_STATS
+#define STREAM_STATS 0
+#endif
+#ifndef STREAM_STATS_BINS
+#define STREAM_STATS_BINS 0
+#endif
+#ifndef STREAM_STATS_EWMA_ALPHA
+#define STREAM_STATS_EWMA_ALPHA 0.1f
+#endif
+#if STREAM_STATS
+SampleStreamStats streamStats(STREAM_STATS_EWMA_ALPHA, STREAM_STATS_BINS);
+#endif
+
+// --- Spike Filter ---
+// SPIKE_FILTER 1 flags isolated spikes in PM and the upper bins (calc_spike);
+// 2 also keeps flagged samples out of uploads, indices and aggregates.
+#ifndef SPIKE_FILTER
+#define SPIKE_FILTER 0
+#endif
+#ifndef SPIKE_THRESHOLD
+#define SPIKE_THRESHOLD 5.0f
+#endif
+#if SPIKE_FILTER
+SampleSpikeFilter spikeFilter(SPIKE_THRESHOLD, SPIKE_FILTER >= 2);
+#endif
+
+// --- Windowed Aggregation ---
+// With AGGREGATE_WINDOW_S set, InfluxDB receives one "aggregate" line per
+// window (min/max/mean/stddev/p95 and summed bins) instead of every sample.
+// AGGREGATE_RAW_TO_SERIAL still prints each raw line on the serial port.
+#ifndef AGGREGATE_WINDOW_S
+#define AGGREGATE_WINDOW_S 0
+#endif
+#ifndef AGGREGATE_RAW_TO_SERIAL
+#define AGGREGATE_RAW_TO_SERIAL 0
+#endif
+#if AGGREGATE_WINDOW_S > 0
+SampleAggregator aggregator(AGGREGATE_WINDOW_S, &sampleModels);
+char aggregatePrefix[96];
+#endif
+
+// --- Batched Uplink ---
+// Samples are written to InfluxDB in multi-line requests of up to
+// UPLINK_BATCH_POINTS lines, or after UPLINK_BATCH_MS at the latest. The
+// batch of a failed request goes to the journal, using the packed samples
+// kept in UPLINK_SPILL_BYTES. Without a journal it is retried as a whole with
+// a growing delay, and samples that no longer fit into the UPLINK_BATCH_BYTES
+// buffer meanwhile are lost.
+#ifndef UPLINK_BATCH_POINTS
+#define UPLINK_BATCH_POINTS 10
+#endif
+#ifndef UPLINK_BATCH_MS
+#define UPLINK_BATCH_MS 60000
+#endif
+#ifndef UPLINK_BATCH_BYTES
+#define UPLINK_BATCH_BYTES 16384
+#endif
+#ifndef UPLINK_RETRY_MS
+#define UPLINK_RETRY_MS 5000
+#endif
+#ifndef UPLINK_MAX_RETRY_MS
+#define UPLINK_MAX_RETRY_MS 120000
+#endif
+#ifndef UPLINK_SPILL_BYTES
+#define UPLINK_SPILL_BYTES 2048
+#endif
+// Write bodies are gzip-compressed into a buffer of UPLINK_GZIP_BYTES; a body
+// whose compressed form does not fit is sent uncompressed
+#ifndef UPLINK_GZIP
+#define UPLINK_GZIP 1
+#endif
+#ifndef UPLINK_GZIP_BYTES
+#define UPLINK_GZIP_BYTES 8192
+#endif
+InfluxHttpTransport influxTransport(INFLUXDB_URL, INFLUXDB_ORG, INFLUXDB_BUCKET, INFLUXDB_TOKEN, InfluxDbCloud2CACert);
+#if UPLINK_GZIP
+uint8_t gzipBuffer[UPLINK_GZIP_BYTES];
+#endif
+BatchUplink<InfluxHttpTransport, UPLINK_BATCH_BYTES> uplink(influxTransport, {UPLINK_BATCH_POINTS, UPLINK_BATCH_MS,
+                                                                               UPLINK_RETRY_MS, UPLINK_MAX_RETRY_MS});
+
+// --- Store-and-Forward Journal ---
+// Samples whose InfluxDB write failed are kept on LittleFS and replayed in
+// batches, with their original timestamps, once writes succeed again.
+#ifndef JOURNAL_SEGMENT_BYTES
+#define JOURNAL_SEGMENT_BYTES 16384
+#endif
+#ifndef JOURNAL_MAX_SEGMENTS
+#define JOURNAL_MAX_SEGMENTS 8
+#endif
+#ifndef JOURNAL_RETRY_MS
+#define JOURNAL_RETRY_MS 30000
+#endif
+const char *JOURNAL_DIR = "/journal";
+SampleJournal<JournalLittleFsStorage, JOURNAL_MAX_SEGMENTS> journal(JournalLittleFsStorage(), JOURNAL_DIR,
+                                                                   JOURNAL_SEGMENT_BYTES);
+bool journalReady = false;
 
 // Wait until NTP has synchronized system time to a reasonable value
 static void waitForTimeSync()
@@ -56,6 +231,20 @@ static void waitForTimeSync()
   Serial.println(" done");
 }
 
+// Log how long each boot step took. Network and sensor steps overlap, so the
+// total is close to the slower of the two rather than their sum.
+static void printBootTimings(unsigned long totalMs, unsigned long opcReadyMs)
+{
+  Serial.println("\nBoot timings:");
+  Serial.printf("  wifi: %lu ms, ntp: %lu ms, influxdb: %lu ms\n", bootWifiMs, bootTimeSyncMs, bootInfluxMs);
+  for (int step = 0; step < OpcN3::BOOT_STEP_COUNT; step++)
+  {
+    Serial.printf("  opc_%s: %lu ms\n", OpcN3::bootStepName((OpcN3::BootStep)step),
+                  (unsigned long)opc.bootStepMs((OpcN3::BootStep)step));
+  }
+  Serial.printf("  opc total: %lu ms, boot total: %lu ms\n", opcReadyMs, totalMs);
+}
+
 static void weatherTask(void *pvParameters)
 {
   (void)pvParameters;
@@ -67,41 +256,480 @@ static void weatherTask(void *pvParameters)
   }
 }
 
-void setup()
+static void printDerivedMetrics(const SampleRecord &sample)
 {
-  Serial.begin(115200);
-  while (!Serial)
-    ;
-  Serial.println("\n\nOPC-N3 Sensor Reader - Structured Version");
+  uint32_t pollenCount = calculatePollenCount(sample.opc);
+  uint8_t pollenLevel = classifyPollenLevel(pollenCount);
+  uint8_t co2Quality = classifyCo2Quality(sample.co2);
+  Serial.printf("Pollen count: %u\n", pollenCount);
+  Serial.printf("Pollen level: %s (%u)\n", pollenLevelName(pollenLevel), pollenLevel);
+  Serial.printf("CO2 quality: %s (%u)\n", co2QualityName(co2Quality), co2Quality);
+  const AirQualityIndices &indices = airQuality.indices();
+  if (!isnan(indices.caqi_hourly))
+    Serial.printf("CAQI: %.0f (%s)\n", indices.caqi_hourly, caqiLevelName(classifyCaqi(indices.caqi_hourly)));
+  if (!isnan(indices.aqi_us))
+    Serial.printf("US AQI: %.0f (NowCast PM2.5 %.1f ug/m3)\n", indices.aqi_us, indices.nowcast_pm2_5);
+}
+
+// Hand a sample from the acquisition stage to the processing stage
+static void queueSample(SampleRecord &sample, uint32_t startedUs)
+{
+  sample.acquired_ms = millis();
+  if (!sampleQueue.push(sample))
+  {
+    Serial.println("Sample queue full, sample dropped");
+  }
+  processingStage.notify();
+  acquisitionStage.recordItem(sample.acquired_ms, startedUs, 0);
+}
+
+// Spike check, air quality indices, streaming statistics and derived
+// metrics. Each sample goes on with a copy of the state it is to be written
+// with; the uplink task serializes it. Samples stay in the sample queue
+// (which drops the oldest on overflow) while the uplink queue is full.
+static void processingTask(void *pvParameters)
+{
+  PipelineStage *stage = static_cast<PipelineStage *>(pvParameters);
+  static SampleRecord sample;
+  static UplinkRecord record;
+  for (;;)
+  {
+    stage->waitForWork(1000);
+    while (uplinkQueue.size() < uplinkQueue.capacity() && sampleQueue.pop(sample))
+    {
+      uint32_t startedUs = micros();
+      bool suppressed = false;
+      record.has_spike = false;
+#if SPIKE_FILTER
+      const SpikeCheck &spike = spikeFilter.check(sample);
+      spikeFilter.recordCheckTime(micros() - startedUs);
+      if (spike.flags)
+      {
+        char channels[40];
+        spikeChannelNames(spike.flags, channels, sizeof(channels));
+        Serial.printf("Spike in %s (score %.1f)%s\n", channels, spike.score, spike.suppress ? ", suppressed" : "");
+      }
+      suppressed = spike.suppress;
+      record.spike = spike;
+      record.has_spike = true;
+#endif
+      if (!suppressed)
+      {
+        airQuality.add(sample.timestamp, sample.opc.pm_b, sample.opc.pm_c);
+#if STREAM_STATS
+        streamStats.add(sample);
+#endif
+      }
+      if (sample.kind == SAMPLE_FULL)
+      {
+        printDerivedMetrics(sample);
+      }
+      record.sample = sample;
+      record.airQuality = airQuality.indices();
+      record.has_stats = false;
+#if STREAM_STATS
+      if (sample.kind == SAMPLE_FULL)
+      {
+        streamStats.snapshot(record.stats);
+        record.has_stats = true;
+      }
+#endif
+      // Aggregation counts suppressed samples as spikes, so they go on
+      if ((!suppressed || AGGREGATE_WINDOW_S > 0) && uplinkQueue.push(record))
+      {
+        uplinkStage.notify();
+      }
+      stage->recordItem(sample.acquired_ms, startedUs, sampleQueue.size());
+    }
+  }
+}
+
+// Scratch buffer of the uplink task for journal payloads, replayed records
+// and aggregate lines; used by one helper at a time
+static uint8_t uplinkScratch[JOURNAL_RECORD_MAX_SIZE];
+
+// Packed journal payloads of the samples in the uplink batch, in batch order
+// as [length, 2 bytes][payload]. When a write fails, the batch is journaled
+// from here (lines without an entry as their text) instead of waiting in RAM,
+// so it survives a reboot.
+static uint8_t uplinkSpill[UPLINK_SPILL_BYTES];
+static size_t uplinkSpillUsed = 0;
+static uint16_t uplinkSpillCount = 0;
+
+static void journalPayload(size_t len)
+{
+  if (!journalReady || len == 0 || !journal.append(uplinkScratch, (uint16_t)len))
+  {
+    Serial.println("Journal write failed, sample lost");
+    return;
+  }
+  Serial.printf("Sample journaled (%lu pending)\n", (unsigned long)journal.pending());
+}
+
+// Keep a sample that could not be sent for a later replay, packed
+static void journalSample(const SampleRecord &sample)
+{
+  journalPayload(packSample(sample, uplinkScratch, sizeof(uplinkScratch)));
+}
+
+// Aggregates have no sample to pack; they are kept as the line of length
+// len that was written to uplinkScratch + 1
+static void journalLine(size_t len)
+{
+  uplinkScratch[0] = JOURNAL_RECORD_LINE;
+  journalPayload(len > 0 ? 1 + len : 0);
+}
+
+// Remember the packed sample of the line just added to the batch. Lines
+// behind the last entry (the spill buffer was full) are journaled as text.
+static void spillSample(const SampleRecord &sample)
+{
+  if (uplinkSpillCount + 1 != uplink.points() || uplinkSpillUsed + 2 >= sizeof(uplinkSpill))
+    return;
+  size_t len = packSample(sample, uplinkSpill + uplinkSpillUsed + 2, sizeof(uplinkSpill) - uplinkSpillUsed - 2);
+  if (len == 0)
+    return;
+  uplinkSpill[uplinkSpillUsed] = (uint8_t)len;
+  uplinkSpill[uplinkSpillUsed + 1] = (uint8_t)(len >> 8);
+  uplinkSpillUsed += 2 + len;
+  uplinkSpillCount++;
+}
+
+static void clearSpill()
+{
+  uplinkSpillUsed = 0;
+  uplinkSpillCount = 0;
+}
+
+// Move the batch of a failed write to the journal and empty it. Returns the
+// number of lines that could not be journaled.
+static uint32_t spillBatch()
+{
+  uint32_t lost = 0;
+  size_t spillOffset = 0;
+  uint16_t index = 0;
+  const char *line = uplink.lines();
+  while (*line)
+  {
+    const char *end = strchr(line, '\n');
+    size_t lineLen = end - line;
+    bool kept;
+    if (index < uplinkSpillCount)
+    {
+      size_t len = uplinkSpill[spillOffset] | (uplinkSpill[spillOffset + 1] << 8);
+      kept = journal.append(uplinkSpill + spillOffset + 2, (uint16_t)len);
+      spillOffset += 2 + len;
+    }
+    else
+    {
+      kept = 1 + lineLen <= sizeof(uplinkScratch);
+      if (kept)
+      {
+        uplinkScratch[0] = JOURNAL_RECORD_LINE;
+        memcpy(uplinkScratch + 1, line, lineLen);
+        kept = journal.append(uplinkScratch, (uint16_t)(1 + lineLen));
+      }
+    }
+    if (!kept)
+      lost++;
+    index++;
+    line = end + 1;
+  }
+  uplink.clear();
+  clearSpill();
+  return lost;
+}
+
+#if AGGREGATE_WINDOW_S > 0
+// Add the aggregate line of length len at uplinkScratch + 1 to the batch, or
+// journal it if the batch is full
+static void batchAggregate(size_t len)
+{
+  if (len > 0 && !uplink.add((const char *)uplinkScratch + 1, len))
+  {
+    Serial.println("Uplink batch full");
+    journalLine(len);
+  }
+}
+
+// Close the current window once it is over, without waiting for the first
+// sample of the next one
+static void flushAggregate(const AirQualityIndices *airQuality)
+{
+  batchAggregate(aggregator.flush(time(nullptr), aggregatePrefix, (char *)uplinkScratch + 1,
+                                  sizeof(uplinkScratch) - 1, airQuality));
+}
+#endif
+
+// Serialize a record straight into the uplink batch. What no longer fits
+// goes to the journal.
+static void batchRecord(const UplinkRecord &record)
+{
+  const SampleRecord &sample = record.sample;
+  SampleState state = record.state();
+#if AGGREGATE_WINDOW_S > 0
+  // Aggregate lines are rare, so they are written to the scratch buffer
+  // first, where they can be journaled as they are
+  char *line = (char *)uplinkScratch + 1;
+  size_t size = sizeof(uplinkScratch) - 1;
+  if (AGGREGATE_RAW_TO_SERIAL &&
+      serializeSample(sample, linePrefix, line, size, &sampleModels, &state) > 0)
+  {
+    Serial.println(line);
+  }
+  batchAggregate(aggregator.add(sample, aggregatePrefix, line, size, &state));
+#else
+  size_t room = 0;
+  char *line = uplink.reserve(room);
+  size_t length = serializeSample(sample, linePrefix, line, room, &sampleModels, &state);
+  if (uplink.commit(length))
+  {
+    spillSample(sample);
+    return;
+  }
+  if (uplink.points() == 0)
+  {
+    // Offered the whole batch buffer and still too long
+    Serial.println("Line protocol too long, sample dropped");
+    return;
+  }
+  Serial.println("Uplink batch full");
+  journalSample(sample);
+#endif
+}
+
+// Send journaled samples through the empty uplink batch, oldest first and as
+// many per request as fit. Stops at the first failed write; the rest stays
+// journaled.
+static void replayJournal()
+{
+  static SampleRecord sample;
+
+  while (!journal.empty() && uplink.points() == 0)
+  {
+    JournalCursor cursor = journal.readCursor();
+    JournalCursor batchEnd = cursor;
+    uint32_t count = 0;
+    uint16_t len = 0;
+    bool full = false;
+    while (journal.next(cursor, uplinkScratch, sizeof(uplinkScratch), len))
+    {
+      size_t room = 0;
+      char *line = uplink.reserve(room);
+      size_t lineLen = 0;
+      if (len > 1 && uplinkScratch[0] == JOURNAL_RECORD_LINE)
+      {
+        if ((size_t)len - 1 < room)
+        {
+          lineLen = len - 1;
+          memcpy(line, uplinkScratch + 1, lineLen);
+        }
+      }
+      else if (unpackSample(uplinkScratch, len, sample))
+      {
+        lineLen = serializeSample(sample, linePrefix, line, room, &sampleModels);
+      }
+      else
+      {
+        batchEnd = cursor; // Unknown format; skip it
+        continue;
+      }
+      // A line that does not fit the rest of the batch starts the next one
+      if (lineLen == 0 || !uplink.commit(lineLen))
+      {
+        if (count == 0)
+        {
+          Serial.println("Journaled sample too long for a replay batch, skipped");
+          batchEnd = cursor;
+        }
+        full = true;
+        break;
+      }
+      batchEnd = cursor;
+      count++;
+    }
+    if (!full)
+      batchEnd = cursor; // Reached the end of the journal
+
+    if (count > 0)
+    {
+      UplinkFlushResult result = uplink.flush(true);
+      if (result == UPLINK_FLUSH_FAILED)
+      {
+        Serial.print("Journal replay failed: ");
+        Serial.println(influxTransport.lastError());
+        uplink.clear(); // Still journaled
+        return;
+      }
+      if (result == UPLINK_FLUSH_DROPPED)
+      {
+        Serial.printf("InfluxDB rejected %lu journaled samples: ", (unsigned long)count);
+        Serial.println(influxTransport.lastError());
+      }
+      else
+      {
+        Serial.printf("Replayed %lu journaled samples\n", (unsigned long)count);
+      }
+    }
+    journal.commit(batchEnd);
+    if (!full)
+      return;
+  }
+}
+
+// Serializes samples into batches and writes them to InfluxDB. The
+// HTTPS request blocks only this task; acquisition keeps its timing on the
+// other core. A batch whose write failed goes to the journal, which is
+// replayed after the next successful write.
+static void uplinkTask(void *pvParameters)
+{
+  PipelineStage *stage = static_cast<PipelineStage *>(pvParameters);
+  static UplinkRecord record;
+  unsigned long lastReplayMs = 0;
+  for (;;)
+  {
+    stage->waitForWork(min(uplink.msUntilDue(), (uint32_t)1000));
+    while (uplinkQueue.pop(record))
+    {
+      processingStage.notify(); // Room for the next sample
+      uint32_t startedUs = micros();
+      batchRecord(record);
+      stage->recordItem(record.sample.acquired_ms, startedUs, uplinkQueue.size());
+    }
+#if AGGREGATE_WINDOW_S > 0
+    flushAggregate(record.sample.timestamp ? &record.airQuality : nullptr);
+#endif
+
+    bool wrote = false;
+    if (WiFi.status() == WL_CONNECTED)
+    {
+      uint16_t points = uplink.points();
+      switch (uplink.flush())
+      {
+      case UPLINK_FLUSH_SENT:
+        Serial.printf("Wrote %u points to InfluxDB in %lu ms\n", points,
+                      (unsigned long)uplink.stats().last_request_ms);
+        clearSpill();
+        wrote = true;
+        break;
+      case UPLINK_FLUSH_FAILED:
+        Serial.printf("InfluxDB write of %u points failed, ", points);
+        if (journalReady)
+        {
+          uint32_t lost = spillBatch();
+          Serial.printf("journaled %lu (%lu lost): ", (unsigned long)(points - lost), (unsigned long)lost);
+        }
+        else
+        {
+          Serial.print("will retry: ");
+        }
+        Serial.println(influxTransport.lastError());
+        break;
+      case UPLINK_FLUSH_DROPPED:
+        Serial.printf("InfluxDB rejected %u points: ", points);
+        Serial.println(influxTransport.lastError());
+        clearSpill();
+        break;
+      default:
+        break;
+      }
+    }
+
+    // Replay after a successful write, or retry now and then while idle.
+    // Replay uses the batch buffer, so it waits until the batch was sent.
+    if (journalReady && !journal.empty() && WiFi.status() == WL_CONNECTED && uplink.points() == 0 &&
+        (wrote || millis() - lastReplayMs >= JOURNAL_RETRY_MS))
+    {
+      lastReplayMs = millis();
+      replayJournal();
+    }
+  }
+}
+
+static void printPipelineTelemetry()
+{
+  Serial.println("\nPipeline telemetry:");
+  acquisitionStage.printStats();
+  processingStage.printStats();
+  uplinkStage.printStats();
+
+  SpscQueueStats samples = sampleQueue.stats();
+  SpscQueueStats uplinkQueueStats = uplinkQueue.stats();
+  Serial.printf("  sample queue: %u/%u, high water %lu, dropped %lu oldest / %lu newest\n",
+                (unsigned)sampleQueue.size(), (unsigned)sampleQueue.capacity(), (unsigned long)samples.high_water,
+                (unsigned long)samples.dropped_oldest, (unsigned long)samples.dropped_newest);
+  Serial.printf("  uplink queue: %u/%u, high water %lu\n",
+                (unsigned)uplinkQueue.size(), (unsigned)uplinkQueue.capacity(),
+                (unsigned long)uplinkQueueStats.high_water);
+  const BatchUplinkStats &uplinkStats = uplink.stats();
+  Serial.printf("  influxdb: %lu requests, %.1f points/request (max %u), latency avg %lu / max %lu ms, "
+                "%lu failed, %lu points dropped, %lu overflowed, %u buffered\n",
+                (unsigned long)uplinkStats.requests, uplink.pointsPerRequest(),
+                (unsigned)uplinkStats.max_points_per_request, (unsigned long)uplink.averageRequestMs(),
+                (unsigned long)uplinkStats.max_request_ms, (unsigned long)uplinkStats.requests_failed,
+                (unsigned long)uplinkStats.points_dropped, (unsigned long)uplinkStats.points_overflowed,
+                (unsigned)uplink.points());
+  const UplinkTransportStats &transportStats = influxTransport.stats();
+  Serial.printf("  compression: ratio %.2f over %lu bodies (%lu uncompressed), %lu -> %lu bytes, "
+                "cpu %lu ms, est. airtime saved %lu ms\n",
+                influxTransport.compressionRatio(), (unsigned long)transportStats.bodies,
+                (unsigned long)transportStats.bodies_uncompressed, (unsigned long)transportStats.bytes_in,
+                (unsigned long)transportStats.bytes_out, (unsigned long)(transportStats.compress_us / 1000),
+                (unsigned long)influxTransport.estimatedAirtimeSavedMs());
+  Serial.printf("  influxdb connection: %lu handshakes (%lu ms total, %lu failed), %lu reused, "
+                "last request %lu ms (max %lu)\n",
+                (unsigned long)transportStats.handshakes, (unsigned long)transportStats.handshake_ms,
+                (unsigned long)transportStats.connect_failures, (unsigned long)transportStats.reused,
+                (unsigned long)transportStats.last_request_ms, (unsigned long)transportStats.max_request_ms);
+  const OpenMeteoStats &weatherStats = openMeteo.stats();
+  Serial.printf("  open-meteo: %lu requests (%lu failed), %lu handshakes (%lu ms total), %lu reused, "
+                "latency avg %lu / max %lu ms\n",
+                (unsigned long)weatherStats.requests, (unsigned long)weatherStats.failures,
+                (unsigned long)weatherStats.handshakes, (unsigned long)weatherStats.handshake_ms,
+                (unsigned long)weatherStats.reused,
+                (unsigned long)(weatherStats.requests ? weatherStats.total_request_ms / weatherStats.requests : 0),
+                (unsigned long)weatherStats.max_request_ms);
+#if SPIKE_FILTER
+  const SpikeFilterStats &spikeStats = spikeFilter.stats();
+  Serial.printf("  spike filter: %lu checked, %lu flagged, %lu suppressed, check avg %.1f / max %lu us\n",
+                (unsigned long)spikeStats.checked, (unsigned long)spikeStats.flagged,
+                (unsigned long)spikeStats.suppressed, spikeFilter.averageCheckUs(),
+                (unsigned long)spikeStats.max_check_us);
+#endif
+  const JournalStats &journalStats = journal.stats();
+  Serial.printf("  journal: %lu pending in %u segments, %lu journaled, %lu replayed, %lu evicted\n",
+                (unsigned long)journal.pending(), (unsigned)journal.segmentCount(),
+                (unsigned long)journalStats.appended, (unsigned long)journalStats.replayed,
+                (unsigned long)journalStats.evicted_records);
+}
+
+// Bring up WiFi, NTP and the InfluxDB connection. Runs in its own task during
+// boot so that the sensors can be initialized at the same time.
+static void networkBootTask(void *pvParameters)
+{
+  (void)pvParameters;
+  unsigned long stepStartMs = millis();
 
   // Connect to WiFi
-  Serial.printf("Connecting to WiFi '%s'", WIFI_SSID);
+  Serial.printf("Connecting to WiFi '%s'\n", WIFI_SSID);
   WiFi.mode(WIFI_STA);
   WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
   while (WiFi.status() != WL_CONNECTED)
   {
-    Serial.print(".");
-    delay(500);
+    vTaskDelay(pdMS_TO_TICKS(100));
   }
-  Serial.println(" connected");
+  Serial.println("WiFi connected");
+  bootWifiMs = millis() - stepStartMs;
+  stepStartMs = millis();
 
   // Synchronize time for accurate timestamps
   timeSync(TZ_INFO, "pool.ntp.org", "time.nis.gov");
   waitForTimeSync();
-
-  // Fetch initial weather data
-  if (openMeteo.update()) {
-    latestWeatherData = openMeteo.data();
-  }
-
-  // Start asynchronous weather updates
-  xTaskCreatePinnedToCore(weatherTask, "WeatherTask", 8192, nullptr, 1, &weatherTaskHandle, 1);
+  bootTimeSyncMs = millis() - stepStartMs;
+  stepStartMs = millis();
 
   // Prepare InfluxDB client
-  client.setWriteOptions(WriteOptions().writePrecision(WritePrecision::S));
-  sensorPoint.addTag("device", DEVICE);
-  sensorPoint.addTag("ssid", WiFi.SSID());
-
+  // Only used to check the connection; writes go through influxTransport
   if (client.validateConnection())
   {
     Serial.print("Connected to InfluxDB: ");
@@ -112,6 +740,22 @@ void setup()
     Serial.print("InfluxDB connection failed: ");
     Serial.println(client.getLastErrorMessage());
   }
+  bootInfluxMs = millis() - stepStartMs;
+
+  networkReady = true;
+  vTaskDelete(nullptr);
+}
+
+void setup()
+{
+  Serial.begin(115200);
+  while (!Serial)
+    ;
+  Serial.println("\n\nOPC-N3 Sensor Reader - Structured Version");
+  unsigned long bootStartMs = millis();
+
+  // Network bring-up proceeds in the background while the sensors start
+  xTaskCreatePinnedToCore(networkBootTask, "NetworkBoot", 8192, nullptr, 1, nullptr, 0);
 
   // Initialize SPI bus
   SPI.begin(OPC_SCK_PIN, OPC_MISO_PIN, OPC_MOSI_PIN, OPC_SS_PIN);
@@ -124,34 +768,169 @@ void setup()
   scd4x.reinit();
   scd4x.startPeriodicMeasurement();
 
-  // Initialize the OPC-N3 sensor
-  if (!opc.begin())
+  // Initialize the OPC-N3 sensor without blocking, until both it and the
+  // network are up
+  opc.startBegin();
+  OpcN3::BeginStatus opcStatus = OpcN3::BEGIN_PENDING;
+  unsigned long opcReadyMs = 0;
+  while (opcStatus == OpcN3::BEGIN_PENDING || !networkReady)
+  {
+    if (opcStatus == OpcN3::BEGIN_PENDING)
+    {
+      opcStatus = opc.pollBegin();
+      opcReadyMs = millis() - bootStartMs;
+    }
+    delay(1);
+  }
+  if (opcStatus != OpcN3::BEGIN_OK)
   {
     Serial.println("FATAL: OPC-N3 initialization failed. Program halted.");
     while (1)
       ; // Halt execution
   }
+#if defined(OPC_SPI_BURST) && OPC_SPI_BURST
+  opc.setBurstMode(true);
+#endif
+
+  // Before the pipeline starts; the firmware does not change the configuration later.
+  // Samples refer to the configuration by version, so the factory table takes its version.
+  if (opc.config().version == 0 || !binGeometry.configure(opc.config()))
+  {
+    Serial.println("WARNING: Invalid OPC-N3 bin boundaries, using factory defaults");
+    binGeometry.configure(OpcN3BinGeometry::factoryEdges(), opc.config().version);
+  }
+  massEngine.configure(binGeometry);
+  Serial.printf("Density profile: %s (%.2f/%.2f g/cm3, kappa %.2f)\n", massEngine.profile().name,
+                massEngine.profile().fine_density_g_cm3, massEngine.profile().coarse_density_g_cm3,
+                massEngine.profile().kappa);
+
+#if UPLINK_GZIP
+  influxTransport.setCompression(gzipBuffer, sizeof(gzipBuffer));
+#endif
+  if (!buildLinePrefix("full", DEVICE, WiFi.SSID().c_str(), linePrefix, sizeof(linePrefix)))
+    Serial.println("WARNING: SSID too long for the line prefix; tag truncated");
+#if AGGREGATE_WINDOW_S > 0
+  buildLinePrefix("aggregate", DEVICE, WiFi.SSID().c_str(), aggregatePrefix, sizeof(aggregatePrefix));
+#endif
+
+  // Mount the journal; samples left over from before a reboot are replayed
+  if (LittleFS.begin(true) && (LittleFS.exists(JOURNAL_DIR) || LittleFS.mkdir(JOURNAL_DIR)))
+  {
+    journalReady = journal.begin();
+    Serial.printf("Journal: %lu samples pending\n", (unsigned long)journal.pending());
+  }
+  else
+  {
+    Serial.println("Journal unavailable: LittleFS mount failed");
+  }
+
+  // Start asynchronous weather updates on the network core; the first fetch
+  // happens immediately
+  xTaskCreatePinnedToCore(weatherTask, "WeatherTask", 8192, nullptr, 1, &weatherTaskHandle, 0);
+
+  // Start the pipeline, consumers first
+  uplinkStage.start();
+  processingStage.start();
+  acquisitionStage.start();
+
+  printBootTimings(millis() - bootStartMs, opcReadyMs);
+}
+
+#if defined(OPC_PM_INTERVAL_MS) && OPC_PM_INTERVAL_MS > 0
+// Fast PM-only reads in the gaps between full histogram reads. Returns true
+// while a PM read is in progress so the next histogram read waits for it.
+static bool serviceFastPmRead(unsigned long now, unsigned long lastHistogramMs)
+{
+  static bool pmReadInProgress = false;
+  static unsigned long lastPmMs = 0;
+
+  if (!pmReadInProgress)
+  {
+    if (now - lastHistogramMs >= measurementSleepMs ||
+        now - lastHistogramMs < OPC_PM_INTERVAL_MS ||
+        now - lastPmMs < OPC_PM_INTERVAL_MS)
+    {
+      return false; // histogram due, or too soon for another PM read
+    }
+    lastPmMs = now;
+    pmReadInProgress = opc.startReadPm();
+    return pmReadInProgress;
+  }
+
+  OpcN3PmData pmData;
+  OpcN3::ReadStatus status = opc.pollPm(pmData);
+  if (status == OpcN3::READ_PENDING)
+  {
+    return true;
+  }
+  pmReadInProgress = false;
+
+  if (status == OpcN3::READ_OK)
+  {
+    uint32_t startedUs = micros();
+    Serial.printf("Fast PM: PM1 %.2f, PM2.5 %.2f, PM10 %.2f ug/m3 (bus %lu us)\n",
+                  pmData.pm_a, pmData.pm_b, pmData.pm_c, (unsigned long)opc.lastBusTimeUs());
+    SampleRecord sample = {};
+    sample.kind = SAMPLE_PM;
+    sample.timestamp = time(nullptr);
+    sample.opc.pm_a = pmData.pm_a;
+    sample.opc.pm_b = pmData.pm_b;
+    sample.opc.pm_c = pmData.pm_c;
+    queueSample(sample, startedUs);
+  }
+  return false;
 }
+#endif
 
-void loop()
+// One step of the acquisition state machine; never blocks
+static void serviceAcquisition()
 {
   static int consecutive_failures = 0;
   static bool discard_next_success = true; // discard first valid reading
   static unsigned long lastMeasurementMs = 0;
+  static bool readInProgress = false;
+  static bool recovering = false;
+  static unsigned long recoveryStartMs = 0;
 
   unsigned long now = millis();
-  if (now - lastMeasurementMs < measurementSleepMs)
+  if (recovering && now - recoveryStartMs < FAILURE_RECOVERY_MS)
   {
-    return; // wait until the next measurement interval without blocking
+    return; // give the sensor time to recover without blocking
   }
-  lastMeasurementMs = now;
+  recovering = false;
+
+  if (!readInProgress)
+  {
+#if defined(OPC_PM_INTERVAL_MS) && OPC_PM_INTERVAL_MS > 0
+    if (serviceFastPmRead(now, lastMeasurementMs))
+    {
+      return;
+    }
+#endif
+    if (now - lastMeasurementMs < measurementSleepMs)
+    {
+      return; // wait until the next measurement interval without blocking
+    }
+    lastMeasurementMs = now;
 
-  Serial.println("\n--- Requesting New Measurement ---");
+    Serial.println("\n--- Requesting New Measurement ---");
+    readInProgress = opc.startRead();
+    return;
+  }
 
   // Weather data is updated asynchronously
 
+  // Advance the OPC-N3 busy/ready handshake; returns immediately while busy
+  uint32_t startedUs = micros();
   OpcN3Data sensorData;
-  if (opc.readData(sensorData))
+  OpcN3::ReadStatus readStatus = opc.poll(sensorData);
+  if (readStatus == OpcN3::READ_PENDING)
+  {
+    return;
+  }
+  readInProgress = false;
+
+  if (readStatus == OpcN3::READ_OK)
   {
     consecutive_failures = 0; // Reset counter on success
 
@@ -195,87 +974,30 @@ void loop()
       Serial.printf("PM10: %.2f ug/m3\n", sensorData.pm_c);
       Serial.printf("Actual Sampling Period: %.2f s\n", sensorData.sampling_period_s); // Verify the period
       Serial.printf("Checksum: OK (Received: 0x%04X)\n", sensorData.received_checksum);
+      Serial.printf("SPI bus time: %lu us (%s)\n", (unsigned long)opc.lastBusTimeUs(), opc.burstMode() ? "burst" : "paced");
 
       // Print the individual bin counts with their size ranges
-      Serial.println("\nParticle Size Bin Counts:");
+      const OpcN3Config &opcConfig = opc.config();
+      Serial.printf("\nParticle Size Bin Counts (config v%u):\n", sensorData.config_version);
       for (int i = 0; i < 24; i++)
       {
         Serial.printf("  Bin %2d (%.2f - %.2f um): %u counts\n",
                       i,
-                      sensorData.bin_boundaries_um[i],
-                      sensorData.bin_boundaries_um[i + 1],
+                      opcConfig.bin_boundaries_um[i],
+                      opcConfig.bin_boundaries_um[i + 1],
                       sensorData.bin_counts[i]);
       }
 
-      // Derived metrics
-      uint32_t pollenCount = calculatePollenCount(sensorData);
-      uint8_t pollenLevel = classifyPollenLevel(pollenCount);
-      uint8_t co2Quality = classifyCo2Quality(co2);
-      Serial.printf("Pollen count: %u\n", pollenCount);
-      Serial.printf("Pollen level: %s (%u)\n", pollenLevelName(pollenLevel), pollenLevel);
-      Serial.printf("CO2 quality: %s (%u)\n", co2QualityName(co2Quality), co2Quality);
-
-      // Prepare InfluxDB point
-      sensorPoint.clearFields();
-      sensorPoint.addField("opc_pm1", sensorData.pm_a);
-      sensorPoint.addField("opc_pm2_5", sensorData.pm_b);
-      sensorPoint.addField("opc_pm10", sensorData.pm_c);
-      sensorPoint.addField("opc_temperature", sensorData.temperature_c);
-      sensorPoint.addField("opc_humidity", sensorData.humidity_rh);
-      sensorPoint.addField("scd41_co2", co2);
-      sensorPoint.addField("scd41_temperature", scdTemperature);
-      sensorPoint.addField("scd41_humidity", scdHumidity);
-      sensorPoint.addField("calc_pollen_count", (int)pollenCount);
-      sensorPoint.addField("calc_pollen_level", pollenLevel);
-      sensorPoint.addField("calc_co2_quality", co2Quality);
-
-      if (latestWeatherData.valid)
-      {
-        sensorPoint.addField("weather_temperature", latestWeatherData.temperature_c);
-        sensorPoint.addField("weather_humidity", latestWeatherData.humidity_rh);
-        sensorPoint.addField("weather_apparent_temperature", latestWeatherData.apparent_temperature_c);
-        sensorPoint.addField("weather_is_day", latestWeatherData.is_day);
-        sensorPoint.addField("weather_rain", latestWeatherData.rain_mm);
-        sensorPoint.addField("weather_cloud_cover_pct", latestWeatherData.cloud_cover_pct);
-        sensorPoint.addField("weather_pressure_msl", latestWeatherData.pressure_msl_hpa);
-        sensorPoint.addField("weather_surface_pressure", latestWeatherData.surface_pressure_hpa);
-        sensorPoint.addField("weather_wind_speed_kmh", latestWeatherData.wind_speed_kmh);
-        sensorPoint.addField("weather_wind_dir_deg", latestWeatherData.wind_direction_deg);
-        sensorPoint.addField("weather_wind_gusts_kmh", latestWeatherData.wind_gusts_kmh);
-        sensorPoint.addField("air_ragweed_pollen", latestWeatherData.ragweed_pollen_grains_m3);
-        sensorPoint.addField("air_olive_pollen", latestWeatherData.olive_pollen_grains_m3);
-        sensorPoint.addField("air_mugwort_pollen", latestWeatherData.mugwort_pollen_grains_m3);
-        sensorPoint.addField("air_grass_pollen", latestWeatherData.grass_pollen_grains_m3);
-        sensorPoint.addField("air_birch_pollen", latestWeatherData.birch_pollen_grains_m3);
-        sensorPoint.addField("air_alder_pollen", latestWeatherData.alder_pollen_grains_m3);
-        sensorPoint.addField("air_dust", latestWeatherData.dust_ug_m3);
-        sensorPoint.addField("air_carbon_monoxide", latestWeatherData.carbon_monoxide_ug_m3);
-        sensorPoint.addField("air_pm2_5", latestWeatherData.pm2_5_ug_m3);
-        sensorPoint.addField("air_pm10", latestWeatherData.pm10_ug_m3);
-        sensorPoint.addField("air_european_aqi", latestWeatherData.european_aqi);
-      }
-
-      // Add individual bin counts as separate fields for detailed analysis
-      for (int i = 0; i < 24; i++)
-      {
-        char fieldName[12];
-        snprintf(fieldName, sizeof(fieldName), "opc_bin_%02d", i);
-        sensorPoint.addField(fieldName, (int)sensorData.bin_counts[i]);
-      }
-
-      sensorPoint.setTime();
-
-      Serial.print("Writing to InfluxDB: ");
-      Serial.println(client.pointToLineProtocol(sensorPoint));
-      if (WiFi.status() != WL_CONNECTED)
-      {
-        Serial.println("WiFi connection lost");
-      }
-      if (!client.writePoint(sensorPoint))
-      {
-        Serial.print("InfluxDB write failed: ");
-        Serial.println(client.getLastErrorMessage());
-      }
+      // The processing stage adds indices and statistics, the uplink writes it
+      SampleRecord sample = {};
+      sample.kind = SAMPLE_FULL;
+      sample.timestamp = time(nullptr);
+      sample.opc = sensorData;
+      sample.co2 = co2;
+      sample.scd_temperature_c = scdTemperature;
+      sample.scd_humidity_rh = scdHumidity;
+      sample.weather = latestWeatherData;
+      queueSample(sample, startedUs);
     }
   }
   else
@@ -290,6 +1012,29 @@ void loop()
     }
 
     // Wait for recovery on failure
-    delay(2500);
+    recovering = true;
+    recoveryStartMs = millis();
+  }
+}
+
+static void acquisitionTask(void *pvParameters)
+{
+  (void)pvParameters;
+  for (;;)
+  {
+    serviceAcquisition();
+    vTaskDelay(1); // The OPC-N3 handshake polls every 10 ms anyway
+  }
+}
+
+// The Arduino loop only reports pipeline telemetry
+void loop()
+{
+  static unsigned long lastTelemetryMs = 0;
+  if (millis() - lastTelemetryMs >= PIPELINE_TELEMETRY_MS)
+  {
+    lastTelemetryMs = millis();
+    printPipelineTelemetry();
   }
+  delay(100);
 }
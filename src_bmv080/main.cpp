@@ -40,9 +40,31 @@ void setup()
         ;
     Serial.println("\n\nBMV080 Reader");
 
-    Serial.printf("Connecting to WiFi '%s'", WIFI_SSID);
+    // Start associating with the access point, then bring up the sensor while
+    // the connection is being established
     WiFi.mode(WIFI_STA);
     WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
+
+    Wire.begin();
+    if (!bmv080.begin(SF_BMV080_DEFAULT_ADDRESS, Wire))
+    {
+        Serial.println("BMV080 not detected. Check wiring.");
+        while (1)
+            ;
+    }
+    Serial.println("BMV080 found!");
+
+    bmv080.init();
+    if (bmv080.setMode(SF_BMV080_MODE_CONTINUOUS))
+    {
+        Serial.println("BMV080 set to continuous mode");
+    }
+    else
+    {
+        Serial.println("Error setting BMV080 mode");
+    }
+
+    Serial.printf("Connecting to WiFi '%s'", WIFI_SSID);
     while (WiFi.status() != WL_CONNECTED)
     {
         Serial.print(".");
@@ -67,25 +89,6 @@ void setup()
         Serial.print("InfluxDB connection failed: ");
         Serial.println(client.getLastErrorMessage());
     }
-
-    Wire.begin();
-    if (!bmv080.begin(SF_BMV080_DEFAULT_ADDRESS, Wire))
-    {
-        Serial.println("BMV080 not detected. Check wiring.");
-        while (1)
-            ;
-    }
-    Serial.println("BMV080 found!");
-
-    bmv080.init();
-    if (bmv080.setMode(SF_BMV080_MODE_CONTINUOUS))
-    {
-        Serial.println("BMV080 set to continuous mode");
-    }
-    else
-    {
-        Serial.println("Error setting BMV080 mode");
-    }
 }
 
 void loop()
@@ -48,9 +48,19 @@ void setup()
         ;
     Serial.println("\n\nSCD41 Manual Calibration and Logging");
 
-    Serial.printf("Connecting to WiFi '%s'", WIFI_SSID);
+    // Start associating with the access point, then bring up the sensor while
+    // the connection is being established
     WiFi.mode(WIFI_STA);
     WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
+
+    Wire.begin();
+    scd4x.begin(Wire, SCD41_I2C_ADDR_62);
+    scd4x.wakeUp();
+    scd4x.stopPeriodicMeasurement();
+    scd4x.reinit();
+    scd4x.startPeriodicMeasurement();
+
+    Serial.printf("Connecting to WiFi '%s'", WIFI_SSID);
     while (WiFi.status() != WL_CONNECTED)
     {
         Serial.print(".");
@@ -76,13 +86,6 @@ void setup()
         Serial.println(client.getLastErrorMessage());
     }
 
-    Wire.begin();
-    scd4x.begin(Wire, SCD41_I2C_ADDR_62);
-    scd4x.wakeUp();
-    scd4x.stopPeriodicMeasurement();
-    scd4x.reinit();
-    scd4x.startPeriodicMeasurement();
-
     // Inform the user to place the sensor in fresh air for calibration
     Serial.print("Place the sensor in fresh air (");
     Serial.print(CALIBRATION_CO2_PPM);
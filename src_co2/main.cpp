@@ -40,9 +40,19 @@ void setup()
         ;
     Serial.println("\n\nSCD41 CO2 Reader");
 
-    Serial.printf("Connecting to WiFi '%s'", WIFI_SSID);
+    // Start associating with the access point, then bring up the sensor while
+    // the connection is being established
     WiFi.mode(WIFI_STA);
     WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
+
+    Wire.begin();
+    scd4x.begin(Wire, SCD41_I2C_ADDR_62);
+    scd4x.wakeUp();
+    scd4x.stopPeriodicMeasurement();
+    scd4x.reinit();
+    scd4x.startPeriodicMeasurement();
+
+    Serial.printf("Connecting to WiFi '%s'", WIFI_SSID);
     while (WiFi.status() != WL_CONNECTED)
     {
         Serial.print(".");
@@ -68,13 +78,6 @@ void setup()
         Serial.print("InfluxDB connection failed: ");
         Serial.println(client.getLastErrorMessage());
     }
-
-    Wire.begin();
-    scd4x.begin(Wire, SCD41_I2C_ADDR_62);
-    scd4x.wakeUp();
-    scd4x.stopPeriodicMeasurement();
-    scd4x.reinit();
-    scd4x.startPeriodicMeasurement();
 }
 
 void loop()
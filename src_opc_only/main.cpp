@@ -5,6 +5,8 @@
 #include <InfluxDbCloud.h>
 #include "OpcN3.h"
 #include "config.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
 #include <time.h>
 
 // --- Pin Configuration ---
@@ -22,6 +24,13 @@ const unsigned long measurementSleepMs = SENSOR_SLEEP_MS;
 // --- Global Objects ---
 OpcN3 opc(OPC_SS_PIN);
 const int MAX_CONSECUTIVE_FAILURES = 5;
+const unsigned long FAILURE_RECOVERY_MS = 2500;
+
+// --- Boot State ---
+volatile bool networkReady = false;
+unsigned long bootWifiMs = 0;
+unsigned long bootTimeSyncMs = 0;
+unsigned long bootInfluxMs = 0;
 
 #if defined(ESP32)
 #define DEVICE "ESP32"
@@ -31,6 +40,7 @@ const int MAX_CONSECUTIVE_FAILURES = 5;
 
 InfluxDBClient client(INFLUXDB_URL, INFLUXDB_ORG, INFLUXDB_BUCKET, INFLUXDB_TOKEN, InfluxDbCloud2CACert);
 Point sensorPoint("opc_n3");
+Point pmPoint("opc_n3"); // Fast PM-only readings between full histogram reads
 
 static void waitForTimeSync()
 {
@@ -45,33 +55,33 @@ static void waitForTimeSync()
   Serial.println(" done");
 }
 
-void setup()
+// Bring up WiFi, NTP and the InfluxDB connection. Runs in its own task during
+// boot so that the sensor can be initialized at the same time.
+static void networkBootTask(void *pvParameters)
 {
-  Serial.begin(115200);
-  while (!Serial)
-    ;
-  Serial.println("\n\nOPC-N3 Sensor Reader - Structured Version");
+  (void)pvParameters;
+  unsigned long stepStartMs = millis();
 
   // Connect to WiFi
-  Serial.printf("Connecting to WiFi '%s'", WIFI_SSID);
+  Serial.printf("Connecting to WiFi '%s'\n", WIFI_SSID);
   WiFi.mode(WIFI_STA);
   WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
   while (WiFi.status() != WL_CONNECTED)
   {
-    Serial.print(".");
-    delay(500);
+    vTaskDelay(pdMS_TO_TICKS(100));
   }
-  Serial.println(" connected");
+  Serial.println("WiFi connected");
+  bootWifiMs = millis() - stepStartMs;
+  stepStartMs = millis();
 
   // Synchronize time for accurate timestamps
   timeSync(TZ_INFO, "pool.ntp.org", "time.nis.gov");
   waitForTimeSync();
+  bootTimeSyncMs = millis() - stepStartMs;
+  stepStartMs = millis();
 
   // Prepare InfluxDB client
   client.setWriteOptions(WriteOptions().writePrecision(WritePrecision::S));
-  sensorPoint.addTag("device", DEVICE);
-  sensorPoint.addTag("ssid", WiFi.SSID());
-
   if (client.validateConnection())
   {
     Serial.print("Connected to InfluxDB: ");
@@ -82,39 +92,165 @@ void setup()
     Serial.print("InfluxDB connection failed: ");
     Serial.println(client.getLastErrorMessage());
   }
+  bootInfluxMs = millis() - stepStartMs;
 
-  // Initialize SPI bus
-  SPI.begin(OPC_SCK_PIN, OPC_MISO_PIN, OPC_MOSI_PIN, OPC_SS_PIN);
+  networkReady = true;
+  vTaskDelete(nullptr);
+}
+
+// Log how long each boot step took. Network and sensor steps overlap, so the
+// total is close to the slower of the two rather than their sum.
+static void printBootTimings(unsigned long totalMs, unsigned long opcReadyMs)
+{
+  Serial.println("\nBoot timings:");
+  Serial.printf("  wifi: %lu ms, ntp: %lu ms, influxdb: %lu ms\n", bootWifiMs, bootTimeSyncMs, bootInfluxMs);
+  for (int step = 0; step < OpcN3::BOOT_STEP_COUNT; step++)
+  {
+    Serial.printf("  opc_%s: %lu ms\n", OpcN3::bootStepName((OpcN3::BootStep)step),
+                  (unsigned long)opc.bootStepMs((OpcN3::BootStep)step));
+  }
+  Serial.printf("  opc total: %lu ms, boot total: %lu ms\n", opcReadyMs, totalMs);
+}
+
+void setup()
+{
+  Serial.begin(115200);
+  while (!Serial)
+    ;
+  Serial.println("\n\nOPC-N3 Sensor Reader - Structured Version");
+  unsigned long bootStartMs = millis();
 
+  // Network bring-up proceeds in the background while the sensor starts
+  xTaskCreatePinnedToCore(networkBootTask, "NetworkBoot", 8192, nullptr, 1, nullptr, 0);
 
+  // Initialize SPI bus
+  SPI.begin(OPC_SCK_PIN, OPC_MISO_PIN, OPC_MOSI_PIN, OPC_SS_PIN);
 
-  // Initialize the OPC-N3 sensor
-  if (!opc.begin())
+  // Initialize the OPC-N3 sensor without blocking, until both it and the
+  // network are up
+  opc.startBegin();
+  OpcN3::BeginStatus opcStatus = OpcN3::BEGIN_PENDING;
+  unsigned long opcReadyMs = 0;
+  while (opcStatus == OpcN3::BEGIN_PENDING || !networkReady)
+  {
+    if (opcStatus == OpcN3::BEGIN_PENDING)
+    {
+      opcStatus = opc.pollBegin();
+      opcReadyMs = millis() - bootStartMs;
+    }
+    delay(1);
+  }
+  if (opcStatus != OpcN3::BEGIN_OK)
   {
     Serial.println("FATAL: OPC-N3 initialization failed. Program halted.");
     while (1)
       ; // Halt execution
   }
+#if defined(OPC_SPI_BURST) && OPC_SPI_BURST
+  opc.setBurstMode(true);
+#endif
+
+  sensorPoint.addTag("device", DEVICE);
+  sensorPoint.addTag("ssid", WiFi.SSID());
+  pmPoint.addTag("device", DEVICE);
+  pmPoint.addTag("ssid", WiFi.SSID());
+
+  printBootTimings(millis() - bootStartMs, opcReadyMs);
+}
+
+#if defined(OPC_PM_INTERVAL_MS) && OPC_PM_INTERVAL_MS > 0
+// Fast PM-only reads in the gaps between full histogram reads. Returns true
+// while a PM read is in progress so the next histogram read waits for it.
+static bool serviceFastPmRead(unsigned long now, unsigned long lastHistogramMs)
+{
+  static bool pmReadInProgress = false;
+  static unsigned long lastPmMs = 0;
+
+  if (!pmReadInProgress)
+  {
+    if (now - lastHistogramMs >= measurementSleepMs ||
+        now - lastHistogramMs < OPC_PM_INTERVAL_MS ||
+        now - lastPmMs < OPC_PM_INTERVAL_MS)
+    {
+      return false; // histogram due, or too soon for another PM read
+    }
+    lastPmMs = now;
+    pmReadInProgress = opc.startReadPm();
+    return pmReadInProgress;
+  }
+
+  OpcN3PmData pmData;
+  OpcN3::ReadStatus status = opc.pollPm(pmData);
+  if (status == OpcN3::READ_PENDING)
+  {
+    return true;
+  }
+  pmReadInProgress = false;
 
+  if (status == OpcN3::READ_OK)
+  {
+    Serial.printf("Fast PM: PM1 %.2f, PM2.5 %.2f, PM10 %.2f ug/m3 (bus %lu us)\n",
+                  pmData.pm_a, pmData.pm_b, pmData.pm_c, (unsigned long)opc.lastBusTimeUs());
+    pmPoint.clearFields();
+    pmPoint.addField("opc_pm1", pmData.pm_a);
+    pmPoint.addField("opc_pm2_5", pmData.pm_b);
+    pmPoint.addField("opc_pm10", pmData.pm_c);
+    pmPoint.setTime();
+    if (!client.writePoint(pmPoint))
+    {
+      Serial.print("InfluxDB write failed: ");
+      Serial.println(client.getLastErrorMessage());
+    }
+  }
+  return false;
 }
+#endif
 
 void loop()
 {
   static int consecutive_failures = 0;
   static bool discard_next_success = true; // discard first valid reading
   static unsigned long lastMeasurementMs = 0;
+  static bool readInProgress = false;
+  static bool recovering = false;
+  static unsigned long recoveryStartMs = 0;
 
   unsigned long now = millis();
-  if (now - lastMeasurementMs < measurementSleepMs)
+  if (recovering && now - recoveryStartMs < FAILURE_RECOVERY_MS)
   {
-    return; // wait until the next measurement interval without blocking
+    return; // give the sensor time to recover without blocking
   }
-  lastMeasurementMs = now;
+  recovering = false;
+
+  if (!readInProgress)
+  {
+#if defined(OPC_PM_INTERVAL_MS) && OPC_PM_INTERVAL_MS > 0
+    if (serviceFastPmRead(now, lastMeasurementMs))
+    {
+      return;
+    }
+#endif
+    if (now - lastMeasurementMs < measurementSleepMs)
+    {
+      return; // wait until the next measurement interval without blocking
+    }
+    lastMeasurementMs = now;
 
-  Serial.println("\n--- Requesting New Measurement ---");
+    Serial.println("\n--- Requesting New Measurement ---");
+    readInProgress = opc.startRead();
+    return;
+  }
 
+  // Advance the OPC-N3 busy/ready handshake; returns immediately while busy
   OpcN3Data sensorData;
-  if (opc.readData(sensorData))
+  OpcN3::ReadStatus readStatus = opc.poll(sensorData);
+  if (readStatus == OpcN3::READ_PENDING)
+  {
+    return;
+  }
+  readInProgress = false;
+
+  if (readStatus == OpcN3::READ_OK)
   {
     consecutive_failures = 0; // Reset counter on success
 
@@ -134,15 +270,17 @@ void loop()
       Serial.printf("PM10: %.2f ug/m3\n", sensorData.pm_c);
       Serial.printf("Actual Sampling Period: %.2f s\n", sensorData.sampling_period_s); // Verify the period
       Serial.printf("Checksum: OK (Received: 0x%04X)\n", sensorData.received_checksum);
+      Serial.printf("SPI bus time: %lu us (%s)\n", (unsigned long)opc.lastBusTimeUs(), opc.burstMode() ? "burst" : "paced");
 
       // Print the individual bin counts with their size ranges
-      Serial.println("\nParticle Size Bin Counts:");
+      const OpcN3Config &opcConfig = opc.config();
+      Serial.printf("\nParticle Size Bin Counts (config v%u):\n", sensorData.config_version);
       for (int i = 0; i < 24; i++)
       {
         Serial.printf("  Bin %2d (%.2f - %.2f um): %u counts\n",
                       i,
-                      sensorData.bin_boundaries_um[i],
-                      sensorData.bin_boundaries_um[i + 1],
+                      opcConfig.bin_boundaries_um[i],
+                      opcConfig.bin_boundaries_um[i + 1],
                       sensorData.bin_counts[i]);
       }
 
@@ -189,6 +327,7 @@ void loop()
     }
 
     // Wait for recovery on failure
-    delay(2500);
+    recovering = true;
+    recoveryStartMs = millis();
   }
 }
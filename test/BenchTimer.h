@@ -0,0 +1,43 @@
+#ifndef BENCH_TIMER_H
+#define BENCH_TIMER_H
+
+#include <chrono>
+#include <stdint.h>
+#include <stdio.h>
+#include <unity.h>
+
+// Keeps the benchmarked results alive so the compiler cannot drop the calls
+static volatile uint32_t benchSink;
+
+// Average nanoseconds per call of fn() over iterations calls, after one
+// warm-up call. fn returns a value that is folded into benchSink.
+template <class Fn>
+double nsPerCall(Fn fn, uint32_t iterations)
+{
+    benchSink = benchSink + (uint32_t)fn();
+    auto started = std::chrono::steady_clock::now();
+    uint32_t sink = 0;
+    for (uint32_t i = 0; i < iterations; i++)
+        sink += (uint32_t)fn();
+    auto elapsed = std::chrono::steady_clock::now() - started;
+    benchSink = benchSink + sink;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+}
+
+// Prints a benchmark result; timings depend on the host, so the benchmark
+// tests report them rather than assert on them. bytes, if given, is the
+// amount of data one call processes. Time per byte is reported instead of
+// cycles per byte: the clock rate of a native test host is not known, and
+// a cycle counter would tie the tests to one architecture.
+inline void reportBenchmark(const char *name, double ns, size_t bytes = 0)
+{
+    char message[128];
+    if (bytes > 0)
+        snprintf(message, sizeof(message), "%s: %.1f ns/call, %.2f ns/byte, %.1f MB/s", name, ns, ns / bytes,
+                 bytes * 1e3 / ns);
+    else
+        snprintf(message, sizeof(message), "%s: %.1f ns/call", name, ns);
+    TEST_MESSAGE(message);
+}
+
+#endif // BENCH_TIMER_H
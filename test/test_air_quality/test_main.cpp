@@ -0,0 +1,208 @@
+#include <unity.h>
+#include "AirQualityIndex.h"
+#include "../BenchTimer.h"
+
+static const time_t T0 = 1700000000 - 1700000000 % 86400; // Midnight UTC
+static const uint32_t BUCKET = AirQualityTracker::BUCKET_S;
+static AirQualityTracker tracker;
+
+// One sample in each of count buckets, starting at bucket first after T0
+static void fillBuckets(int first, int count, float pm2_5, float pm10)
+{
+    for (int i = first; i < first + count; i++)
+        TEST_ASSERT_TRUE(tracker.add(T0 + (time_t)i * BUCKET + 1, pm2_5, pm10));
+}
+
+void setUp() { tracker.reset(); }
+void tearDown() {}
+
+void test_caqi_breakpoints()
+{
+    // Hourly: PM2.5 15/30/55/110 and PM10 25/50/90/180 end the four bands
+    const float pm2_5[] = {0, 15, 30, 55, 110};
+    const float pm10[] = {0, 25, 50, 90, 180};
+    for (int i = 0; i < 5; i++)
+    {
+        TEST_ASSERT_EQUAL_FLOAT(25.0f * i, calculateCaqiHourly(pm2_5[i], 0.0f));
+        TEST_ASSERT_EQUAL_FLOAT(25.0f * i, calculateCaqiHourly(0.0f, pm10[i]));
+    }
+    TEST_ASSERT_EQUAL_FLOAT(37.5f, calculateCaqiHourly(22.5f, 10.0f));
+    TEST_ASSERT_EQUAL_FLOAT(125.0f, calculateCaqiHourly(165.0f, 0.0f)); // Slope continued
+    TEST_ASSERT_EQUAL_FLOAT(50.0f, calculateCaqiHourly(NAN, 50.0f));
+    TEST_ASSERT_FLOAT_IS_NAN(calculateCaqiHourly(NAN, NAN));
+
+    // Daily: PM2.5 10/20/30/60 and PM10 15/30/50/100
+    const float daily2_5[] = {0, 10, 20, 30, 60};
+    const float daily10[] = {0, 15, 30, 50, 100};
+    for (int i = 0; i < 5; i++)
+    {
+        TEST_ASSERT_EQUAL_FLOAT(25.0f * i, calculateCaqiDaily(daily2_5[i], 0.0f));
+        TEST_ASSERT_EQUAL_FLOAT(25.0f * i, calculateCaqiDaily(0.0f, daily10[i]));
+    }
+
+    TEST_ASSERT_EQUAL_UINT8(CAQI_VERY_LOW, classifyCaqi(24.9f));
+    TEST_ASSERT_EQUAL_UINT8(CAQI_LOW, classifyCaqi(25.0f));
+    TEST_ASSERT_EQUAL_UINT8(CAQI_HIGH, classifyCaqi(100.0f));
+    TEST_ASSERT_EQUAL_UINT8(CAQI_VERY_HIGH, classifyCaqi(100.5f));
+}
+
+void test_us_aqi_breakpoints()
+{
+    // Both ends of every PM2.5 band
+    const float pm2_5[][2] = {{0.0f, 0},     {9.0f, 50},    {9.1f, 51},    {35.4f, 100},
+                              {35.5f, 101},  {55.4f, 150},  {55.5f, 151},  {125.4f, 200},
+                              {125.5f, 201}, {225.4f, 300}, {225.5f, 301}, {325.4f, 500}};
+    for (const float *row : pm2_5)
+        TEST_ASSERT_EQUAL_FLOAT(row[1], calculateUsAqi(row[0], 0.0f));
+    const float pm10[][2] = {{54, 50},   {55, 51},   {154, 100}, {155, 101}, {254, 150},
+                             {255, 151}, {354, 200}, {355, 201}, {424, 300}, {425, 301}, {604, 500}};
+    for (const float *row : pm10)
+        TEST_ASSERT_EQUAL_FLOAT(row[1], calculateUsAqi(0.0f, row[0]));
+
+    // Truncated, not rounded: 9.09 is 9.0, 54.9 is 54
+    TEST_ASSERT_EQUAL_FLOAT(50.0f, calculateUsAqi(9.09f, 0.0f));
+    TEST_ASSERT_EQUAL_FLOAT(50.0f, calculateUsAqi(0.0f, 54.9f));
+    // The larger sub-index counts
+    TEST_ASSERT_EQUAL_FLOAT(101.0f, calculateUsAqi(35.5f, 54.0f));
+    TEST_ASSERT_FLOAT_IS_NAN(calculateUsAqi(NAN, NAN));
+}
+
+// Worked examples of the NowCast weight w = min / max, at least 0.5
+void test_nowcast_worked_example()
+{
+    // w = 10 / 30 is below 0.5: (30 + 0.5 x 20 + 0.25 x 10) / 1.75
+    const float steep[3] = {30.0f, 20.0f, 10.0f};
+    TEST_ASSERT_EQUAL_FLOAT(42.5f / 1.75f, calculateNowCast(steep, 3));
+
+    // w = 12 / 20 = 0.6; the missing hour 3 is skipped, hour 4 weighs 0.6^4
+    const float gap[5] = {20.0f, 16.0f, 12.0f, NAN, 18.0f};
+    float expected = (20.0f + 0.6f * 16.0f + 0.36f * 12.0f + 0.1296f * 18.0f) / (1.0f + 0.6f + 0.36f + 0.1296f);
+    TEST_ASSERT_EQUAL_FLOAT(expected, calculateNowCast(gap, 5));
+
+    // Constant air: the NowCast is the concentration
+    const float flat[12] = {7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7};
+    TEST_ASSERT_EQUAL_FLOAT(7.0f, calculateNowCast(flat, 12));
+
+    // Two of the three most recent hours are needed
+    const float missing[4] = {NAN, 8.0f, NAN, 9.0f};
+    TEST_ASSERT_FLOAT_IS_NAN(calculateNowCast(missing, 4));
+    const float enough[3] = {NAN, 8.0f, 8.0f};
+    TEST_ASSERT_EQUAL_FLOAT(8.0f, calculateNowCast(enough, 3));
+}
+
+// The tracker closes clock hours into the NowCast history
+void test_tracker_nowcast()
+{
+    const float hourly[3] = {10.0f, 20.0f, 30.0f}; // Oldest first
+    for (int h = 0; h < 3; h++)
+        fillBuckets(h * AirQualityTracker::BUCKETS_PER_HOUR, AirQualityTracker::BUCKETS_PER_HOUR, hourly[h], 0.0f);
+    // Hours 0 and 1 are closed, hour 2 is still open: (20 + 0.5 x 10) / 1.5
+    TEST_ASSERT_EQUAL_FLOAT(25.0f / 1.5f, tracker.indices().nowcast_pm2_5);
+
+    TEST_ASSERT_TRUE(tracker.add(T0 + 3 * 3600, 40.0f, 0.0f));
+    TEST_ASSERT_EQUAL_FLOAT(42.5f / 1.75f, tracker.indices().nowcast_pm2_5);
+    TEST_ASSERT_EQUAL_FLOAT(calculateUsAqi(42.5f / 1.75f, 0.0f), tracker.indices().aqi_us);
+}
+
+// A window's mean appears once 75 % of its buckets hold data
+void test_75_percent_fill_rule()
+{
+    const int hour = AirQualityTracker::BUCKETS_PER_HOUR;
+    const int needed = (hour * 3 + 3) / 4;
+    fillBuckets(0, needed - 1, 12.0f, 20.0f);
+    TEST_ASSERT_FLOAT_IS_NAN(tracker.indices().pm2_5_1h);
+    TEST_ASSERT_FLOAT_IS_NAN(tracker.indices().caqi_hourly);
+
+    fillBuckets(needed - 1, 1, 12.0f, 20.0f);
+    TEST_ASSERT_EQUAL_FLOAT(12.0f, tracker.indices().pm2_5_1h);
+    TEST_ASSERT_EQUAL_FLOAT(20.0f, tracker.indices().pm10_1h);
+    TEST_ASSERT_EQUAL_FLOAT(20.0f, tracker.indices().caqi_hourly);
+    TEST_ASSERT_FLOAT_IS_NAN(tracker.indices().pm2_5_8h);
+
+    // Several samples in one bucket fill it once
+    for (int i = 0; i < 20; i++)
+        tracker.add(T0 + (time_t)needed * BUCKET + 1, 12.0f, 20.0f);
+    TEST_ASSERT_FLOAT_IS_NAN(tracker.indices().pm2_5_8h);
+
+    // Gaps are fine as long as 75 % is there: every fourth bucket missing
+    tracker.reset();
+    for (int i = 0; i < 8 * hour; i++)
+    {
+        if (i % 4 != 3)
+            fillBuckets(i, 1, 5.0f, NAN);
+    }
+    TEST_ASSERT_EQUAL_FLOAT(5.0f, tracker.indices().pm2_5_8h);
+    TEST_ASSERT_FLOAT_IS_NAN(tracker.indices().pm10_8h);
+    TEST_ASSERT_FLOAT_IS_NAN(tracker.indices().pm2_5_24h);
+}
+
+// As the window slides, the oldest buckets leave it
+void test_eviction_as_the_window_slides()
+{
+    const int hour = AirQualityTracker::BUCKETS_PER_HOUR;
+    fillBuckets(0, hour, 10.0f, 10.0f);
+    TEST_ASSERT_EQUAL_FLOAT(10.0f, tracker.indices().pm2_5_1h);
+
+    fillBuckets(hour, hour / 2, 30.0f, 10.0f);
+    TEST_ASSERT_EQUAL_FLOAT(20.0f, tracker.indices().pm2_5_1h);
+    TEST_ASSERT_EQUAL_FLOAT(10.0f, tracker.indices().pm10_1h);
+
+    fillBuckets(hour + hour / 2, hour / 2, 30.0f, 10.0f);
+    TEST_ASSERT_EQUAL_FLOAT(30.0f, tracker.indices().pm2_5_1h);
+    TEST_ASSERT_FLOAT_IS_NAN(tracker.indices().pm2_5_8h);
+
+    // A pause of half an hour empties half the 1 h window: below 75 %
+    TEST_ASSERT_TRUE(tracker.add(T0 + (time_t)(2 * hour + hour / 2) * BUCKET, 30.0f, 10.0f));
+    TEST_ASSERT_FLOAT_IS_NAN(tracker.indices().pm2_5_1h);
+
+    // Samples older than the newest bucket are refused
+    TEST_ASSERT_FALSE(tracker.add(T0, 99.0f, 99.0f));
+}
+
+// Over a day of data, a gap longer than the 24 h ring starts over
+void test_reset_after_a_gap_of_more_than_a_day()
+{
+    const int day = AirQualityTracker::BUCKET_COUNT;
+    fillBuckets(0, day, 8.0f, 16.0f);
+    TEST_ASSERT_EQUAL_FLOAT(8.0f, tracker.indices().pm2_5_24h);
+    TEST_ASSERT_EQUAL_FLOAT(8.0f, tracker.indices().nowcast_pm2_5);
+
+    int restart = 2 * day + 3;
+    fillBuckets(restart, 1, 50.0f, 60.0f);
+    const AirQualityIndices &indices = tracker.indices();
+    TEST_ASSERT_FLOAT_IS_NAN(indices.pm2_5_1h);
+    TEST_ASSERT_FLOAT_IS_NAN(indices.pm2_5_24h);
+    TEST_ASSERT_FLOAT_IS_NAN(indices.caqi_daily);
+    TEST_ASSERT_FLOAT_IS_NAN(indices.nowcast_pm2_5);
+    TEST_ASSERT_FLOAT_IS_NAN(indices.aqi_us);
+
+    // Only data after the gap counts
+    fillBuckets(restart + 1, AirQualityTracker::BUCKETS_PER_HOUR, 50.0f, 60.0f);
+    TEST_ASSERT_EQUAL_FLOAT(50.0f, tracker.indices().pm2_5_1h);
+    TEST_ASSERT_EQUAL_FLOAT(60.0f, tracker.indices().pm10_1h);
+}
+
+void test_benchmark()
+{
+    time_t t = T0;
+    reportBenchmark("AirQualityTracker::add, 1 s samples", nsPerCall([&] {
+                        t += 1;
+                        tracker.add(t, 12.0f, 20.0f);
+                        return tracker.indices().pm2_5_1h;
+                    }, 500000));
+    reportBenchmark("calculateUsAqi", nsPerCall([&] { return calculateUsAqi((float)(t & 255), 40.0f); }, 500000));
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_caqi_breakpoints);
+    RUN_TEST(test_us_aqi_breakpoints);
+    RUN_TEST(test_nowcast_worked_example);
+    RUN_TEST(test_tracker_nowcast);
+    RUN_TEST(test_75_percent_fill_rule);
+    RUN_TEST(test_eviction_as_the_window_slides);
+    RUN_TEST(test_reset_after_a_gap_of_more_than_a_day);
+    RUN_TEST(test_benchmark);
+    return UNITY_END();
+}
@@ -0,0 +1,223 @@
+#include <unity.h>
+#include "BatchUplink.h"
+#include "../BenchTimer.h"
+
+// Records the requests and answers with a scripted result, on a manual clock
+struct FakeTransport
+{
+    unsigned long now_ms = 0;
+    UplinkWriteResult result = UPLINK_WRITE_OK;
+    uint32_t writes = 0;
+    unsigned long request_ms = 0; // Time a write takes
+    bool keep_body = true;
+    char last_body[512] = "";
+    size_t last_len = 0;
+
+    UplinkWriteResult write(const char *body, size_t len)
+    {
+        writes++;
+        last_len = len;
+        if (keep_body)
+            snprintf(last_body, sizeof(last_body), "%s", body);
+        now_ms += request_ms;
+        return result;
+    }
+
+    unsigned long millis() { return now_ms; }
+};
+
+typedef BatchUplink<FakeTransport, 256> Uplink;
+static const BatchUplinkConfig CONFIG = {3, 60000, 5000, 20000};
+
+static FakeTransport transport;
+
+void setUp() { transport = FakeTransport(); }
+void tearDown() {}
+
+static bool addLine(Uplink &uplink, const char *line) { return uplink.add(line, strlen(line)); }
+
+void test_flushes_when_max_points_are_buffered()
+{
+    Uplink uplink(transport, CONFIG);
+    TEST_ASSERT_TRUE(addLine(uplink, "m a=1i"));
+    TEST_ASSERT_TRUE(addLine(uplink, "m a=2i"));
+    TEST_ASSERT_FALSE(uplink.due());
+    TEST_ASSERT_EQUAL_INT(UPLINK_FLUSH_IDLE, uplink.flush());
+    TEST_ASSERT_TRUE(addLine(uplink, "m a=3i"));
+    TEST_ASSERT_TRUE(uplink.due());
+    TEST_ASSERT_EQUAL_INT(UPLINK_FLUSH_SENT, uplink.flush());
+    TEST_ASSERT_EQUAL_STRING("m a=1i\nm a=2i\nm a=3i\n", transport.last_body);
+    TEST_ASSERT_EQUAL_UINT16(0, uplink.points());
+    TEST_ASSERT_EQUAL_UINT32(1, uplink.stats().requests);
+    TEST_ASSERT_EQUAL_UINT32(3, uplink.stats().points_sent);
+    TEST_ASSERT_EQUAL_UINT16(3, uplink.stats().max_points_per_request);
+}
+
+void test_flushes_when_the_oldest_line_is_old_enough()
+{
+    Uplink uplink(transport, CONFIG);
+    TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, uplink.msUntilDue());
+    transport.now_ms = 1000;
+    addLine(uplink, "m a=1i");
+    transport.now_ms = 31000;
+    addLine(uplink, "m a=2i");
+    TEST_ASSERT_EQUAL_UINT32(30000, uplink.msUntilDue());
+    transport.now_ms = 61000;
+    TEST_ASSERT_EQUAL_UINT32(0, uplink.msUntilDue());
+    TEST_ASSERT_EQUAL_INT(UPLINK_FLUSH_SENT, uplink.flush());
+    TEST_ASSERT_EQUAL_UINT32(1, transport.writes);
+}
+
+void test_flushes_when_three_quarters_full()
+{
+    Uplink uplink(transport, {100, 60000, 5000, 20000});
+    char line[100];
+    memset(line, 'x', sizeof(line));
+    TEST_ASSERT_TRUE(uplink.add(line, sizeof(line)));
+    TEST_ASSERT_FALSE(uplink.due());
+    TEST_ASSERT_TRUE(uplink.add(line, sizeof(line)));
+    TEST_ASSERT_TRUE(uplink.due()); // 202 of 256 bytes
+}
+
+void test_force_sends_a_partial_batch()
+{
+    Uplink uplink(transport, CONFIG);
+    TEST_ASSERT_EQUAL_INT(UPLINK_FLUSH_IDLE, uplink.flush(true));
+    addLine(uplink, "m a=1i");
+    TEST_ASSERT_EQUAL_INT(UPLINK_FLUSH_SENT, uplink.flush(true));
+    TEST_ASSERT_EQUAL_size_t(7, transport.last_len);
+}
+
+void test_failed_batch_is_retried_with_backoff()
+{
+    Uplink uplink(transport, CONFIG);
+    for (int i = 0; i < 3; i++)
+        addLine(uplink, "m a=1i");
+    transport.result = UPLINK_WRITE_RETRY;
+
+    // 5 s, 10 s, 20 s, then capped at 20 s
+    const uint32_t delays[] = {5000, 10000, 20000, 20000};
+    for (uint32_t delay : delays)
+    {
+        TEST_ASSERT_EQUAL_INT(UPLINK_FLUSH_FAILED, uplink.flush());
+        TEST_ASSERT_TRUE(uplink.retrying());
+        TEST_ASSERT_EQUAL_UINT32(delay, uplink.msUntilDue());
+        transport.now_ms += delay - 1;
+        TEST_ASSERT_EQUAL_INT(UPLINK_FLUSH_IDLE, uplink.flush());
+        transport.now_ms += 1;
+    }
+
+    // Lines added meanwhile join the batch
+    addLine(uplink, "m a=2i");
+    transport.result = UPLINK_WRITE_OK;
+    TEST_ASSERT_EQUAL_INT(UPLINK_FLUSH_SENT, uplink.flush());
+    TEST_ASSERT_EQUAL_STRING("m a=1i\nm a=1i\nm a=1i\nm a=2i\n", transport.last_body);
+    TEST_ASSERT_FALSE(uplink.retrying());
+    TEST_ASSERT_EQUAL_UINT32(4, uplink.stats().requests_failed);
+    TEST_ASSERT_EQUAL_UINT32(4, uplink.stats().points_sent);
+}
+
+void test_rejected_batch_is_dropped()
+{
+    Uplink uplink(transport, CONFIG);
+    for (int i = 0; i < 3; i++)
+        addLine(uplink, "m a=1i");
+    transport.result = UPLINK_WRITE_REJECTED;
+    TEST_ASSERT_EQUAL_INT(UPLINK_FLUSH_DROPPED, uplink.flush());
+    TEST_ASSERT_EQUAL_UINT16(0, uplink.points());
+    TEST_ASSERT_FALSE(uplink.retrying());
+    TEST_ASSERT_EQUAL_UINT32(3, uplink.stats().points_dropped);
+    TEST_ASSERT_EQUAL_UINT32(0, uplink.stats().points_sent);
+}
+
+void test_full_buffer_refuses_lines()
+{
+    Uplink uplink(transport, {100, 60000, 5000, 20000});
+    char line[120];
+    memset(line, 'x', sizeof(line));
+    TEST_ASSERT_TRUE(uplink.add(line, sizeof(line)));
+    TEST_ASSERT_TRUE(uplink.add(line, sizeof(line)));
+    TEST_ASSERT_FALSE(uplink.add(line, sizeof(line))); // 242 used, 13 left
+    TEST_ASSERT_TRUE(addLine(uplink, "m a=1i"));
+    TEST_ASSERT_EQUAL_UINT32(1, uplink.stats().points_overflowed);
+    TEST_ASSERT_EQUAL_UINT16(3, uplink.points());
+    TEST_ASSERT_EQUAL_size_t(249, uplink.bytes());
+    TEST_ASSERT_EQUAL(0, uplink.lines()[uplink.bytes()]);
+}
+
+void test_reserve_and_commit_write_in_place()
+{
+    Uplink uplink(transport, CONFIG);
+    size_t room = 0;
+    char *tail = uplink.reserve(room);
+    TEST_ASSERT_EQUAL_size_t(255, room);
+    int len = snprintf(tail, room, "m a=%di", 7);
+    TEST_ASSERT_TRUE(uplink.commit((size_t)len));
+    TEST_ASSERT_EQUAL_STRING("m a=7i\n", uplink.lines());
+
+    // A line that did not fit (length 0) leaves the buffer as it was
+    tail = uplink.reserve(room);
+    memset(tail, 'x', 10);
+    TEST_ASSERT_FALSE(uplink.commit(0));
+    TEST_ASSERT_EQUAL_STRING("m a=7i\n", uplink.lines());
+    TEST_ASSERT_EQUAL_UINT32(1, uplink.stats().points_overflowed);
+}
+
+void test_clear_drops_the_batch_and_the_retry()
+{
+    Uplink uplink(transport, CONFIG);
+    addLine(uplink, "m a=1i");
+    transport.result = UPLINK_WRITE_RETRY;
+    TEST_ASSERT_EQUAL_INT(UPLINK_FLUSH_FAILED, uplink.flush(true));
+    uplink.clear();
+    TEST_ASSERT_FALSE(uplink.retrying());
+    TEST_ASSERT_EQUAL_UINT16(0, uplink.points());
+    TEST_ASSERT_EQUAL_STRING("", uplink.lines());
+}
+
+void test_request_time_statistics()
+{
+    Uplink uplink(transport, CONFIG);
+    transport.request_ms = 300;
+    addLine(uplink, "m a=1i");
+    uplink.flush(true);
+    transport.request_ms = 100;
+    addLine(uplink, "m a=1i");
+    uplink.flush(true);
+    TEST_ASSERT_EQUAL_UINT32(100, uplink.stats().last_request_ms);
+    TEST_ASSERT_EQUAL_UINT32(300, uplink.stats().max_request_ms);
+    TEST_ASSERT_EQUAL_UINT32(200, uplink.averageRequestMs());
+    TEST_ASSERT_EQUAL_FLOAT(1.0f, uplink.pointsPerRequest());
+}
+
+// Adding a typical 1.2 KB sample line to a 16 KB batch, with a flush per 10
+void test_benchmark()
+{
+    static BatchUplink<FakeTransport, 16384> uplink(transport, {10, 60000, 5000, 20000});
+    transport.keep_body = false;
+    char line[1200];
+    memset(line, 'x', sizeof(line));
+    reportBenchmark("add + flush, 1200-byte lines", nsPerCall([&] {
+                        bool added = uplink.add(line, sizeof(line));
+                        uplink.flush();
+                        return added;
+                    }, 100000),
+                    sizeof(line));
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_flushes_when_max_points_are_buffered);
+    RUN_TEST(test_flushes_when_the_oldest_line_is_old_enough);
+    RUN_TEST(test_flushes_when_three_quarters_full);
+    RUN_TEST(test_force_sends_a_partial_batch);
+    RUN_TEST(test_failed_batch_is_retried_with_backoff);
+    RUN_TEST(test_rejected_batch_is_dropped);
+    RUN_TEST(test_full_buffer_refuses_lines);
+    RUN_TEST(test_reserve_and_commit_write_in_place);
+    RUN_TEST(test_clear_drops_the_batch_and_the_retry);
+    RUN_TEST(test_request_time_statistics);
+    RUN_TEST(test_benchmark);
+    return UNITY_END();
+}
@@ -0,0 +1,224 @@
+#include <stdio.h>
+#include <vector>
+#include <unity.h>
+#include <zlib.h>
+#include "GzipCompressor.h"
+#include "LineProtocolWriter.h"
+#include "../BenchTimer.h"
+
+static GzipCompressor compressor;
+static uint8_t out[80000];
+static uint8_t input[GzipCompressor::MAX_INPUT_SIZE + 1];
+static uint32_t rngState;
+
+static uint8_t randomByte()
+{
+    rngState = rngState * 1664525u + 1013904223u;
+    return (uint8_t)(rngState >> 24);
+}
+
+// Inflates with zlib, which also checks the gzip header, CRC-32 and length
+static bool inflateGzip(const uint8_t *gz, size_t len, std::vector<uint8_t> &result)
+{
+    z_stream stream = {};
+    if (inflateInit2(&stream, 16 + MAX_WBITS) != Z_OK)
+        return false;
+    result.assign(GzipCompressor::MAX_INPUT_SIZE + 1024, 0);
+    stream.next_in = const_cast<uint8_t *>(gz);
+    stream.avail_in = (uInt)len;
+    stream.next_out = result.data();
+    stream.avail_out = (uInt)result.size();
+    int status = inflate(&stream, Z_FINISH);
+    result.resize(stream.total_out);
+    bool complete = status == Z_STREAM_END && stream.avail_in == 0;
+    inflateEnd(&stream);
+    return complete;
+}
+
+// Compresses and inflates len bytes of input; returns the gzip size
+static size_t roundTrip(size_t len)
+{
+    size_t gzLen = compressor.compress(input, len, out, sizeof(out));
+    TEST_ASSERT_GREATER_THAN(0u, gzLen);
+    std::vector<uint8_t> restored;
+    TEST_ASSERT_TRUE(inflateGzip(out, gzLen, restored));
+    TEST_ASSERT_EQUAL_size_t(len, restored.size());
+    if (len > 0)
+        TEST_ASSERT_EQUAL_MEMORY(input, restored.data(), len);
+    return gzLen;
+}
+
+void setUp() { rngState = 17; }
+void tearDown() {}
+
+void test_empty_input()
+{
+    size_t gzLen = roundTrip(0);
+    TEST_ASSERT_EQUAL_size_t(GzipCompressor::HEADER_SIZE + 2 + GzipCompressor::TRAILER_SIZE, gzLen);
+}
+
+void test_random_bytes()
+{
+    for (size_t i = 0; i < 5000; i++)
+        input[i] = randomByte();
+    roundTrip(1);
+    roundTrip(2);
+    roundTrip(3);
+    roundTrip(5000);
+}
+
+// The largest input, text with many matches; one byte more is refused
+void test_max_input()
+{
+    const char text[] = "opcn3,device=a opc_pm1=1.25,opc_pm2_5=3.5,opc_pm10=7.75 1700000000\n";
+    for (size_t i = 0; i < GzipCompressor::MAX_INPUT_SIZE; i++)
+        input[i] = i % 997 == 0 ? randomByte() : (uint8_t)text[i % (sizeof(text) - 1)];
+    TEST_ASSERT_LESS_THAN(GzipCompressor::MAX_INPUT_SIZE / 10, roundTrip(GzipCompressor::MAX_INPUT_SIZE));
+    for (size_t i = 0; i < GzipCompressor::MAX_INPUT_SIZE; i++)
+        input[i] = randomByte();
+    roundTrip(GzipCompressor::MAX_INPUT_SIZE);
+    TEST_ASSERT_EQUAL_size_t(0, compressor.compress(input, GzipCompressor::MAX_INPUT_SIZE + 1, out, sizeof(out)));
+}
+
+// Runs of one byte are matches at distance 1 of the longest length, 258,
+// plus a remainder around the edges of the length codes
+void test_longest_matches()
+{
+    for (size_t len = 250; len <= 3 * 258 + 4; len++)
+    {
+        memset(input, 'x', len);
+        roundTrip(len);
+    }
+    memset(input, 'x', 10000);
+    // 39 matches of 258 bytes, each a 7-bit code with no extra bits and a
+    // 5-bit distance
+    TEST_ASSERT_LESS_THAN(GzipCompressor::HEADER_SIZE + 80 + GzipCompressor::TRAILER_SIZE, roundTrip(10000));
+}
+
+// A 300-byte block repeated gap bytes later, with a run of 'a' in between
+static size_t repeatAfter(size_t gap)
+{
+    for (size_t i = 0; i < 300; i++)
+        input[i] = randomByte() | 0x80;
+    memset(input + 300, 'a', gap - 300);
+    memcpy(input + gap, input, 300);
+    return roundTrip(gap + 300);
+}
+
+// 32768 is the largest distance deflate can express: the repeat at that
+// distance is found, one byte further it is sent as literals
+void test_distances_near_the_window_size()
+{
+    size_t at_32767 = repeatAfter(32767);
+    rngState = 17;
+    size_t at_32768 = repeatAfter(32768);
+    rngState = 17;
+    size_t at_32769 = repeatAfter(32769);
+    TEST_ASSERT_INT_WITHIN(2, at_32767, at_32768);
+    TEST_ASSERT_GREATER_THAN(at_32768 + 250, at_32769);
+}
+
+// Returns 0 rather than overrunning an output buffer that is too small
+void test_output_too_small()
+{
+    for (size_t i = 0; i < 2000; i++)
+        input[i] = randomByte();
+    size_t gzLen = compressor.compress(input, 2000, out, sizeof(out));
+    TEST_ASSERT_GREATER_THAN(2000u, gzLen);
+
+    memset(out, 0x5A, sizeof(out));
+    TEST_ASSERT_EQUAL_size_t(0, compressor.compress(input, 2000, out, 2000));
+    TEST_ASSERT_EQUAL_size_t(0, compressor.compress(input, 2000, out, gzLen - 1));
+    TEST_ASSERT_EQUAL_UINT8(0x5A, out[gzLen - 1]);
+    TEST_ASSERT_EQUAL_size_t(gzLen, compressor.compress(input, 2000, out, gzLen));
+    TEST_ASSERT_EQUAL_size_t(0, compressor.compress(input, 0, out, GzipCompressor::HEADER_SIZE + 9));
+}
+
+void test_crc32()
+{
+    const char text[] = "123456789";
+    TEST_ASSERT_EQUAL_HEX32(0xCBF43926, GzipCompressor::crc32((const uint8_t *)text, 9));
+    for (size_t i = 0; i < 1000; i++)
+        input[i] = randomByte();
+    TEST_ASSERT_EQUAL_HEX32(crc32(0, input, 1000), GzipCompressor::crc32(input, 1000));
+}
+
+// A batch of full-sample lines as the firmware writes them: PM, climate,
+// weather and the 24 bin counts, values drifting from line to line
+static size_t buildBatch(int lines, char *body, size_t size)
+{
+    static const char *const WEATHER[8] = {"weather_temperature", "weather_humidity", "weather_pressure_msl",
+                                           "weather_wind_speed_kmh", "air_pm2_5", "air_pm10", "air_dust",
+                                           "air_european_aqi"};
+    float pm = 8.0f;
+    size_t used = 0;
+    for (int line = 0; line < lines; line++)
+    {
+        pm += (randomByte() - 128) / 256.0f;
+        LineProtocolWriter writer(body + used, size - used);
+        writer.measurement("opcn3,device=esp32-3c71bf,ssid=home");
+        writer.field("opc_pm1", pm * 0.4f);
+        writer.field("opc_pm2_5", pm);
+        writer.field("opc_pm10", pm * 1.7f);
+        writer.field("opc_temperature", 21.5f + line * 0.01f);
+        writer.field("opc_humidity", 45.0f - line * 0.02f);
+        writer.field("scd41_co2", (uint32_t)(620 + randomByte() % 16));
+        writer.field("scd41_temperature", 21.8f + line * 0.01f);
+        writer.field("scd41_humidity", 44.1f - line * 0.02f);
+        for (int i = 0; i < 8; i++)
+            writer.field(WEATHER[i], 10.0f + i * 3.3f);
+        for (int i = 0; i < 24; i++)
+        {
+            char name[12];
+            snprintf(name, sizeof(name), "opc_bin_%02d", i);
+            writer.field(name, (uint32_t)((pm * 40.0f) / (1 + i * i) + randomByte() % 4));
+        }
+        writer.timestamp(1700000000ull + 10 * line);
+        if (!writer.ok())
+            break;
+        used += writer.length();
+    }
+    return used;
+}
+
+void test_benchmark()
+{
+    static char body[GzipCompressor::MAX_INPUT_SIZE + 1];
+    static const int BATCH_LINES[3] = {1, 10, 60};
+    for (int lines : BATCH_LINES)
+    {
+        size_t len = buildBatch(lines, body, sizeof(body));
+        size_t gzLen = compressor.compress((const uint8_t *)body, len, out, sizeof(out));
+        std::vector<uint8_t> restored;
+        TEST_ASSERT_TRUE(inflateGzip(out, gzLen, restored));
+        TEST_ASSERT_EQUAL_MEMORY(body, restored.data(), len);
+
+        // zlib's default level on the same body, for reference
+        uLongf zlibLen = sizeof(out);
+        compress2(out, &zlibLen, (const Bytef *)body, len, Z_DEFAULT_COMPRESSION);
+
+        char message[160];
+        snprintf(message, sizeof(message), "%d lines: %zu -> %zu bytes, ratio %.2f (zlib -6: %.2f)", lines, len,
+                 gzLen, (double)len / gzLen, (double)len / zlibLen);
+        TEST_MESSAGE(message);
+        char name[48];
+        snprintf(name, sizeof(name), "compress, %d-line batch", lines);
+        reportBenchmark(name, nsPerCall([&] { return compressor.compress((const uint8_t *)body, len, out, sizeof(out)); },
+                                        lines == 60 ? 200 : 2000),
+                        len);
+    }
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_empty_input);
+    RUN_TEST(test_random_bytes);
+    RUN_TEST(test_max_input);
+    RUN_TEST(test_longest_matches);
+    RUN_TEST(test_distances_near_the_window_size);
+    RUN_TEST(test_output_too_small);
+    RUN_TEST(test_crc32);
+    RUN_TEST(test_benchmark);
+    return UNITY_END();
+}
@@ -0,0 +1,245 @@
+#include <unity.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "JournalFileStorage.h"
+#include "../BenchTimer.h"
+
+// Four segments of four 100-byte records each (105 bytes with the header)
+typedef SampleJournal<JournalFileStorage, 4> Journal;
+static const size_t SEGMENT_BYTES = 512;
+static const uint16_t PAYLOAD_SIZE = 100;
+
+static char dir[32];
+
+static void removeEntry(const char *name, void *context)
+{
+    (void)context;
+    char path[320];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    if (name[0] != '.')
+        ::remove(path);
+}
+
+void setUp()
+{
+    strcpy(dir, "/tmp/journal_XXXXXX");
+    TEST_ASSERT_NOT_NULL(mkdtemp(dir));
+}
+
+void tearDown()
+{
+    JournalFileStorage().list(dir, removeEntry, nullptr);
+    rmdir(dir);
+}
+
+static void appendRecords(Journal &journal, int count, int first)
+{
+    uint8_t payload[PAYLOAD_SIZE];
+    for (int i = 0; i < count; i++)
+    {
+        memset(payload, (uint8_t)(first + i), sizeof(payload));
+        TEST_ASSERT_TRUE(journal.append(payload, sizeof(payload)));
+    }
+}
+
+// Reads up to max records from the read cursor, checking that they continue
+// at first; returns the count and the cursor behind the last one
+static int readRecords(Journal &journal, int first, JournalCursor &cursor, int max = 1000)
+{
+    cursor = journal.readCursor();
+    uint8_t payload[PAYLOAD_SIZE * 2];
+    uint16_t len = 0;
+    int count = 0;
+    while (count < max && journal.next(cursor, payload, sizeof(payload), len))
+    {
+        TEST_ASSERT_EQUAL_UINT16(PAYLOAD_SIZE, len);
+        TEST_ASSERT_EQUAL_UINT8((uint8_t)(first + count), payload[0]);
+        TEST_ASSERT_EQUAL_UINT8((uint8_t)(first + count), payload[PAYLOAD_SIZE - 1]);
+        count++;
+    }
+    return count;
+}
+
+static size_t countSegments()
+{
+    size_t count = 0;
+    char path[JOURNAL_PATH_SIZE];
+    for (uint32_t segment = 0; segment < 64; segment++)
+    {
+        snprintf(path, sizeof(path), "%s/%08lx.jnl", dir, (unsigned long)segment);
+        if (JournalFileStorage().exists(path))
+            count++;
+    }
+    return count;
+}
+
+void test_append_replay_commit()
+{
+    Journal journal(JournalFileStorage(), dir, SEGMENT_BYTES);
+    TEST_ASSERT_TRUE(journal.begin());
+    TEST_ASSERT_TRUE(journal.empty());
+    appendRecords(journal, 10, 0);
+    TEST_ASSERT_EQUAL_UINT32(10, journal.pending());
+    TEST_ASSERT_EQUAL_size_t(3, journal.segmentCount());
+
+    JournalCursor cursor;
+    TEST_ASSERT_EQUAL_INT(6, readRecords(journal, 0, cursor, 6));
+    TEST_ASSERT_TRUE(journal.commit(cursor));
+    TEST_ASSERT_EQUAL_UINT32(4, journal.pending());
+    TEST_ASSERT_EQUAL_size_t(2, countSegments()); // The first segment was deleted
+    TEST_ASSERT_EQUAL_INT(4, readRecords(journal, 6, cursor));
+    TEST_ASSERT_TRUE(journal.commit(cursor));
+    TEST_ASSERT_TRUE(journal.empty());
+    TEST_ASSERT_EQUAL_UINT32(10, journal.stats().replayed);
+}
+
+void test_uncommitted_records_are_replayed_again()
+{
+    Journal journal(JournalFileStorage(), dir, SEGMENT_BYTES);
+    TEST_ASSERT_TRUE(journal.begin());
+    appendRecords(journal, 5, 0);
+    JournalCursor cursor;
+    TEST_ASSERT_EQUAL_INT(5, readRecords(journal, 0, cursor));
+    TEST_ASSERT_EQUAL_UINT32(5, journal.pending());
+    TEST_ASSERT_EQUAL_INT(5, readRecords(journal, 0, cursor));
+}
+
+void test_state_survives_a_restart()
+{
+    {
+        Journal journal(JournalFileStorage(), dir, SEGMENT_BYTES);
+        TEST_ASSERT_TRUE(journal.begin());
+        appendRecords(journal, 7, 0);
+        JournalCursor cursor;
+        TEST_ASSERT_EQUAL_INT(2, readRecords(journal, 0, cursor, 2));
+        TEST_ASSERT_TRUE(journal.commit(cursor));
+    }
+    Journal journal(JournalFileStorage(), dir, SEGMENT_BYTES);
+    TEST_ASSERT_TRUE(journal.begin());
+    TEST_ASSERT_EQUAL_UINT32(5, journal.pending());
+    appendRecords(journal, 1, 7);
+    JournalCursor cursor;
+    TEST_ASSERT_EQUAL_INT(6, readRecords(journal, 2, cursor));
+}
+
+void test_full_journal_evicts_the_oldest_segment()
+{
+    Journal journal(JournalFileStorage(), dir, SEGMENT_BYTES);
+    TEST_ASSERT_TRUE(journal.begin());
+    appendRecords(journal, 20, 0);
+    TEST_ASSERT_EQUAL_size_t(4, journal.segmentCount());
+    TEST_ASSERT_EQUAL_size_t(4, countSegments());
+    TEST_ASSERT_EQUAL_UINT32(1, journal.stats().evicted_segments);
+    TEST_ASSERT_EQUAL_UINT32(4, journal.stats().evicted_records);
+    TEST_ASSERT_EQUAL_UINT32(16, journal.pending());
+    JournalCursor cursor;
+    TEST_ASSERT_EQUAL_INT(16, readRecords(journal, 4, cursor));
+}
+
+void test_torn_record_ends_its_segment()
+{
+    {
+        Journal journal(JournalFileStorage(), dir, SEGMENT_BYTES);
+        TEST_ASSERT_TRUE(journal.begin());
+        appendRecords(journal, 3, 0);
+    }
+    // A power loss in the middle of the fourth record
+    char path[JOURNAL_PATH_SIZE];
+    snprintf(path, sizeof(path), "%s/%08lx.jnl", dir, 0ul);
+    const uint8_t torn[] = {JOURNAL_RECORD_MAGIC, PAYLOAD_SIZE, 0, 0x12, 0x34, 3, 3, 3};
+    TEST_ASSERT_TRUE(JournalFileStorage().append(path, torn, sizeof(torn)));
+
+    Journal journal(JournalFileStorage(), dir, SEGMENT_BYTES);
+    TEST_ASSERT_TRUE(journal.begin());
+    TEST_ASSERT_EQUAL_UINT32(3, journal.pending());
+    TEST_ASSERT_EQUAL_UINT32(1, journal.stats().corrupt_segments);
+    appendRecords(journal, 2, 3);
+    TEST_ASSERT_EQUAL_size_t(2, journal.segmentCount());
+    JournalCursor cursor;
+    TEST_ASSERT_EQUAL_INT(5, readRecords(journal, 0, cursor));
+    TEST_ASSERT_TRUE(journal.commit(cursor));
+    TEST_ASSERT_TRUE(journal.empty());
+}
+
+// A power loss after the cursor was saved but before the sent segments were
+// deleted leaves them behind the cursor
+void test_begin_deletes_segments_behind_the_cursor()
+{
+    {
+        Journal journal(JournalFileStorage(), dir, SEGMENT_BYTES);
+        TEST_ASSERT_TRUE(journal.begin());
+        appendRecords(journal, 6, 0);
+        JournalCursor cursor;
+        TEST_ASSERT_EQUAL_INT(5, readRecords(journal, 0, cursor, 5));
+        TEST_ASSERT_TRUE(journal.commit(cursor));
+    }
+    // Put the deleted first segment back
+    char from[JOURNAL_PATH_SIZE], to[JOURNAL_PATH_SIZE];
+    snprintf(from, sizeof(from), "%s/%08lx.jnl", dir, 1ul);
+    snprintf(to, sizeof(to), "%s/%08lx.jnl", dir, 0ul);
+    uint8_t bytes[SEGMENT_BYTES];
+    size_t size = JournalFileStorage().read(from, 0, bytes, sizeof(bytes));
+    TEST_ASSERT_TRUE(JournalFileStorage().replace(to, bytes, size));
+
+    Journal journal(JournalFileStorage(), dir, SEGMENT_BYTES);
+    TEST_ASSERT_TRUE(journal.begin());
+    TEST_ASSERT_FALSE(JournalFileStorage().exists(to));
+    TEST_ASSERT_EQUAL_UINT32(1, journal.pending());
+    JournalCursor cursor;
+    TEST_ASSERT_EQUAL_INT(1, readRecords(journal, 5, cursor));
+}
+
+// Without a usable cursor the journal resumes at the lowest segment
+void test_begin_without_cursor_starts_at_the_lowest_segment()
+{
+    {
+        Journal journal(JournalFileStorage(), dir, SEGMENT_BYTES);
+        TEST_ASSERT_TRUE(journal.begin());
+        appendRecords(journal, 12, 0);
+    }
+    char path[JOURNAL_PATH_SIZE];
+    snprintf(path, sizeof(path), "%s/%08lx.jnl", dir, 0ul);
+    TEST_ASSERT_TRUE(JournalFileStorage().remove(path));
+    snprintf(path, sizeof(path), "%s/cursor", dir);
+    JournalFileStorage().remove(path);
+
+    Journal journal(JournalFileStorage(), dir, SEGMENT_BYTES);
+    TEST_ASSERT_TRUE(journal.begin());
+    TEST_ASSERT_EQUAL_UINT32(1, journal.readCursor().segment);
+    TEST_ASSERT_EQUAL_UINT32(8, journal.pending());
+    JournalCursor cursor;
+    TEST_ASSERT_EQUAL_INT(8, readRecords(journal, 4, cursor));
+}
+
+// File-backed append and replay cost per record on the host filesystem
+void test_benchmark()
+{
+    typedef SampleJournal<JournalFileStorage, 8> BenchJournal;
+    BenchJournal journal(JournalFileStorage(), dir, 16384);
+    TEST_ASSERT_TRUE(journal.begin());
+    uint8_t payload[155];
+    memset(payload, 0x5A, sizeof(payload));
+    reportBenchmark("append, 155 bytes", nsPerCall([&] { return journal.append(payload, sizeof(payload)); }, 500),
+                    sizeof(payload));
+
+    JournalCursor cursor = journal.readCursor();
+    uint16_t len = 0;
+    reportBenchmark("next, 155 bytes",
+                    nsPerCall([&] { return journal.next(cursor, payload, sizeof(payload), len); }, 500),
+                    sizeof(payload));
+    TEST_ASSERT_TRUE(journal.commit(cursor));
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_append_replay_commit);
+    RUN_TEST(test_uncommitted_records_are_replayed_again);
+    RUN_TEST(test_state_survives_a_restart);
+    RUN_TEST(test_full_journal_evicts_the_oldest_segment);
+    RUN_TEST(test_torn_record_ends_its_segment);
+    RUN_TEST(test_begin_deletes_segments_behind_the_cursor);
+    RUN_TEST(test_begin_without_cursor_starts_at_the_lowest_segment);
+    RUN_TEST(test_benchmark);
+    return UNITY_END();
+}
@@ -0,0 +1,173 @@
+#include <unity.h>
+#include <stdio.h>
+#include "LineProtocolWriter.h"
+#include "../BenchTimer.h"
+
+static char buffer[256];
+
+void setUp() { memset(buffer, 0x7E, sizeof(buffer)); }
+void tearDown() {}
+
+static const char *floatField(float value, uint8_t decimals = 2)
+{
+    LineProtocolWriter line(buffer, sizeof(buffer));
+    line.measurement("m");
+    line.field("f", value, decimals);
+    return buffer;
+}
+
+void test_line_layout()
+{
+    LineProtocolWriter line(buffer, sizeof(buffer));
+    line.measurement("full");
+    line.tag("device", "ESP32");
+    line.field("opc_pm1", 3.5f);
+    line.field("scd41_co2", 812);
+    line.field("day", true);
+    line.timestamp(1760000000);
+    TEST_ASSERT_TRUE(line.ok());
+    TEST_ASSERT_EQUAL_STRING("full,device=ESP32 opc_pm1=3.50,scd41_co2=812i,day=true 1760000000", line.c_str());
+    TEST_ASSERT_EQUAL_size_t(strlen(buffer), line.length());
+    TEST_ASSERT_EQUAL_UINT16(3, line.fieldCount());
+}
+
+void test_integers()
+{
+    LineProtocolWriter line(buffer, sizeof(buffer));
+    line.measurement("m");
+    line.field("a", -42);
+    line.field("b", (long long)INT64_MIN);
+    line.field("c", (unsigned long long)UINT64_MAX);
+    line.field("d", (unsigned char)0);
+    TEST_ASSERT_EQUAL_STRING("m a=-42i,b=-9223372036854775808i,c=18446744073709551615i,d=0i", buffer);
+}
+
+void test_float_rounding()
+{
+    TEST_ASSERT_EQUAL_STRING("m f=0.13", floatField(0.125f));  // Half rounds up
+    TEST_ASSERT_EQUAL_STRING("m f=-0.13", floatField(-0.125f));
+    TEST_ASSERT_EQUAL_STRING("m f=1.00", floatField(1.005f));  // 1.00499...
+    TEST_ASSERT_EQUAL_STRING("m f=1000.00", floatField(999.999f));
+    TEST_ASSERT_EQUAL_STRING("m f=0.00", floatField(-0.004f)); // No "-0.00"
+    TEST_ASSERT_EQUAL_STRING("m f=0.00", floatField(-0.0f));
+    TEST_ASSERT_EQUAL_STRING("m f=12", floatField(12.4f, 0));
+    TEST_ASSERT_EQUAL_STRING("m f=0.1235", floatField(0.12345f, 4));
+    TEST_ASSERT_EQUAL_STRING("m f=0.000001", floatField(1e-6f, 6));
+    TEST_ASSERT_EQUAL_STRING("m f=0.000001", floatField(1e-6f, 9)); // At most 6 decimals
+    TEST_ASSERT_EQUAL_STRING("m f=16777216.00", floatField(16777216.0f));
+}
+
+// Random values against snprintf of the value rounded in double
+void test_float_matches_printf()
+{
+    uint32_t seed = 12345;
+    char expected[96];
+    for (int i = 0; i < 100000; i++)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        float value = ((int32_t)seed % 2000000) / 997.0f;
+        int decimals = i % 5;
+        double scaled = floor(fabs((double)value) * pow(10, decimals) + 0.5) / pow(10, decimals);
+        snprintf(expected, sizeof(expected), "m f=%s%.*f", value < 0 && scaled > 0 ? "-" : "", decimals, scaled);
+        TEST_ASSERT_EQUAL_STRING(expected, floatField(value, (uint8_t)decimals));
+    }
+}
+
+void test_non_finite_floats_are_skipped()
+{
+    LineProtocolWriter line(buffer, sizeof(buffer));
+    line.measurement("m");
+    line.field("a", NAN);
+    line.field("b", INFINITY);
+    line.field("c", 1.0f);
+    TEST_ASSERT_EQUAL_STRING("m c=1.00", buffer);
+    TEST_ASSERT_EQUAL_UINT16(1, line.fieldCount());
+}
+
+// The clamp applies to the scaled value, so it is printed in field units
+void test_huge_floats_are_clamped()
+{
+    TEST_ASSERT_EQUAL_STRING("m f=180000000000000000.00", floatField(1e30f));
+    TEST_ASSERT_EQUAL_STRING("m f=-180000000000000000.00", floatField(-3e38f));
+    TEST_ASSERT_EQUAL_STRING("m f=180000000000000000.00", floatField(1e18f));
+    TEST_ASSERT_EQUAL_STRING("m f=99999998430674944.00", floatField(1e17f));
+    TEST_ASSERT_EQUAL_STRING("m f=99999998430674944", floatField(1e17f, 0));
+    TEST_ASSERT_EQUAL_STRING("m f=18000000000000.000000", floatField(1e17f, 6));
+    TEST_ASSERT_EQUAL_STRING("m f=18000000000000000000", floatField(1e30f, 0));
+}
+
+void test_tag_escaping()
+{
+    LineProtocolWriter line(buffer, sizeof(buffer));
+    line.measurement("m");
+    line.tag("wifi", "My Net,x=1");
+    TEST_ASSERT_EQUAL_STRING("m,wifi=My\\ Net\\,x\\=1", buffer);
+
+    char escaped[8];
+    TEST_ASSERT_TRUE(LineProtocolWriter::escapeTag("a b", escaped, sizeof(escaped)));
+    TEST_ASSERT_EQUAL_STRING("a\\ b", escaped);
+    TEST_ASSERT_FALSE(LineProtocolWriter::escapeTag("a,b,c,d", escaped, sizeof(escaped)));
+}
+
+void test_multiple_lines()
+{
+    LineProtocolWriter line(buffer, sizeof(buffer));
+    line.measurement("a");
+    line.field("x", 1);
+    line.measurement("b");
+    line.field("y", 2);
+    TEST_ASSERT_EQUAL_STRING("a x=1i\nb y=2i", buffer);
+    TEST_ASSERT_EQUAL_UINT16(1, line.fieldCount());
+}
+
+void test_overflow_stays_in_the_buffer()
+{
+    LineProtocolWriter line(buffer, 16);
+    line.measurement("measurement");
+    line.field("value", 123.25f);
+    TEST_ASSERT_FALSE(line.ok());
+    TEST_ASSERT_LESS_THAN(16u, line.length());
+    TEST_ASSERT_EQUAL_size_t(strlen(buffer), line.length());
+    TEST_ASSERT_EQUAL_HEX8(0x7E, (uint8_t)buffer[16]);
+}
+
+// A line of 60 float fields, the size of a full sample, against snprintf
+void test_benchmark()
+{
+    static const char *const KEYS[6] = {"opc_pm1", "opc_pm2_5", "opc_pm10", "opc_temperature", "opc_humidity",
+                                        "calc_pm2_5"};
+    float values[60];
+    for (int i = 0; i < 60; i++)
+        values[i] = i * 13.37f - 100.0f;
+
+    reportBenchmark("writer, 60 float fields", nsPerCall([&] {
+                        LineProtocolWriter line(buffer, sizeof(buffer) - 1);
+                        line.measurement("full,device=ESP32");
+                        for (int i = 0; i < 60; i++)
+                            line.field(KEYS[i % 6], values[i]);
+                        return line.length();
+                    }, 20000));
+    reportBenchmark("snprintf, 60 float fields", nsPerCall([&] {
+                        size_t pos = (size_t)snprintf(buffer, sizeof(buffer), "full,device=ESP32");
+                        for (int i = 0; i < 60 && pos < sizeof(buffer); i++)
+                            pos += (size_t)snprintf(buffer + pos, sizeof(buffer) - pos, "%c%s=%.2f", i ? ',' : ' ',
+                                                    KEYS[i % 6], (double)values[i]);
+                        return pos;
+                    }, 20000));
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_line_layout);
+    RUN_TEST(test_integers);
+    RUN_TEST(test_float_rounding);
+    RUN_TEST(test_float_matches_printf);
+    RUN_TEST(test_non_finite_floats_are_skipped);
+    RUN_TEST(test_huge_floats_are_clamped);
+    RUN_TEST(test_tag_escaping);
+    RUN_TEST(test_multiple_lines);
+    RUN_TEST(test_overflow_stays_in_the_buffer);
+    RUN_TEST(test_benchmark);
+    return UNITY_END();
+}
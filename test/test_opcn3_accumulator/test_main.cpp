@@ -0,0 +1,147 @@
+#include <unity.h>
+#include "OpcN3Accumulator.h"
+
+// A histogram with count in every bin, read over period_s at flow_ml_s
+static OpcN3Data histogram(uint16_t count, float flow_ml_s, float period_s)
+{
+    OpcN3Data data = {};
+    for (int i = 0; i < OpcN3Accumulator::BIN_COUNT; i++)
+        data.bin_counts[i] = (uint16_t)(count * (i + 1));
+    data.sample_flow_rate_ml_s = flow_ml_s;
+    data.sampling_period_s = period_s;
+    return data;
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_empty()
+{
+    OpcN3Accumulator acc;
+    TEST_ASSERT_EQUAL_UINT32(0, acc.samples());
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, acc.sampledVolumeMl());
+    TEST_ASSERT_FLOAT_IS_NAN(acc.concentration(0));
+    TEST_ASSERT_FLOAT_IS_NAN(acc.concentration(0, 23));
+    float out[OpcN3Accumulator::BIN_COUNT];
+    acc.concentrations(out);
+    TEST_ASSERT_FLOAT_IS_NAN(out[5]);
+}
+
+// The same air read with different flow rates and periods has the same
+// concentration, though the raw counts differ
+void test_concentration_is_independent_of_flow_and_period()
+{
+    // 2 particles/mL in bin 0: 5.5 mL/s x 1 s, 4 mL/s x 2.5 s, 1 mL/s x 10 s
+    OpcN3Accumulator fast, slow, mixed;
+    fast.add(histogram(11, 5.5f, 1.0f));
+    slow.add(histogram(20, 4.0f, 2.5f));
+    mixed.add(histogram(11, 5.5f, 1.0f));
+    mixed.add(histogram(20, 4.0f, 2.5f));
+    mixed.add(histogram(20, 1.0f, 10.0f));
+
+    TEST_ASSERT_EQUAL_FLOAT(2.0f, fast.concentration(0));
+    TEST_ASSERT_EQUAL_FLOAT(2.0f, slow.concentration(0));
+    TEST_ASSERT_EQUAL_FLOAT(2.0f, mixed.concentration(0));
+    TEST_ASSERT_EQUAL_FLOAT(2.0f * 24, mixed.concentration(23));
+    TEST_ASSERT_EQUAL_FLOAT(2.0f * 300, mixed.concentration(0, 23));
+
+    TEST_ASSERT_EQUAL_UINT32(3, mixed.samples());
+    TEST_ASSERT_EQUAL_FLOAT(25.5f, mixed.sampledVolumeMl());
+    TEST_ASSERT_EQUAL_FLOAT(13.5f, mixed.sampledSeconds());
+    TEST_ASSERT_EQUAL_UINT32(51, mixed.count(0));
+    TEST_ASSERT_EQUAL_UINT32(51 * 3, mixed.count(0, 1));
+}
+
+// Concentration over a window is total count over total volume: a long
+// interval weighs more than a short one
+void test_window_is_volume_weighted()
+{
+    OpcN3Accumulator acc;
+    acc.add(histogram(10, 5.0f, 1.0f)); // 2/mL over 5 mL
+    acc.add(histogram(60, 5.0f, 3.0f)); // 4/mL over 15 mL
+    TEST_ASSERT_EQUAL_FLOAT(70.0f / 20.0f, acc.concentration(0));
+    float out[OpcN3Accumulator::BIN_COUNT];
+    acc.concentrations(out);
+    for (int i = 0; i < OpcN3Accumulator::BIN_COUNT; i++)
+        TEST_ASSERT_EQUAL_FLOAT(acc.concentration(i), out[i]);
+}
+
+void test_unusable_flow_or_period_is_rejected()
+{
+    OpcN3Accumulator acc;
+    TEST_ASSERT_FALSE(acc.add(histogram(10, 0.0f, 1.0f)));
+    TEST_ASSERT_FALSE(acc.add(histogram(10, -1.0f, 1.0f)));
+    TEST_ASSERT_FALSE(acc.add(histogram(10, 5.0f, 0.0f)));
+    TEST_ASSERT_FALSE(acc.add(histogram(10, NAN, 1.0f)));
+    TEST_ASSERT_FALSE(acc.add(histogram(10, 5.0f, NAN)));
+    TEST_ASSERT_FALSE(acc.add(histogram(10, 3e38f, 3e38f)));
+    TEST_ASSERT_EQUAL_UINT32(0, acc.samples());
+    TEST_ASSERT_EQUAL_UINT32(0, acc.count(0));
+    TEST_ASSERT_FLOAT_IS_NAN(acc.concentration(0));
+
+    TEST_ASSERT_TRUE(acc.add(histogram(10, 5.0f, 1.0f)));
+    TEST_ASSERT_EQUAL_FLOAT(2.0f, acc.concentration(0));
+}
+
+// Merging per-minute windows gives the same as adding every histogram to one
+void test_merge_matches_adding_everything()
+{
+    OpcN3Accumulator whole, minutes[3];
+    for (int m = 0; m < 3; m++)
+    {
+        for (int s = 0; s < 6; s++)
+        {
+            OpcN3Data data = histogram((uint16_t)(m * 7 + s), 4.5f + 0.1f * s, 10.0f);
+            TEST_ASSERT_TRUE(whole.add(data));
+            TEST_ASSERT_TRUE(minutes[m].add(data));
+        }
+    }
+    OpcN3Accumulator merged, empty;
+    merged.merge(empty);
+    for (int m = 0; m < 3; m++)
+        merged.merge(minutes[m]);
+    merged.merge(empty);
+
+    TEST_ASSERT_EQUAL_UINT32(whole.samples(), merged.samples());
+    TEST_ASSERT_EQUAL_FLOAT(whole.sampledVolumeMl(), merged.sampledVolumeMl());
+    TEST_ASSERT_EQUAL_FLOAT(whole.sampledSeconds(), merged.sampledSeconds());
+    for (int i = 0; i < OpcN3Accumulator::BIN_COUNT; i++)
+    {
+        TEST_ASSERT_EQUAL_UINT32(whole.count(i), merged.count(i));
+        TEST_ASSERT_EQUAL_FLOAT(whole.concentration(i), merged.concentration(i));
+    }
+}
+
+// Bin counts are 16 bits per histogram; the sums are not
+void test_counts_do_not_wrap()
+{
+    OpcN3Accumulator acc;
+    OpcN3Data data = histogram(0, 5.0f, 1.0f);
+    data.bin_counts[0] = 0xFFFF;
+    for (int i = 0; i < 100; i++)
+        acc.add(data);
+    TEST_ASSERT_EQUAL_UINT32(100u * 0xFFFF, acc.count(0));
+}
+
+void test_reset()
+{
+    OpcN3Accumulator acc;
+    acc.add(histogram(10, 5.0f, 1.0f));
+    acc.reset();
+    TEST_ASSERT_EQUAL_UINT32(0, acc.samples());
+    TEST_ASSERT_EQUAL_UINT32(0, acc.count(0, 23));
+    TEST_ASSERT_FLOAT_IS_NAN(acc.concentration(0));
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_empty);
+    RUN_TEST(test_concentration_is_independent_of_flow_and_period);
+    RUN_TEST(test_window_is_volume_weighted);
+    RUN_TEST(test_unusable_flow_or_period_is_rejected);
+    RUN_TEST(test_merge_matches_adding_everything);
+    RUN_TEST(test_counts_do_not_wrap);
+    RUN_TEST(test_reset);
+    return UNITY_END();
+}
@@ -0,0 +1,134 @@
+#include <unity.h>
+#include "OpcN3BusManager.h"
+#include "OpcN3SimBus.h"
+
+typedef OpcN3Driver<OpcN3SimBus> SimOpc;
+
+// Two simulated sensors on one bus and one clock
+static uint64_t clockUs;
+static SimOpc *a, *b;
+static OpcN3BusManager<OpcN3SimBus> *manager;
+
+void setUp()
+{
+    clockUs = 0;
+    a = new SimOpc(OpcN3SimBus());
+    b = new SimOpc(OpcN3SimBus());
+    a->bus().setSharedClock(&clockUs);
+    b->bus().setSharedClock(&clockUs);
+    a->bus().setReadyLatencyMs(30);
+    b->bus().setReadyLatencyMs(30);
+    manager = new OpcN3BusManager<OpcN3SimBus>();
+    TEST_ASSERT_EQUAL_INT(0, manager->addDevice(*a));
+    TEST_ASSERT_EQUAL_INT(1, manager->addDevice(*b));
+}
+
+void tearDown()
+{
+    delete manager;
+    delete a;
+    delete b;
+}
+
+// Runs service() in 1 ms steps for the given time
+static void run(unsigned long ms)
+{
+    for (unsigned long i = 0; i < ms; i++)
+    {
+        manager->service();
+        clockUs += 1000;
+    }
+}
+
+void test_begin_brings_up_both_devices_concurrently()
+{
+    uint64_t started = clockUs;
+    TEST_ASSERT_TRUE(manager->begin());
+    TEST_ASSERT_TRUE(manager->deviceReady(0));
+    TEST_ASSERT_TRUE(manager->deviceReady(1));
+    TEST_ASSERT_TRUE(a->bus().laserOn());
+    TEST_ASSERT_TRUE(b->bus().laserOn());
+
+    // The power-up and settle delays overlap instead of adding up
+    uint32_t one_device_ms = 0;
+    for (int step = 0; step < OpcN3Types::BOOT_STEP_COUNT; step++)
+        one_device_ms += a->bootStepMs((OpcN3Types::BootStep)step);
+    TEST_ASSERT_LESS_THAN(2 * one_device_ms, (uint32_t)((clockUs - started) / 1000));
+}
+
+// While A still answers busy, B's frame is received
+void test_fast_device_is_not_held_up_by_a_busy_one()
+{
+    TEST_ASSERT_TRUE(manager->begin());
+    a->bus().setReadyLatencyMs(300);
+    b->bus().setReadyLatencyMs(20);
+
+    OpcN3Data data;
+    unsigned long b_done_ms = 0;
+    for (int ms = 0; ms < 1000 && !b_done_ms; ms++)
+    {
+        run(1);
+        if (manager->takeData(1, data))
+            b_done_ms = (unsigned long)(clockUs / 1000);
+    }
+    TEST_ASSERT_NOT_EQUAL(0, b_done_ms);
+    TEST_ASSERT_FALSE(manager->takeData(0, data));
+    uint32_t a_busy = a->bus().busyReplies();
+    TEST_ASSERT_GREATER_THAN(0u, a_busy);
+
+    run(400);
+    TEST_ASSERT_TRUE(manager->takeData(0, data));
+    TEST_ASSERT_GREATER_THAN(a_busy, a->bus().busyReplies());
+    TEST_ASSERT_LESS_THAN(manager->stats(0).last_latency_ms, manager->stats(1).last_latency_ms);
+}
+
+// CRC errors on B count as failed reads of B only; the rates follow
+void test_crc_errors_count_per_device()
+{
+    TEST_ASSERT_TRUE(manager->begin());
+    manager->setReadIntervalMs(1000);
+    b->bus().setBitErrorRate(0.002f);
+    run(60000);
+
+    const OpcN3BusManager<OpcN3SimBus>::DeviceStats &sa = manager->stats(0), &sb = manager->stats(1);
+    TEST_ASSERT_EQUAL_UINT32(0, sa.reads_failed);
+    TEST_ASSERT_EQUAL_UINT32(0, manager->crcErrorCount(0));
+    TEST_ASSERT_GREATER_THAN(0u, sb.reads_failed);
+    TEST_ASSERT_EQUAL_UINT32(manager->crcErrorCount(1), sb.reads_failed);
+
+    // One read per second: about 60 per minute on A, fewer on B
+    float expected_a = sa.reads_ok * 60000.0f / (sa.last_ok_ms - sa.first_start_ms);
+    TEST_ASSERT_EQUAL_FLOAT(expected_a, manager->readsPerMinute(0));
+    TEST_ASSERT_FLOAT_WITHIN(1.5f, 60.0f, manager->readsPerMinute(0));
+    float expected_b = sb.reads_ok * 60000.0f / (sb.last_ok_ms - sb.first_start_ms);
+    TEST_ASSERT_EQUAL_FLOAT(expected_b, manager->readsPerMinute(1));
+    TEST_ASSERT_LESS_THAN(manager->readsPerMinute(0), manager->readsPerMinute(1));
+}
+
+// A sensor that never gets ready fails its initialization and is left alone
+void test_failed_device_is_skipped()
+{
+    a->bus().setReadyLatencyMs(5000);
+    TEST_ASSERT_FALSE(manager->begin());
+    TEST_ASSERT_FALSE(manager->deviceReady(0));
+    TEST_ASSERT_TRUE(manager->deviceReady(1));
+
+    uint32_t a_commands = a->bus().commandCount();
+    run(30000);
+    TEST_ASSERT_EQUAL_UINT32(a_commands, a->bus().commandCount());
+    TEST_ASSERT_EQUAL_UINT32(0, manager->stats(0).reads_ok + manager->stats(0).reads_failed);
+    TEST_ASSERT_FLOAT_WITHIN(3.0f, 60.0f, manager->readsPerMinute(1));
+    OpcN3Data data;
+    TEST_ASSERT_FALSE(manager->takeData(0, data));
+    TEST_ASSERT_TRUE(manager->takeData(1, data));
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_begin_brings_up_both_devices_concurrently);
+    RUN_TEST(test_fast_device_is_not_held_up_by_a_busy_one);
+    RUN_TEST(test_crc_errors_count_per_device);
+    RUN_TEST(test_failed_device_is_skipped);
+    return UNITY_END();
+}
@@ -0,0 +1,197 @@
+#include <unity.h>
+#include "OpcN3Codec.h"
+#include "../BenchTimer.h"
+
+static OpcN3Data sample(int step)
+{
+    OpcN3Data data;
+    memset(&data, 0, sizeof(data));
+    for (int i = 0; i < 24; i++)
+        data.bin_counts[i] = (uint16_t)((400 >> (i / 3)) + (step * 7 + i) % 5);
+    data.config_version = 1;
+    data.bin1_mtof = 20;
+    data.bin3_mtof = 24;
+    data.bin5_mtof = 28;
+    data.bin7_mtof = 31;
+    data.sampling_period_s = 1.0f + step * 0.01f;
+    data.sample_flow_rate_ml_s = 5.5f;
+    data.temperature_c = -3.25f + step * 0.1f;
+    data.humidity_rh = 45.67f;
+    data.pm_a = 3.5f;
+    data.pm_b = 6.25f + step * 0.01f;
+    data.pm_c = 11.0f;
+    data.reject_count_glitch = 2;
+    data.reject_count_long_tof = (uint16_t)step;
+    data.reject_count_ratio = 1;
+    data.fan_rev_count = 0;
+    data.laser_status = 600;
+    data.checksum_ok = true;
+    return data;
+}
+
+static void assertSameSample(const OpcN3Data &expected, const OpcN3Data &actual)
+{
+    TEST_ASSERT_EQUAL_MEMORY(expected.bin_counts, actual.bin_counts, sizeof(expected.bin_counts));
+    TEST_ASSERT_EQUAL_UINT16(expected.config_version, actual.config_version);
+    TEST_ASSERT_EQUAL_UINT8(expected.bin7_mtof, actual.bin7_mtof);
+    TEST_ASSERT_FLOAT_WITHIN(0.005f, expected.sampling_period_s, actual.sampling_period_s);
+    TEST_ASSERT_FLOAT_WITHIN(0.005f, expected.temperature_c, actual.temperature_c);
+    TEST_ASSERT_FLOAT_WITHIN(0.005f, expected.humidity_rh, actual.humidity_rh);
+    TEST_ASSERT_FLOAT_WITHIN(0.005f, expected.pm_b, actual.pm_b);
+    TEST_ASSERT_EQUAL_UINT16(expected.reject_count_long_tof, actual.reject_count_long_tof);
+    TEST_ASSERT_EQUAL_UINT16(expected.laser_status, actual.laser_status);
+    TEST_ASSERT_EQUAL(expected.checksum_ok, actual.checksum_ok);
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_zigzag_round_trip()
+{
+    const int32_t values[] = {0, 1, -1, 63, -64, 1000000, -1000000, INT32_MAX, INT32_MIN};
+    for (int32_t value : values)
+        TEST_ASSERT_EQUAL_INT32(value, opcn3_codec::unzigzag(opcn3_codec::zigzag(value)));
+    TEST_ASSERT_EQUAL_UINT32(1, opcn3_codec::zigzag(-1));
+    TEST_ASSERT_EQUAL_UINT32(2, opcn3_codec::zigzag(1));
+}
+
+void test_keyframe_round_trip()
+{
+    OpcN3RecordEncoder encoder(1);
+    OpcN3RecordDecoder decoder;
+    uint8_t record[opcn3_codec::MAX_RECORD_SIZE];
+    OpcN3Data in = sample(0), out;
+    size_t len = encoder.encode(in, record, sizeof(record));
+    TEST_ASSERT_GREATER_THAN(0u, len);
+    TEST_ASSERT_EQUAL_size_t(len, decoder.decode(record, len, out));
+    assertSameSample(in, out);
+    TEST_ASSERT_EQUAL_UINT16(0, out.received_checksum);
+}
+
+void test_delta_stream_round_trip()
+{
+    OpcN3RecordEncoder encoder(8);
+    OpcN3RecordDecoder decoder;
+    uint8_t record[opcn3_codec::MAX_RECORD_SIZE];
+    size_t keyframe = 0, delta = 0;
+    for (int step = 0; step < 20; step++)
+    {
+        OpcN3Data in = sample(step), out;
+        size_t len = encoder.encode(in, record, sizeof(record));
+        TEST_ASSERT_GREATER_THAN(0u, len);
+        bool isDelta = record[0] & opcn3_codec::FLAG_DELTA;
+        TEST_ASSERT_EQUAL(step % 8 != 0, isDelta);
+        if (step == 0)
+            keyframe = len;
+        else if (step == 1)
+            delta = len;
+        TEST_ASSERT_EQUAL_size_t(len, decoder.decode(record, len, out));
+        assertSameSample(in, out);
+    }
+    TEST_ASSERT_LESS_THAN(keyframe, delta);
+}
+
+void test_delta_needs_its_base_record()
+{
+    OpcN3RecordEncoder encoder(32);
+    uint8_t first[opcn3_codec::MAX_RECORD_SIZE], second[opcn3_codec::MAX_RECORD_SIZE];
+    uint8_t third[opcn3_codec::MAX_RECORD_SIZE];
+    size_t firstLen = encoder.encode(sample(0), first, sizeof(first));
+    size_t secondLen = encoder.encode(sample(1), second, sizeof(second));
+    size_t thirdLen = encoder.encode(sample(2), third, sizeof(third));
+
+    OpcN3Data out;
+    OpcN3RecordDecoder fresh;
+    TEST_ASSERT_EQUAL_size_t(0, fresh.decode(second, secondLen, out));
+
+    OpcN3RecordDecoder gap;
+    TEST_ASSERT_EQUAL_size_t(firstLen, gap.decode(first, firstLen, out));
+    TEST_ASSERT_EQUAL_size_t(0, gap.decode(third, thirdLen, out)); // Skipped the second record
+}
+
+void test_rejects_short_buffers_and_records()
+{
+    OpcN3RecordEncoder encoder(1);
+    uint8_t record[opcn3_codec::MAX_RECORD_SIZE];
+    TEST_ASSERT_EQUAL_size_t(0, encoder.encode(sample(0), record, 10));
+    size_t len = encoder.encode(sample(0), record, sizeof(record));
+
+    OpcN3Data out;
+    OpcN3RecordDecoder decoder;
+    TEST_ASSERT_EQUAL_size_t(0, decoder.decode(record, len - 1, out));
+    record[0] = (uint8_t)((record[0] & 0xF0) | (opcn3_codec::FORMAT_VERSION + 1));
+    TEST_ASSERT_EQUAL_size_t(0, decoder.decode(record, len, out));
+}
+
+void test_fixed_point_clamps_and_keeps_nan()
+{
+    using namespace opcn3_codec;
+    TEST_ASSERT_EQUAL_INT32(-325, toFixed(-3.25f));
+    TEST_ASSERT_EQUAL_INT32(FIXED_MAX, toFixed(1e9f));
+    TEST_ASSERT_EQUAL_INT32(-FIXED_MAX, toFixed(-1e9f));
+    TEST_ASSERT_EQUAL_INT32(FIXED_MAX, toFixed(INFINITY));
+    TEST_ASSERT_EQUAL_INT32(-FIXED_MAX, toFixed(-INFINITY));
+    TEST_ASSERT_EQUAL_INT32(FIXED_NAN, toFixed(NAN));
+    TEST_ASSERT_FLOAT_IS_NAN(fromFixed(toFixed(NAN)));
+    TEST_ASSERT_FLOAT_WITHIN(1.0f, FIXED_MAX / 100.0f, fromFixed(toFixed(1e12f)));
+}
+
+// Extreme values and NaN, also as deltas between each other
+void test_extreme_values_round_trip()
+{
+    OpcN3RecordEncoder encoder(4);
+    OpcN3RecordDecoder decoder;
+    uint8_t record[opcn3_codec::MAX_RECORD_SIZE];
+    const float values[] = {NAN, 1e12f, -1e12f, NAN, 12.5f, -INFINITY};
+    for (float value : values)
+    {
+        OpcN3Data in = sample(0), out;
+        in.temperature_c = value;
+        in.pm_c = value;
+        size_t len = encoder.encode(in, record, sizeof(record));
+        TEST_ASSERT_GREATER_THAN(0u, len);
+        TEST_ASSERT_LESS_OR_EQUAL(opcn3_codec::MAX_RECORD_SIZE, len);
+        TEST_ASSERT_EQUAL_size_t(len, decoder.decode(record, len, out));
+        if (isnan(value))
+        {
+            TEST_ASSERT_FLOAT_IS_NAN(out.temperature_c);
+            TEST_ASSERT_FLOAT_IS_NAN(out.pm_c);
+        }
+        else
+        {
+            float expected = opcn3_codec::fromFixed(opcn3_codec::toFixed(value));
+            TEST_ASSERT_EQUAL_FLOAT(expected, out.temperature_c);
+            TEST_ASSERT_EQUAL_FLOAT(expected, out.pm_c);
+        }
+        TEST_ASSERT_FLOAT_WITHIN(0.005f, 45.67f, out.humidity_rh);
+    }
+}
+
+void test_benchmark()
+{
+    uint8_t record[opcn3_codec::MAX_RECORD_SIZE];
+    OpcN3Data data = sample(3), out;
+
+    OpcN3RecordEncoder keyframes(1);
+    reportBenchmark("encode keyframe", nsPerCall([&] { return keyframes.encode(data, record, sizeof(record)); }, 200000));
+    size_t len = keyframes.encode(data, record, sizeof(record));
+    OpcN3RecordDecoder decoder;
+    reportBenchmark("decode keyframe", nsPerCall([&] { return decoder.decode(record, len, out); }, 200000));
+
+    OpcN3RecordEncoder deltas(0xFFFF);
+    reportBenchmark("encode delta", nsPerCall([&] { return deltas.encode(data, record, sizeof(record)); }, 200000));
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_zigzag_round_trip);
+    RUN_TEST(test_keyframe_round_trip);
+    RUN_TEST(test_delta_stream_round_trip);
+    RUN_TEST(test_delta_needs_its_base_record);
+    RUN_TEST(test_rejects_short_buffers_and_records);
+    RUN_TEST(test_fixed_point_clamps_and_keeps_nan);
+    RUN_TEST(test_extreme_values_round_trip);
+    RUN_TEST(test_benchmark);
+    return UNITY_END();
+}
@@ -0,0 +1,117 @@
+#include <unity.h>
+#include "OpcN3Crc.h"
+#include "../BenchTimer.h"
+
+// Bytes covered by the histogram frame checksum, and the configuration block
+static const size_t HISTOGRAM_CRC_LENGTH = 84;
+static const size_t CONFIG_SIZE = 168;
+
+static uint8_t buffer[256];
+
+void setUp()
+{
+    uint32_t seed = 0xC0FFEE;
+    for (size_t i = 0; i < sizeof(buffer); i++)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        buffer[i] = (uint8_t)(seed >> 24);
+    }
+}
+
+void tearDown() {}
+
+void test_check_value()
+{
+    const uint8_t input[] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+    TEST_ASSERT_EQUAL_HEX16(0x4B37, OpcN3Crc16::compute(input, sizeof(input)));
+    TEST_ASSERT_EQUAL_HEX16(0xFFFF, OpcN3Crc16::compute(input, 0));
+}
+
+template <size_t Slices>
+static void checkAgainstBitwise()
+{
+    for (size_t len = 0; len <= sizeof(buffer); len++)
+        TEST_ASSERT_EQUAL_HEX16(opcn3_crc::bitwise(buffer, len),
+                                opcn3_crc::update<Slices>(opcn3_crc::INITIAL_VALUE, buffer, len));
+}
+
+void test_tables_match_bitwise()
+{
+    checkAgainstBitwise<1>();
+    checkAgainstBitwise<4>();
+    checkAgainstBitwise<8>();
+}
+
+void test_incremental_matches_bulk()
+{
+    const size_t len = HISTOGRAM_CRC_LENGTH;
+    uint16_t expected = OpcN3Crc16::compute(buffer, len);
+
+    OpcN3Crc16 bytewise;
+    for (size_t i = 0; i < len; i++)
+        bytewise.update(buffer[i]);
+    TEST_ASSERT_EQUAL_HEX16(expected, bytewise.value());
+
+    // Uneven chunks, as when bytes are folded in while they come off the bus
+    OpcN3Crc16 chunked;
+    size_t done = 0;
+    for (size_t chunk = 1; done < len; chunk += 3)
+    {
+        size_t n = chunk < len - done ? chunk : len - done;
+        chunked.update(buffer + done, n);
+        done += n;
+    }
+    TEST_ASSERT_EQUAL_HEX16(expected, chunked.value());
+
+    chunked.reset();
+    TEST_ASSERT_EQUAL_HEX16(opcn3_crc::INITIAL_VALUE, chunked.value());
+}
+
+void test_detects_single_bit_errors()
+{
+    const size_t len = HISTOGRAM_CRC_LENGTH;
+    uint16_t good = OpcN3Crc16::compute(buffer, len);
+    for (size_t bit = 0; bit < len * 8; bit++)
+    {
+        buffer[bit / 8] ^= (uint8_t)(1 << (bit % 8));
+        TEST_ASSERT_TRUE(OpcN3Crc16::compute(buffer, len) != good);
+        buffer[bit / 8] ^= (uint8_t)(1 << (bit % 8));
+    }
+}
+
+static const uint32_t ITERATIONS = 200000;
+
+template <size_t Slices>
+static void benchmarkTable(const char *variant, size_t len)
+{
+    char name[48];
+    snprintf(name, sizeof(name), "%s, %u bytes", variant, (unsigned)len);
+    reportBenchmark(name, nsPerCall([&] { return opcn3_crc::update<Slices>(opcn3_crc::INITIAL_VALUE, buffer, len); },
+                                    ITERATIONS),
+                    len);
+}
+
+void test_benchmark()
+{
+    const size_t lengths[] = {HISTOGRAM_CRC_LENGTH, CONFIG_SIZE};
+    for (size_t len : lengths)
+    {
+        char name[48];
+        snprintf(name, sizeof(name), "bitwise, %u bytes", (unsigned)len);
+        reportBenchmark(name, nsPerCall([&] { return opcn3_crc::bitwise(buffer, len); }, ITERATIONS), len);
+        benchmarkTable<1>("table", len);
+        benchmarkTable<4>("slicing-by-4", len);
+        benchmarkTable<8>("slicing-by-8", len);
+    }
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_check_value);
+    RUN_TEST(test_tables_match_bitwise);
+    RUN_TEST(test_incremental_matches_bulk);
+    RUN_TEST(test_detects_single_bit_errors);
+    RUN_TEST(test_benchmark);
+    return UNITY_END();
+}
@@ -0,0 +1,185 @@
+#include <unity.h>
+#include "OpcN3Distribution.h"
+#include "OpcN3Mass.h"
+#include "../BenchTimer.h"
+
+static const int BINS = OpcN3BinGeometry::BIN_COUNT;
+
+// A histogram of 5 mL sampled air under the given configuration
+static OpcN3Data histogram(uint16_t config_version)
+{
+    OpcN3Data data;
+    memset(&data, 0, sizeof(data));
+    for (int i = 0; i < BINS; i++)
+        data.bin_counts[i] = (uint16_t)(600 >> (i / 2));
+    data.config_version = config_version;
+    data.sampling_period_s = 1.0f;
+    data.sample_flow_rate_ml_s = 5.0f;
+    data.humidity_rh = 50.0f;
+    return data;
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_factory_geometry()
+{
+    OpcN3BinGeometry geometry;
+    const float *edges = OpcN3BinGeometry::factoryEdges();
+    TEST_ASSERT_EQUAL_UINT16(0, geometry.config_version);
+    TEST_ASSERT_EQUAL_FLOAT(0.35f, geometry.edges_um[0]);
+    TEST_ASSERT_EQUAL_FLOAT(40.0f, geometry.edges_um[BINS]);
+    for (int i = 0; i < BINS; i++)
+    {
+        float mid = sqrtf(edges[i] * edges[i + 1]);
+        TEST_ASSERT_FLOAT_WITHIN(1e-5f, mid, geometry.midpoint_um[i]);
+        TEST_ASSERT_FLOAT_WITHIN(1e-3f * geometry.inv_dlogdp[i], 1.0f / log10f(edges[i + 1] / edges[i]),
+                                 geometry.inv_dlogdp[i]);
+        TEST_ASSERT_FLOAT_WITHIN(1e-4f * geometry.volume_um3[i], (float)M_PI / 6.0f * mid * mid * mid,
+                                 geometry.volume_um3[i]);
+    }
+}
+
+void test_configure_rejects_bad_edges()
+{
+    OpcN3BinGeometry geometry;
+    float edges[BINS + 1];
+    for (int i = 0; i <= BINS; i++)
+        edges[i] = 0.5f + i;
+    TEST_ASSERT_TRUE(geometry.configure(edges, 3));
+    TEST_ASSERT_EQUAL_UINT16(3, geometry.config_version);
+    TEST_ASSERT_EQUAL_FLOAT(0.5f, geometry.edges_um[0]);
+
+    edges[10] = edges[9];
+    TEST_ASSERT_FALSE(geometry.configure(edges, 4));
+    edges[10] = 10.5f;
+    edges[0] = 0.0f;
+    TEST_ASSERT_FALSE(geometry.configure(edges, 4));
+    TEST_ASSERT_EQUAL_UINT16(3, geometry.config_version);
+    TEST_ASSERT_EQUAL_FLOAT(10.5f, geometry.edges_um[10]);
+}
+
+// All particles in one bin: the diameters are its midpoint and GSD is 1
+void test_single_bin()
+{
+    OpcN3BinGeometry geometry;
+    float concentrations[BINS] = {};
+    concentrations[3] = 8.0f;
+    OpcN3SizeDistribution out;
+    TEST_ASSERT_TRUE(computeSizeDistribution(geometry, concentrations, out));
+    float mid = geometry.midpoint_um[3];
+    TEST_ASSERT_EQUAL_FLOAT(8.0f, out.number_cm3);
+    TEST_ASSERT_FLOAT_WITHIN(1e-3f, 8.0f * (float)M_PI * mid * mid, out.surface_um2_cm3);
+    TEST_ASSERT_FLOAT_WITHIN(1e-3f, 8.0f * geometry.volume_um3[3], out.volume_um3_cm3);
+    TEST_ASSERT_FLOAT_WITHIN(1e-5f, mid, out.gmd_um);
+    TEST_ASSERT_FLOAT_WITHIN(1e-5f, mid, out.cmd_um);
+    TEST_ASSERT_FLOAT_WITHIN(1e-5f, 1.0f, out.gsd);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, 8.0f * geometry.inv_dlogdp[3], out.dn_dlogdp[3]);
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, out.dn_dlogdp[4]);
+}
+
+// Two equal bins: the median is the edge between them, the GMD the geometric
+// mean of the midpoints and the GSD their log distance from it
+void test_two_bins()
+{
+    OpcN3BinGeometry geometry;
+    float concentrations[BINS] = {};
+    concentrations[5] = 2.0f;
+    concentrations[6] = 2.0f;
+    OpcN3SizeDistribution out;
+    TEST_ASSERT_TRUE(computeSizeDistribution(geometry, concentrations, out));
+    float ln_a = logf(geometry.midpoint_um[5]), ln_b = logf(geometry.midpoint_um[6]);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, geometry.edges_um[6], out.cmd_um);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, expf((ln_a + ln_b) / 2), out.gmd_um);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, expf((ln_b - ln_a) / 2), out.gsd);
+}
+
+void test_no_particles()
+{
+    OpcN3BinGeometry geometry;
+    float concentrations[BINS] = {};
+    OpcN3SizeDistribution out;
+    TEST_ASSERT_FALSE(computeSizeDistribution(geometry, concentrations, out));
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, out.number_cm3);
+    TEST_ASSERT_FLOAT_IS_NAN(out.cmd_um);
+    TEST_ASSERT_FLOAT_IS_NAN(out.gmd_um);
+    TEST_ASSERT_FLOAT_IS_NAN(out.gsd);
+}
+
+// A histogram is normalized by its sampled volume
+void test_histogram_matches_concentrations()
+{
+    OpcN3BinGeometry geometry;
+    OpcN3Data data = histogram(0);
+    float concentrations[BINS];
+    for (int i = 0; i < BINS; i++)
+        concentrations[i] = data.bin_counts[i] / 5.0f;
+    OpcN3SizeDistribution fromData, fromConcentrations;
+    TEST_ASSERT_TRUE(computeSizeDistribution(geometry, data, fromData));
+    TEST_ASSERT_TRUE(computeSizeDistribution(geometry, concentrations, fromConcentrations));
+    TEST_ASSERT_FLOAT_WITHIN(1e-3f, fromConcentrations.number_cm3, fromData.number_cm3);
+    TEST_ASSERT_FLOAT_WITHIN(1e-5f, fromConcentrations.cmd_um, fromData.cmd_um);
+    TEST_ASSERT_FLOAT_WITHIN(1e-5f, fromConcentrations.gsd, fromData.gsd);
+}
+
+// Histograms counted under another configuration are not sized with this table
+void test_rejects_other_config_version()
+{
+    float edges[BINS + 1];
+    for (int i = 0; i <= BINS; i++)
+        edges[i] = 0.4f * (i + 1);
+    OpcN3BinGeometry geometry;
+    TEST_ASSERT_TRUE(geometry.configure(edges, 2));
+
+    OpcN3SizeDistribution out;
+    TEST_ASSERT_TRUE(computeSizeDistribution(geometry, histogram(2), out));
+    TEST_ASSERT_FALSE(geometry.matches(histogram(1)));
+    TEST_ASSERT_FALSE(computeSizeDistribution(geometry, histogram(1), out));
+    TEST_ASSERT_FLOAT_IS_NAN(out.number_cm3);
+    TEST_ASSERT_FLOAT_IS_NAN(out.dn_dlogdp[0]);
+    TEST_ASSERT_FLOAT_IS_NAN(out.cmd_um);
+
+    OpcN3MassEngine mass;
+    mass.configure(geometry);
+    OpcN3MassConcentration pm;
+    TEST_ASSERT_EQUAL_UINT16(2, mass.configVersion());
+    TEST_ASSERT_TRUE(mass.compute(histogram(2), pm));
+    TEST_ASSERT_FALSE(mass.compute(histogram(3), pm));
+}
+
+void test_benchmark()
+{
+    OpcN3BinGeometry geometry;
+    OpcN3Data data = histogram(0);
+    float concentrations[BINS];
+    for (int i = 0; i < BINS; i++)
+        concentrations[i] = data.bin_counts[i] / 5.0f;
+    OpcN3SizeDistribution out;
+
+    reportBenchmark("distribution from concentrations", nsPerCall([&] {
+                        computeSizeDistribution(geometry, concentrations, out);
+                        return out.cmd_um;
+                    }, 200000));
+    reportBenchmark("distribution from histogram", nsPerCall([&] {
+                        computeSizeDistribution(geometry, data, out);
+                        return out.cmd_um;
+                    }, 200000));
+
+    float edges[BINS + 1];
+    memcpy(edges, OpcN3BinGeometry::factoryEdges(), sizeof(edges));
+    reportBenchmark("configure geometry", nsPerCall([&] { return geometry.configure(edges, 1); }, 20000));
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_factory_geometry);
+    RUN_TEST(test_configure_rejects_bad_edges);
+    RUN_TEST(test_single_bin);
+    RUN_TEST(test_two_bins);
+    RUN_TEST(test_no_particles);
+    RUN_TEST(test_histogram_matches_concentrations);
+    RUN_TEST(test_rejects_other_config_version);
+    RUN_TEST(test_benchmark);
+    return UNITY_END();
+}
@@ -0,0 +1,212 @@
+#include <unity.h>
+#include "OpcN3Mass.h"
+#include "../BenchTimer.h"
+
+static const int BINS = OpcN3MassEngine::BIN_COUNT;
+static const OpcN3BinGeometry geometry;
+
+// GF(RH) = (1 + kappa * aw / (1 - aw))^(1/3)
+static float closedFormGf(float kappa, float humidity_rh)
+{
+    float aw = humidity_rh / 100.0f;
+    return cbrtf(1.0f + kappa * aw / (1.0f - aw));
+}
+
+// Mass concentration (ug/m3) of one particle/cm3 in bin i
+static float binMass(const OpcN3DensityProfile &profile, int i)
+{
+    float density = geometry.midpoint_um[i] < profile.split_um ? profile.fine_density_g_cm3
+                                                               : profile.coarse_density_g_cm3;
+    return density * geometry.volume_um3[i];
+}
+
+void setUp() {}
+void tearDown() {}
+
+// Without water uptake the dry values are the measured ones
+void test_dry_equals_wet_at_zero_humidity()
+{
+    OpcN3MassEngine engine(OPCN3_PROFILE_MARINE);
+    float concentrations[BINS];
+    for (int i = 0; i < BINS; i++)
+        concentrations[i] = 10.0f / (1 + i);
+    const float humidities[] = {0.0f, -5.0f, NAN};
+    for (float rh : humidities)
+    {
+        OpcN3MassConcentration mass;
+        TEST_ASSERT_TRUE(engine.compute(concentrations, rh, mass));
+        TEST_ASSERT_EQUAL_FLOAT(1.0f, mass.growth_factor);
+        TEST_ASSERT_EQUAL_FLOAT(mass.pm1, mass.pm1_dry);
+        TEST_ASSERT_EQUAL_FLOAT(mass.pm2_5, mass.pm2_5_dry);
+        TEST_ASSERT_EQUAL_FLOAT(mass.pm10, mass.pm10_dry);
+        TEST_ASSERT_GREATER_THAN(0.0f, mass.pm1);
+        TEST_ASSERT_LESS_THAN(mass.pm2_5, mass.pm1);
+        TEST_ASSERT_LESS_THAN(mass.pm10, mass.pm2_5);
+    }
+}
+
+// The lookup table interpolates the closed form between whole percents,
+// within 0.1 % up to 90 %RH
+void test_growth_factor_matches_the_closed_form()
+{
+    const OpcN3DensityProfile profiles[] = {OPCN3_PROFILE_URBAN, OPCN3_PROFILE_MARINE, OPCN3_PROFILE_DUST};
+    for (const OpcN3DensityProfile &profile : profiles)
+    {
+        OpcN3MassEngine engine(profile);
+        for (float rh = 0.0f; rh <= 90.0f; rh += 2.5f)
+        {
+            float gf = closedFormGf(profile.kappa, rh);
+            TEST_ASSERT_FLOAT_WITHIN(1e-3f * gf, gf, engine.growthFactor(rh));
+        }
+        // Near saturation GF bends too sharply for 1 % steps
+        float gf = closedFormGf(profile.kappa, 97.5f);
+        TEST_ASSERT_FLOAT_WITHIN(1e-2f * gf, gf, engine.growthFactor(97.5f));
+        TEST_ASSERT_FLOAT_WITHIN(1e-5f, closedFormGf(profile.kappa, 99.0f), engine.growthFactor(99.0f));
+        // Clamped above 99 %RH, where GF grows without bound
+        TEST_ASSERT_EQUAL_FLOAT(engine.growthFactor(99.0f), engine.growthFactor(100.0f));
+        TEST_ASSERT_EQUAL_FLOAT(engine.growthFactor(99.0f), engine.growthFactor(250.0f));
+    }
+    OpcN3MassEngine marine(OPCN3_PROFILE_MARINE);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, cbrtf(1.0f + 0.9f * 4.0f), marine.growthFactor(80.0f));
+}
+
+// Only bin 6 (2.3-3.0 um) holds particles: PM2.5 gets the part of it below
+// 2.5 um on a log scale, PM10 all of it, PM1 nothing
+void test_cutoff_bin_is_split_on_a_log_scale()
+{
+    OpcN3MassEngine engine(OPCN3_PROFILE_URBAN);
+    float concentrations[BINS] = {};
+    concentrations[6] = 3.0f;
+    OpcN3MassConcentration mass;
+    TEST_ASSERT_TRUE(engine.compute(concentrations, 0.0f, mass));
+
+    float total = 3.0f * binMass(OPCN3_PROFILE_URBAN, 6);
+    float below = (logf(2.5f) - logf(2.3f)) / (logf(3.0f) - logf(2.3f));
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, mass.pm1);
+    TEST_ASSERT_EQUAL_FLOAT(total * below, mass.pm2_5);
+    TEST_ASSERT_EQUAL_FLOAT(total, mass.pm10);
+
+    // At 30 %RH the dry cut-off moves to 2.5 um x GF (2.6 um), so more of
+    // the bin counts, at its dry mass
+    float gf = engine.growthFactor(30.0f);
+    TEST_ASSERT_TRUE(engine.compute(concentrations, 30.0f, mass));
+    float below_dry = (logf(2.5f * gf) - logf(2.3f)) / (logf(3.0f) - logf(2.3f));
+    TEST_ASSERT_FLOAT_WITHIN(1e-3f * total, total * below_dry / (gf * gf * gf), mass.pm2_5_dry);
+    TEST_ASSERT_FLOAT_WITHIN(1e-3f * total, total / (gf * gf * gf), mass.pm10_dry);
+    TEST_ASSERT_EQUAL_FLOAT(total * below, mass.pm2_5);
+}
+
+// Bins wholly below 1 um lose only the water: dry = wet / GF^3
+void test_fine_bins_scale_with_the_growth_factor_cubed()
+{
+    OpcN3MassEngine engine(OPCN3_PROFILE_URBAN);
+    float concentrations[BINS] = {};
+    concentrations[0] = 50.0f;
+    concentrations[1] = 20.0f;
+    OpcN3MassConcentration mass;
+    TEST_ASSERT_TRUE(engine.compute(concentrations, 60.0f, mass));
+    float gf = closedFormGf(OPCN3_PROFILE_URBAN.kappa, 60.0f);
+    float expected = 50.0f * binMass(OPCN3_PROFILE_URBAN, 0) + 20.0f * binMass(OPCN3_PROFILE_URBAN, 1);
+    TEST_ASSERT_EQUAL_FLOAT(expected, mass.pm1);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f * expected, expected / (gf * gf * gf), mass.pm1_dry);
+    TEST_ASSERT_EQUAL_FLOAT(mass.pm1_dry, mass.pm10_dry);
+}
+
+void test_invalid_concentrations_are_rejected()
+{
+    OpcN3MassEngine engine;
+    float concentrations[BINS] = {};
+    concentrations[3] = NAN;
+    OpcN3MassConcentration mass;
+    TEST_ASSERT_FALSE(engine.compute(concentrations, 50.0f, mass));
+}
+
+// A histogram is only converted with tables built from its configuration
+void test_config_version_mismatch_is_rejected()
+{
+    OpcN3Data data = {};
+    data.bin_counts[2] = 100;
+    data.sample_flow_rate_ml_s = 5.0f;
+    data.sampling_period_s = 1.0f;
+    data.humidity_rh = 40.0f;
+    data.config_version = 3;
+
+    OpcN3MassEngine engine;
+    OpcN3MassConcentration mass;
+    TEST_ASSERT_EQUAL_UINT16(0, engine.configVersion());
+    TEST_ASSERT_FALSE(engine.compute(data, mass));
+
+    OpcN3BinGeometry configured;
+    TEST_ASSERT_TRUE(configured.configure(OpcN3BinGeometry::factoryEdges(), 3));
+    engine.configure(configured);
+    TEST_ASSERT_EQUAL_UINT16(3, engine.configVersion());
+    TEST_ASSERT_TRUE(engine.compute(data, mass));
+    TEST_ASSERT_EQUAL_FLOAT(20.0f * binMass(OPCN3_PROFILE_URBAN, 2), mass.pm1);
+
+    // No usable flow rate: no volume to normalize by
+    data.sample_flow_rate_ml_s = 0.0f;
+    TEST_ASSERT_FALSE(engine.compute(data, mass));
+}
+
+// The profile sets the density: twice the density, twice the mass
+void test_density_profiles()
+{
+    OpcN3DensityProfile light = {"light", 1.0f, 1.0f, 1.0f, 0.0f};
+    OpcN3DensityProfile heavy = {"heavy", 2.0f, 2.0f, 1.0f, 0.0f};
+    OpcN3MassEngine a(light), b(heavy);
+    float concentrations[BINS];
+    for (int i = 0; i < BINS; i++)
+        concentrations[i] = 1.0f;
+    OpcN3MassConcentration ma, mb;
+    a.compute(concentrations, 70.0f, ma);
+    b.compute(concentrations, 70.0f, mb);
+    TEST_ASSERT_EQUAL_FLOAT(2.0f * ma.pm10, mb.pm10);
+    // kappa 0: insoluble, no growth
+    TEST_ASSERT_EQUAL_FLOAT(1.0f, ma.growth_factor);
+    TEST_ASSERT_EQUAL_FLOAT(ma.pm2_5, ma.pm2_5_dry);
+    TEST_ASSERT_EQUAL_STRING("heavy", b.profile().name);
+}
+
+void test_benchmark()
+{
+    OpcN3MassEngine engine;
+    float concentrations[BINS];
+    for (int i = 0; i < BINS; i++)
+        concentrations[i] = 40.0f / (1 + i * i);
+    OpcN3MassConcentration mass;
+    float rh = 0.0f;
+    reportBenchmark("compute(concentrations, rh)", nsPerCall([&] {
+                        rh = rh < 98.0f ? rh + 0.7f : 0.0f;
+                        engine.compute(concentrations, rh, mass);
+                        return mass.pm2_5_dry;
+                    }, 200000));
+
+    OpcN3Data data = {};
+    for (int i = 0; i < BINS; i++)
+        data.bin_counts[i] = (uint16_t)(400 / (1 + i));
+    data.sample_flow_rate_ml_s = 5.2f;
+    data.sampling_period_s = 1.0f;
+    data.humidity_rh = 65.0f;
+    reportBenchmark("compute(data)", nsPerCall([&] {
+                        engine.compute(data, mass);
+                        return mass.pm10_dry;
+                    }, 200000));
+    reportBenchmark("configure", nsPerCall([&] {
+                        engine.configure(geometry);
+                        return engine.growthFactor(50.0f);
+                    }, 5000));
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_dry_equals_wet_at_zero_humidity);
+    RUN_TEST(test_growth_factor_matches_the_closed_form);
+    RUN_TEST(test_cutoff_bin_is_split_on_a_log_scale);
+    RUN_TEST(test_fine_bins_scale_with_the_growth_factor_cubed);
+    RUN_TEST(test_invalid_concentrations_are_rejected);
+    RUN_TEST(test_config_version_mismatch_is_rejected);
+    RUN_TEST(test_density_profiles);
+    RUN_TEST(test_benchmark);
+    return UNITY_END();
+}
@@ -0,0 +1,201 @@
+#include <unity.h>
+#include "OpcN3SimBus.h"
+#include "../BenchTimer.h"
+
+typedef OpcN3Driver<OpcN3SimBus> SimOpc;
+
+static SimOpc *opc;
+
+void setUp()
+{
+    opc = new SimOpc(OpcN3SimBus());
+    opc->bus().setReadyLatencyMs(30);
+}
+
+void tearDown()
+{
+    delete opc;
+}
+
+void test_begin_powers_up_and_reads_configuration()
+{
+    TEST_ASSERT_TRUE(opc->begin());
+    TEST_ASSERT_TRUE(opc->bus().fanOn());
+    TEST_ASSERT_TRUE(opc->bus().laserOn());
+    TEST_ASSERT_EQUAL_UINT16(1, opc->config().version);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, 0.35f, opc->config().bin_boundaries_um[0]);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, 40.0f, opc->config().bin_boundaries_um[24]);
+    TEST_ASSERT_GREATER_THAN(0u, opc->bootStepMs(OpcN3Types::BOOT_POWER_UP));
+}
+
+void test_read_histogram()
+{
+    TEST_ASSERT_TRUE(opc->begin());
+    OpcN3Data data;
+    TEST_ASSERT_TRUE(opc->readData(data));
+    TEST_ASSERT_TRUE(data.checksum_ok);
+    TEST_ASSERT_EQUAL_UINT16(400, data.bin_counts[0]);
+    TEST_ASSERT_EQUAL_UINT16(50, data.bin_counts[9]);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, 11.0f, data.pm_c);
+    TEST_ASSERT_EQUAL_UINT16(opc->config().version, data.config_version);
+    TEST_ASSERT_GREATER_THAN(0u, opc->bus().busyReplies());
+}
+
+void test_read_pm()
+{
+    TEST_ASSERT_TRUE(opc->begin());
+    OpcN3PmData pm;
+    TEST_ASSERT_TRUE(opc->readPm(pm));
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, 3.5f, pm.pm_a);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, 6.25f, pm.pm_b);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, 11.0f, pm.pm_c);
+}
+
+void test_async_read_polls_until_ready()
+{
+    TEST_ASSERT_TRUE(opc->begin());
+    OpcN3Data data;
+    TEST_ASSERT_TRUE(opc->startRead());
+    TEST_ASSERT_FALSE(opc->startRead());
+    int polls = 0;
+    OpcN3Types::ReadStatus status;
+    while ((status = opc->poll(data)) == OpcN3Types::READ_PENDING && polls < 1000)
+    {
+        opc->bus().advanceUs(1000);
+        polls++;
+    }
+    TEST_ASSERT_EQUAL_INT(OpcN3Types::READ_OK, status);
+    TEST_ASSERT_GREATER_THAN(0, polls);
+    TEST_ASSERT_EQUAL_UINT16(400, data.bin_counts[0]);
+}
+
+// A sensor that stays busy past the 500 ms handshake timeout fails the read
+// and leaves the driver free for the next one
+void test_async_read_times_out()
+{
+    TEST_ASSERT_TRUE(opc->begin());
+    opc->bus().setReadyLatencyMs(2000);
+    OpcN3Data data;
+    unsigned long started = opc->bus().millis();
+    TEST_ASSERT_TRUE(opc->startRead());
+    int polls = 0;
+    OpcN3Types::ReadStatus status;
+    while ((status = opc->poll(data)) == OpcN3Types::READ_PENDING && polls < 10000)
+    {
+        opc->bus().advanceUs(1000);
+        polls++;
+    }
+    TEST_ASSERT_EQUAL_INT(OpcN3Types::READ_FAILED, status);
+    TEST_ASSERT_GREATER_OR_EQUAL(500u, opc->bus().millis() - started);
+    TEST_ASSERT_LESS_THAN(2000u, opc->bus().millis() - started);
+    TEST_ASSERT_EQUAL_INT(OpcN3Types::READ_IDLE, opc->poll(data));
+    TEST_ASSERT_TRUE(opc->startRead());
+}
+
+// Blocking calls would take over the handshake of a pending read; they are
+// rejected and the read completes intact
+void test_blocking_calls_rejected_during_async_read()
+{
+    TEST_ASSERT_TRUE(opc->begin());
+    uint32_t commands = opc->bus().commandCount();
+    OpcN3Data data;
+    TEST_ASSERT_TRUE(opc->startRead());
+    TEST_ASSERT_FALSE(opc->readData(data));
+    TEST_ASSERT_FALSE(opc->readConfiguration());
+    TEST_ASSERT_EQUAL_UINT32(commands + 1, opc->bus().commandCount());
+
+    OpcN3Types::ReadStatus status;
+    while ((status = opc->poll(data)) == OpcN3Types::READ_PENDING)
+        opc->bus().advanceUs(1000);
+    TEST_ASSERT_EQUAL_INT(OpcN3Types::READ_OK, status);
+    TEST_ASSERT_TRUE(data.checksum_ok);
+    TEST_ASSERT_EQUAL_UINT16(400, data.bin_counts[0]);
+    TEST_ASSERT_TRUE(opc->readData(data));
+}
+
+void test_burst_mode_holds_the_bus_shorter()
+{
+    TEST_ASSERT_TRUE(opc->begin());
+    OpcN3Data data;
+    TEST_ASSERT_TRUE(opc->readData(data));
+    uint32_t paced = opc->lastBusTimeUs();
+    opc->setBurstMode(true);
+    TEST_ASSERT_TRUE(opc->readData(data));
+    TEST_ASSERT_LESS_THAN(paced, opc->lastBusTimeUs());
+}
+
+// The configuration block has no CRC, so burst mode must not apply to it
+void test_configuration_is_read_paced_in_burst_mode()
+{
+    TEST_ASSERT_TRUE(opc->begin());
+    TEST_ASSERT_TRUE(opc->readConfiguration());
+    uint32_t paced = opc->lastBusTimeUs();
+    opc->setBurstMode(true);
+    TEST_ASSERT_TRUE(opc->readConfiguration());
+    TEST_ASSERT_EQUAL_UINT32(paced, opc->lastBusTimeUs());
+}
+
+void test_crc_errors_end_burst_mode()
+{
+    TEST_ASSERT_TRUE(opc->begin());
+    opc->setBurstMode(true);
+    opc->bus().setBitErrorRate(0.01f);
+    OpcN3Data data;
+    int failures = 0;
+    for (int i = 0; i < 10; i++)
+    {
+        if (!opc->readData(data))
+            failures++;
+    }
+    TEST_ASSERT_GREATER_THAN(0u, opc->bus().bitsFlipped());
+    TEST_ASSERT_EQUAL_UINT32(failures, opc->crcErrorCount());
+    TEST_ASSERT_GREATER_OR_EQUAL(3, failures);
+    TEST_ASSERT_FALSE(opc->burstMode());
+}
+
+void test_write_configuration_round_trip()
+{
+    TEST_ASSERT_TRUE(opc->begin());
+    OpcN3Config config = opc->config();
+    config.pm_diameter_a_um = 1.0f;
+    config.am_sampling_interval_count = 7;
+    TEST_ASSERT_TRUE(opc->writeConfiguration(config, true));
+    TEST_ASSERT_EQUAL_UINT16(2, opc->config().version);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, 1.0f, opc->config().pm_diameter_a_um);
+    TEST_ASSERT_EQUAL_UINT16(7, opc->config().am_sampling_interval_count);
+    TEST_ASSERT_EQUAL_UINT32(1, opc->bus().configSaves());
+
+    // Writing the same values again does not publish a new version
+    TEST_ASSERT_TRUE(opc->setSamplingIntervalCount(7));
+    TEST_ASSERT_EQUAL_UINT16(2, opc->config().version);
+}
+
+// Host CPU time per blocking read, with the simulated sensor ready at once
+void test_benchmark()
+{
+    TEST_ASSERT_TRUE(opc->begin());
+    opc->bus().setReadyLatencyMs(0);
+    OpcN3Data data;
+    reportBenchmark("readData, paced", nsPerCall([&] { return opc->readData(data); }, 20000));
+    opc->setBurstMode(true);
+    reportBenchmark("readData, burst", nsPerCall([&] { return opc->readData(data); }, 20000));
+    OpcN3PmData pm;
+    reportBenchmark("readPm, burst", nsPerCall([&] { return opc->readPm(pm); }, 20000));
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_begin_powers_up_and_reads_configuration);
+    RUN_TEST(test_read_histogram);
+    RUN_TEST(test_read_pm);
+    RUN_TEST(test_async_read_polls_until_ready);
+    RUN_TEST(test_async_read_times_out);
+    RUN_TEST(test_blocking_calls_rejected_during_async_read);
+    RUN_TEST(test_burst_mode_holds_the_bus_shorter);
+    RUN_TEST(test_configuration_is_read_paced_in_burst_mode);
+    RUN_TEST(test_crc_errors_end_burst_mode);
+    RUN_TEST(test_write_configuration_round_trip);
+    RUN_TEST(test_benchmark);
+    return UNITY_END();
+}
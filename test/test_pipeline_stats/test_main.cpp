@@ -0,0 +1,99 @@
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <unity.h>
+#include "PipelineStageStats.h"
+#include "SpscQueue.h"
+
+void setUp() {}
+void tearDown() {}
+
+void test_empty_stats()
+{
+    PipelineStageStats stats = {};
+    TEST_ASSERT_EQUAL_UINT32(0, stats.items);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.averageLatencyMs());
+}
+
+void test_record_tracks_latency_and_backlog()
+{
+    PipelineStageStats stats = {};
+    stats.record(40, 1500, 3);
+    stats.record(120, 2500, 7);
+    stats.record(20, 1000, 0);
+    TEST_ASSERT_EQUAL_UINT32(3, stats.items);
+    TEST_ASSERT_EQUAL_UINT32(20, stats.last_latency_ms);
+    TEST_ASSERT_EQUAL_UINT32(120, stats.max_latency_ms);
+    TEST_ASSERT_EQUAL_UINT32(60, stats.averageLatencyMs());
+    TEST_ASSERT_EQUAL_UINT64(5000, stats.busy_us);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.backlog);
+    TEST_ASSERT_EQUAL_UINT32(7, stats.max_backlog);
+}
+
+// The 64-bit total does not wrap where a 32-bit sum of latencies would
+void test_total_latency_does_not_wrap()
+{
+    PipelineStageStats stats = {};
+    for (int i = 0; i < 4; i++)
+        stats.record(0x7FFFFFFF, 0, 0);
+    TEST_ASSERT_EQUAL_UINT64(4ull * 0x7FFFFFFF, stats.total_latency_ms);
+    TEST_ASSERT_EQUAL_UINT32(0x7FFFFFFF, stats.averageLatencyMs());
+}
+
+struct Stamped
+{
+    uint32_t seq;
+    std::chrono::steady_clock::time_point acquired;
+};
+
+// Two stages wired the way the firmware wires them: the first pushes into a
+// queue, the second pops and records each item with the queue's backlog
+void test_two_stage_wiring()
+{
+    const uint32_t count = 20000;
+    SpscQueue<Stamped, 16> queue(SPSC_BLOCK, 1000);
+    PipelineStageStats consumerStats = {};
+    std::atomic<bool> done(false);
+
+    std::thread producer([&] {
+        for (uint32_t seq = 0; seq < count; seq++)
+            queue.push({seq, std::chrono::steady_clock::now()});
+        done.store(true, std::memory_order_release);
+    });
+    std::thread consumer([&] {
+        Stamped item;
+        for (;;)
+        {
+            if (!queue.pop(item))
+            {
+                if (done.load(std::memory_order_acquire) && queue.empty())
+                    break;
+                std::this_thread::yield();
+                continue;
+            }
+            auto now = std::chrono::steady_clock::now();
+            uint32_t latency_ms =
+                (uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>(now - item.acquired).count();
+            consumerStats.record(latency_ms, 1, queue.size());
+        }
+    });
+    producer.join();
+    consumer.join();
+
+    TEST_ASSERT_EQUAL_UINT32(count, consumerStats.items);
+    TEST_ASSERT_EQUAL_UINT32(queue.stats().popped, consumerStats.items);
+    TEST_ASSERT_EQUAL_UINT64(count, consumerStats.busy_us);
+    TEST_ASSERT_LESS_OR_EQUAL(16u, consumerStats.max_backlog);
+    TEST_ASSERT_LESS_OR_EQUAL(queue.stats().high_water, consumerStats.max_backlog);
+    TEST_ASSERT_LESS_OR_EQUAL(consumerStats.max_latency_ms, consumerStats.averageLatencyMs());
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_empty_stats);
+    RUN_TEST(test_record_tracks_latency_and_backlog);
+    RUN_TEST(test_total_latency_does_not_wrap);
+    RUN_TEST(test_two_stage_wiring);
+    return UNITY_END();
+}
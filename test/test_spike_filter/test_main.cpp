@@ -0,0 +1,180 @@
+#include <algorithm>
+#include <unity.h>
+#include "SpikeDetector.h"
+#include "../BenchTimer.h"
+
+static uint32_t rngState;
+
+// Deterministic values in [0, range), quantized to 0.25 so duplicates occur
+static float randomValue(uint32_t range)
+{
+    rngState = rngState * 1664525u + 1013904223u;
+    return (float)((rngState >> 8) % (range * 4)) * 0.25f;
+}
+
+// Median of sorted values, averaging the middle two for an even count
+static float sortedMedian(const float *sorted, size_t count)
+{
+    return count % 2 ? sorted[count / 2] : 0.5f * (sorted[count / 2 - 1] + sorted[count / 2]);
+}
+
+// Against sorting the last N values after every add
+template <size_t N>
+static void checkAgainstSort(int values, uint32_t range)
+{
+    RollingMedian<N> window;
+    float history[N];
+    size_t count = 0, next = 0;
+    for (int step = 0; step < values; step++)
+    {
+        float value = randomValue(range);
+        window.add(value);
+        history[next] = value;
+        next = (next + 1) % N;
+        if (count < N)
+            count++;
+
+        float sorted[N], deviations[N];
+        std::copy(history, history + count, sorted);
+        std::sort(sorted, sorted + count);
+        float median = sortedMedian(sorted, count);
+        for (size_t i = 0; i < count; i++)
+            deviations[i] = fabsf(sorted[i] - median);
+        std::sort(deviations, deviations + count);
+
+        TEST_ASSERT_EQUAL_size_t(count, window.size());
+        for (size_t k = 0; k < count; k++)
+            TEST_ASSERT_EQUAL_FLOAT(sorted[k], window.select(k));
+        TEST_ASSERT_EQUAL_FLOAT(median, window.median());
+        TEST_ASSERT_EQUAL_FLOAT(sortedMedian(deviations, count), window.mad());
+    }
+    TEST_ASSERT_TRUE(window.full());
+}
+
+void setUp() { rngState = 2024; }
+void tearDown() {}
+
+void test_empty_window()
+{
+    RollingMedian<8> window;
+    TEST_ASSERT_EQUAL_size_t(0, window.size());
+    TEST_ASSERT_FLOAT_IS_NAN(window.median());
+    TEST_ASSERT_FLOAT_IS_NAN(window.mad());
+    TEST_ASSERT_FLOAT_IS_NAN(window.select(0));
+
+    window.add(NAN);
+    TEST_ASSERT_EQUAL_size_t(0, window.size());
+    window.add(3.0f);
+    TEST_ASSERT_EQUAL_FLOAT(3.0f, window.median());
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, window.mad());
+    TEST_ASSERT_FLOAT_IS_NAN(window.select(1));
+}
+
+void test_matches_sort_small_windows()
+{
+    checkAgainstSort<1>(50, 10);
+    checkAgainstSort<2>(200, 10);
+    checkAgainstSort<7>(500, 5);
+}
+
+void test_matches_sort_large_windows()
+{
+    checkAgainstSort<64>(2000, 40);
+    checkAgainstSort<65>(2000, 1000);
+}
+
+void test_reset()
+{
+    RollingMedian<4> window;
+    for (int i = 0; i < 10; i++)
+        window.add((float)i);
+    TEST_ASSERT_EQUAL_FLOAT(7.5f, window.median());
+    window.reset();
+    TEST_ASSERT_EQUAL_size_t(0, window.size());
+    window.add(1.0f);
+    window.add(5.0f);
+    TEST_ASSERT_EQUAL_FLOAT(3.0f, window.median());
+    TEST_ASSERT_EQUAL_FLOAT(2.0f, window.mad());
+}
+
+void test_spike_is_flagged()
+{
+    SpikeDetector<16> detector(5.0f, 0.0f, 8);
+    for (int i = 0; i < 7; i++)
+        TEST_ASSERT_FLOAT_IS_NAN(detector.check(10.0f + (i % 3)));
+    TEST_ASSERT_FLOAT_IS_NAN(detector.check(NAN));
+    for (int i = 0; i < 20; i++)
+        TEST_ASSERT_FALSE(detector.isSpike(detector.check(10.0f + (i % 3))));
+
+    // Window of 10, 11, 12: median 11, MAD 1
+    float score = detector.check(50.0f);
+    TEST_ASSERT_FLOAT_WITHIN(1e-3f, 39.0f / 1.4826f, score);
+    TEST_ASSERT_TRUE(detector.isSpike(score));
+    TEST_ASSERT_FALSE(detector.isSpike(detector.check(12.0f)));
+    TEST_ASSERT_FALSE(detector.isSpike(NAN));
+}
+
+// A flat signal has a MAD of 0: any change is infinitely far out unless
+// min_scale bounds the scale
+void test_flat_signal_and_min_scale()
+{
+    SpikeDetector<8> strict(5.0f, 0.0f, 4), tolerant(5.0f, 1.0f, 4);
+    for (int i = 0; i < 8; i++)
+    {
+        strict.check(20.0f);
+        tolerant.check(20.0f);
+    }
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, strict.check(20.0f));
+    TEST_ASSERT_TRUE(isinf(strict.check(20.5f)));
+    TEST_ASSERT_EQUAL_FLOAT(0.5f, tolerant.check(20.5f));
+    TEST_ASSERT_TRUE(tolerant.isSpike(tolerant.check(26.0f)));
+}
+
+// A lasting change of level is flagged until it fills half the window
+void test_level_shift_is_accepted()
+{
+    SpikeDetector<16> detector(5.0f, 0.5f);
+    for (int i = 0; i < 16; i++)
+        detector.check(10.0f);
+    int flagged = 0;
+    for (int i = 0; i < 16; i++)
+    {
+        if (detector.isSpike(detector.check(30.0f)))
+            flagged++;
+    }
+    TEST_ASSERT_EQUAL_INT(8, flagged);
+}
+
+void test_benchmark()
+{
+    static float values[1024];
+    for (int i = 0; i < 1024; i++)
+        values[i] = randomValue(100);
+    uint32_t i = 0;
+
+    RollingMedian<64> window;
+    reportBenchmark("RollingMedian<64>::add", nsPerCall([&] {
+                        window.add(values[i++ & 1023]);
+                        return window.size();
+                    }, 500000));
+    reportBenchmark("RollingMedian<64>::median", nsPerCall([&] { return window.median(); }, 500000));
+    reportBenchmark("RollingMedian<64>::mad", nsPerCall([&] { return window.mad(); }, 200000));
+
+    SpikeDetector<64> detector;
+    reportBenchmark("SpikeDetector<64>::check", nsPerCall([&] { return detector.check(values[i++ & 1023]) > 0.0f; },
+                                                          200000));
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_empty_window);
+    RUN_TEST(test_matches_sort_small_windows);
+    RUN_TEST(test_matches_sort_large_windows);
+    RUN_TEST(test_reset);
+    RUN_TEST(test_spike_is_flagged);
+    RUN_TEST(test_flat_signal_and_min_scale);
+    RUN_TEST(test_level_shift_is_accepted);
+    RUN_TEST(test_benchmark);
+    return UNITY_END();
+}
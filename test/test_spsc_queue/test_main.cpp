@@ -0,0 +1,188 @@
+#include <atomic>
+#include <thread>
+#include <unity.h>
+#include "SpscQueue.h"
+
+static const uint32_t ITEM_COUNT = 200000;
+static const size_t CAPACITY = 4;
+static const int PAYLOAD_WORDS = 255;
+
+// About 1 KB, so a copy takes long enough to be overwritten halfway; a torn
+// copy that was kept shows up as a mismatch between seq and payload
+struct Item
+{
+    uint32_t seq;
+    uint32_t payload[PAYLOAD_WORDS];
+};
+
+static Item makeItem(uint32_t seq)
+{
+    Item item;
+    item.seq = seq;
+    for (int i = 0; i < PAYLOAD_WORDS; i++)
+        item.payload[i] = seq * 2654435761u + i;
+    return item;
+}
+
+static bool intact(const Item &item)
+{
+    for (int i = 0; i < PAYLOAD_WORDS; i++)
+    {
+        if (item.payload[i] != item.seq * 2654435761u + i)
+            return false;
+    }
+    return true;
+}
+
+struct RunResult
+{
+    uint32_t accepted; // push() returned true
+    uint32_t received;
+    uint32_t torn;
+    uint32_t out_of_order;
+};
+
+// One producer thread pushing ITEM_COUNT numbered items as fast as it can,
+// one consumer thread that stalls now and then so the queue overflows. The
+// items are large, so with SPSC_DROP_OLDEST the producer often evicts the
+// item the consumer is copying (on a multi-core host; a single core only
+// interleaves the threads at preemption).
+static RunResult run(SpscQueue<Item, CAPACITY> &queue)
+{
+    RunResult result = {};
+    std::atomic<bool> done(false);
+
+    std::thread producer([&] {
+        for (uint32_t seq = 0; seq < ITEM_COUNT; seq++)
+        {
+            if (queue.push(makeItem(seq)))
+                result.accepted++;
+        }
+        done.store(true, std::memory_order_release);
+    });
+
+    std::thread consumer([&] {
+        uint32_t next = 0;
+        bool first = true;
+        for (;;)
+        {
+            Item item;
+            if (!queue.pop(item))
+            {
+                if (done.load(std::memory_order_acquire) && queue.empty())
+                    break;
+                std::this_thread::yield();
+                continue;
+            }
+            result.received++;
+            if (!intact(item))
+                result.torn++;
+            if (!first && item.seq < next)
+                result.out_of_order++;
+            next = item.seq + 1;
+            first = false;
+            if (result.received % 64 == 0)
+                std::this_thread::yield();
+        }
+    });
+
+    producer.join();
+    consumer.join();
+    return result;
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_drop_newest()
+{
+    SpscQueue<Item, CAPACITY> queue(SPSC_DROP_NEWEST);
+    RunResult result = run(queue);
+    SpscQueueStats stats = queue.stats();
+    TEST_ASSERT_EQUAL_UINT32(0, result.torn);
+    TEST_ASSERT_EQUAL_UINT32(0, result.out_of_order);
+    TEST_ASSERT_EQUAL_UINT32(result.accepted, stats.pushed);
+    TEST_ASSERT_EQUAL_UINT32(ITEM_COUNT, stats.pushed + stats.dropped_newest);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.dropped_oldest);
+    TEST_ASSERT_EQUAL_UINT32(result.accepted, result.received);
+    TEST_ASSERT_EQUAL_UINT32(result.received, stats.popped);
+    TEST_ASSERT_LESS_OR_EQUAL(CAPACITY, stats.high_water);
+    if (stats.dropped_newest > 0)
+        TEST_ASSERT_EQUAL_UINT32(CAPACITY, stats.high_water);
+}
+
+// The oldest items are evicted while the consumer copies them: what arrives
+// is intact, in order, and every item is either received or counted dropped
+void test_drop_oldest()
+{
+    SpscQueue<Item, CAPACITY> queue(SPSC_DROP_OLDEST);
+    RunResult result = run(queue);
+    SpscQueueStats stats = queue.stats();
+    TEST_ASSERT_EQUAL_UINT32(0, result.torn);
+    TEST_ASSERT_EQUAL_UINT32(0, result.out_of_order);
+    TEST_ASSERT_EQUAL_UINT32(ITEM_COUNT, result.accepted);
+    TEST_ASSERT_EQUAL_UINT32(ITEM_COUNT, stats.pushed);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.dropped_newest);
+    TEST_ASSERT_EQUAL_UINT32(ITEM_COUNT, stats.popped + stats.dropped_oldest);
+    TEST_ASSERT_EQUAL_UINT32(result.received, stats.popped);
+    TEST_ASSERT_GREATER_THAN(0u, stats.dropped_oldest);
+    TEST_ASSERT_EQUAL_UINT32(CAPACITY, stats.high_water);
+}
+
+void test_block()
+{
+    SpscQueue<Item, CAPACITY> queue(SPSC_BLOCK, 1000);
+    RunResult result = run(queue);
+    SpscQueueStats stats = queue.stats();
+    TEST_ASSERT_EQUAL_UINT32(0, result.torn);
+    TEST_ASSERT_EQUAL_UINT32(0, result.out_of_order);
+    TEST_ASSERT_EQUAL_UINT32(ITEM_COUNT, result.accepted);
+    TEST_ASSERT_EQUAL_UINT32(ITEM_COUNT, result.received);
+    TEST_ASSERT_EQUAL_UINT32(ITEM_COUNT, stats.popped);
+    TEST_ASSERT_EQUAL_UINT32(0, queue.dropped());
+    TEST_ASSERT_GREATER_THAN(0u, stats.blocked);
+    TEST_ASSERT_EQUAL_UINT32(CAPACITY, stats.high_water);
+}
+
+// Without a consumer, a blocked push gives up after the timeout
+void test_block_times_out()
+{
+    SpscQueue<Item, CAPACITY> queue(SPSC_BLOCK, 5);
+    for (uint32_t seq = 0; seq < CAPACITY; seq++)
+        TEST_ASSERT_TRUE(queue.push(makeItem(seq)));
+    TEST_ASSERT_FALSE(queue.push(makeItem(CAPACITY)));
+    TEST_ASSERT_EQUAL_UINT32(1, queue.stats().blocked);
+    TEST_ASSERT_EQUAL_UINT32(1, queue.stats().dropped_newest);
+
+    Item item;
+    TEST_ASSERT_TRUE(queue.pop(item));
+    TEST_ASSERT_EQUAL_UINT32(0, item.seq);
+}
+
+// Single-threaded: the newest CAPACITY items survive an overflow
+void test_drop_oldest_keeps_the_newest()
+{
+    SpscQueue<Item, CAPACITY> queue(SPSC_DROP_OLDEST);
+    for (uint32_t seq = 0; seq < 3 * CAPACITY; seq++)
+        TEST_ASSERT_TRUE(queue.push(makeItem(seq)));
+    TEST_ASSERT_EQUAL_size_t(CAPACITY, queue.size());
+    TEST_ASSERT_EQUAL_UINT32(2 * CAPACITY, queue.stats().dropped_oldest);
+    Item item;
+    for (uint32_t seq = 2 * CAPACITY; seq < 3 * CAPACITY; seq++)
+    {
+        TEST_ASSERT_TRUE(queue.pop(item));
+        TEST_ASSERT_EQUAL_UINT32(seq, item.seq);
+    }
+    TEST_ASSERT_FALSE(queue.pop(item));
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_drop_newest);
+    RUN_TEST(test_drop_oldest);
+    RUN_TEST(test_block);
+    RUN_TEST(test_block_times_out);
+    RUN_TEST(test_drop_oldest_keeps_the_newest);
+    return UNITY_END();
+}
@@ -0,0 +1,261 @@
+#include <algorithm>
+#include <unity.h>
+#include "StreamingStats.h"
+#include "../BenchTimer.h"
+
+static const int STREAM_LENGTH = 10000;
+
+// Deterministic uniform values in [0, 1)
+static uint32_t rngState;
+
+static float uniform()
+{
+    rngState = rngState * 1664525u + 1013904223u;
+    return (rngState >> 8) / 16777216.0f;
+}
+
+// Standard normal values (Box-Muller)
+static float normal()
+{
+    float u = uniform() + 1e-7f, v = uniform();
+    return sqrtf(-2.0f * logf(u)) * cosf(6.2831853f * v);
+}
+
+// Nearest-rank quantile of the sorted values, as WindowStats reports it
+static float exactQuantile(float *values, int count, float p)
+{
+    std::sort(values, values + count);
+    int index = (int)ceilf(p * count) - 1;
+    return values[index < 0 ? 0 : index];
+}
+
+void setUp() { rngState = 12345; }
+void tearDown() {}
+
+void test_running_stats_empty_and_single()
+{
+    RunningStats stats;
+    TEST_ASSERT_EQUAL_UINT32(0, stats.count());
+    TEST_ASSERT_FLOAT_IS_NAN(stats.mean());
+    TEST_ASSERT_FLOAT_IS_NAN(stats.variance());
+    TEST_ASSERT_FLOAT_IS_NAN(stats.min());
+
+    stats.add(NAN);
+    stats.add(4.5f);
+    stats.add(NAN);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.count());
+    TEST_ASSERT_EQUAL_FLOAT(4.5f, stats.mean());
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, stats.variance());
+    TEST_ASSERT_EQUAL_FLOAT(4.5f, stats.min());
+    TEST_ASSERT_EQUAL_FLOAT(4.5f, stats.max());
+}
+
+// Against a two-pass computation in double, on values with a large offset
+// where the naive sum-of-squares formula loses all precision
+void test_running_stats_match_two_pass()
+{
+    static float values[STREAM_LENGTH];
+    RunningStats stats;
+    double sum = 0.0;
+    for (int i = 0; i < STREAM_LENGTH; i++)
+    {
+        values[i] = 10000.0f + normal();
+        stats.add(values[i]);
+        sum += values[i];
+    }
+    double mean = sum / STREAM_LENGTH, m2 = 0.0;
+    for (int i = 0; i < STREAM_LENGTH; i++)
+        m2 += (values[i] - mean) * (values[i] - mean);
+    double variance = m2 / (STREAM_LENGTH - 1);
+
+    TEST_ASSERT_EQUAL_UINT32(STREAM_LENGTH, stats.count());
+    TEST_ASSERT_FLOAT_WITHIN(1e-3f, (float)mean, stats.mean());
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, (float)variance, stats.variance());
+    TEST_ASSERT_EQUAL_FLOAT(*std::min_element(values, values + STREAM_LENGTH), stats.min());
+    TEST_ASSERT_EQUAL_FLOAT(*std::max_element(values, values + STREAM_LENGTH), stats.max());
+}
+
+void test_running_stats_merge()
+{
+    RunningStats all, first, second, empty;
+    for (int i = 0; i < 1000; i++)
+    {
+        float value = 5.0f + 3.0f * normal();
+        all.add(value);
+        (i < 300 ? first : second).add(value);
+    }
+    first.merge(empty);
+    first.merge(second);
+    TEST_ASSERT_EQUAL_UINT32(all.count(), first.count());
+    TEST_ASSERT_FLOAT_WITHIN(1e-5f, all.mean(), first.mean());
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, all.variance(), first.variance());
+    TEST_ASSERT_EQUAL_FLOAT(all.min(), first.min());
+    TEST_ASSERT_EQUAL_FLOAT(all.max(), first.max());
+
+    empty.merge(all);
+    TEST_ASSERT_FLOAT_WITHIN(1e-6f, all.mean(), empty.mean());
+}
+
+// Against the recurrence evaluated in double
+void test_ewma_matches_recurrence()
+{
+    const float alpha = 0.2f;
+    Ewma ewma(alpha);
+    TEST_ASSERT_FLOAT_IS_NAN(ewma.value());
+    TEST_ASSERT_FLOAT_IS_NAN(ewma.variance());
+
+    double value = 0.0, variance = 0.0;
+    for (int i = 0; i < 1000; i++)
+    {
+        float x = 20.0f + 2.0f * normal();
+        ewma.add(x);
+        ewma.add(NAN);
+        if (i == 0)
+        {
+            value = x;
+            continue;
+        }
+        double delta = x - value;
+        value += alpha * delta;
+        variance = (1.0 - alpha) * (variance + alpha * delta * delta);
+    }
+    TEST_ASSERT_FLOAT_WITHIN(1e-3f, (float)value, ewma.value());
+    TEST_ASSERT_FLOAT_WITHIN(1e-3f, (float)variance, ewma.variance());
+}
+
+// After one half-life a step has moved the average halfway
+void test_ewma_half_life()
+{
+    Ewma ewma(Ewma::alphaForHalfLife(10.0f));
+    ewma.add(0.0f);
+    for (int i = 0; i < 10; i++)
+        ewma.add(100.0f);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 50.0f, ewma.value());
+}
+
+// Up to five values the estimate is the exact nearest-rank quantile
+void test_p2_exact_for_few_values()
+{
+    P2Quantile median(0.5f), p95(0.95f);
+    TEST_ASSERT_FLOAT_IS_NAN(median.value());
+    const float values[] = {7.0f, 1.0f, NAN, 5.0f, 3.0f, 9.0f};
+    float seen[5];
+    int count = 0;
+    for (float value : values)
+    {
+        median.add(value);
+        p95.add(value);
+        if (isnan(value))
+            continue;
+        seen[count++] = value;
+        float sorted[5];
+        std::copy(seen, seen + count, sorted);
+        TEST_ASSERT_EQUAL_FLOAT(exactQuantile(sorted, count, 0.5f), median.value());
+        TEST_ASSERT_EQUAL_FLOAT(exactQuantile(sorted, count, 0.95f), p95.value());
+    }
+    TEST_ASSERT_EQUAL_UINT32(5, median.count());
+}
+
+// On long streams within a few percent of the exact quantile, measured in
+// standard deviations of the distribution
+static void checkP2(float (*next)(), float p, float tolerance)
+{
+    static float values[STREAM_LENGTH];
+    P2Quantile estimate(p);
+    RunningStats stats;
+    for (int i = 0; i < STREAM_LENGTH; i++)
+    {
+        values[i] = next();
+        estimate.add(values[i]);
+        stats.add(values[i]);
+    }
+    float exact = exactQuantile(values, STREAM_LENGTH, p);
+    TEST_ASSERT_FLOAT_WITHIN(tolerance * stats.stddev(), exact, estimate.value());
+}
+
+static float lognormal() { return expf(0.5f * normal()); }
+
+void test_p2_uniform()
+{
+    checkP2(uniform, 0.5f, 0.03f);
+    checkP2(uniform, 0.95f, 0.03f);
+}
+
+void test_p2_normal()
+{
+    checkP2(normal, 0.5f, 0.03f);
+    checkP2(normal, 0.95f, 0.03f);
+}
+
+// Skewed like PM concentrations
+void test_p2_lognormal()
+{
+    checkP2(lognormal, 0.5f, 0.03f);
+    checkP2(lognormal, 0.95f, 0.05f);
+}
+
+void test_streaming_stats_combines_parts()
+{
+    StreamingStats stats(0.5f);
+    TEST_ASSERT_FLOAT_IS_NAN(stats.mean());
+    TEST_ASSERT_FLOAT_IS_NAN(stats.median());
+    for (int i = 1; i <= 5; i++)
+        stats.add((float)i);
+    stats.add(NAN);
+    TEST_ASSERT_EQUAL_UINT32(5, stats.count());
+    TEST_ASSERT_EQUAL_FLOAT(3.0f, stats.mean());
+    TEST_ASSERT_FLOAT_WITHIN(1e-5f, sqrtf(2.5f), stats.stddev());
+    TEST_ASSERT_EQUAL_FLOAT(3.0f, stats.median());
+    TEST_ASSERT_EQUAL_FLOAT(5.0f, stats.p95());
+    TEST_ASSERT_FLOAT_WITHIN(1e-5f, 4.0625f, stats.ewma());
+
+    stats.reset();
+    TEST_ASSERT_EQUAL_UINT32(0, stats.count());
+    TEST_ASSERT_FLOAT_IS_NAN(stats.ewma());
+}
+
+void test_benchmark()
+{
+    static float values[1024];
+    for (int i = 0; i < 1024; i++)
+        values[i] = lognormal();
+    uint32_t i = 0;
+
+    RunningStats running;
+    reportBenchmark("RunningStats::add", nsPerCall([&] {
+                        running.add(values[i++ & 1023]);
+                        return running.count();
+                    }, 1000000));
+    Ewma ewma;
+    reportBenchmark("Ewma::add", nsPerCall([&] {
+                        ewma.add(values[i++ & 1023]);
+                        return ewma.value();
+                    }, 1000000));
+    P2Quantile p95(0.95f);
+    reportBenchmark("P2Quantile::add", nsPerCall([&] {
+                        p95.add(values[i++ & 1023]);
+                        return p95.count();
+                    }, 1000000));
+    StreamingStats stats;
+    reportBenchmark("StreamingStats::add", nsPerCall([&] {
+                        stats.add(values[i++ & 1023]);
+                        return stats.count();
+                    }, 1000000));
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_running_stats_empty_and_single);
+    RUN_TEST(test_running_stats_match_two_pass);
+    RUN_TEST(test_running_stats_merge);
+    RUN_TEST(test_ewma_matches_recurrence);
+    RUN_TEST(test_ewma_half_life);
+    RUN_TEST(test_p2_exact_for_few_values);
+    RUN_TEST(test_p2_uniform);
+    RUN_TEST(test_p2_normal);
+    RUN_TEST(test_p2_lognormal);
+    RUN_TEST(test_streaming_stats_combines_parts);
+    RUN_TEST(test_benchmark);
+    return UNITY_END();
+}
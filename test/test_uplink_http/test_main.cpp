@@ -0,0 +1,433 @@
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <netinet/in.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include <unity.h>
+#include "BatchUplink.h"
+
+// InfluxHttpTransport needs the Arduino HTTPClient, so it is not built here.
+// These tests run BatchUplink against a loopback HTTP server instead, through
+// a socket transport that sends the same requests: POST /api/v2/write with
+// the token, keep-alive, one resend on a new connection when a reused one
+// turns out to be closed, and the status codes mapped by
+// classifyInfluxStatus().
+
+struct ReceivedRequest
+{
+    std::string method, target, authorization, content_type, body;
+};
+
+// Accepts connections on 127.0.0.1 and answers every request with the next
+// scripted status code (204 once the script is empty)
+class LoopbackInflux
+{
+public:
+    LoopbackInflux() : _listener(-1), _port(0), _connections(0), _close_after_response(false), _stop(false)
+    {
+        _listener = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        bind(_listener, (sockaddr *)&addr, sizeof(addr));
+        socklen_t len = sizeof(addr);
+        getsockname(_listener, (sockaddr *)&addr, &len);
+        _port = ntohs(addr.sin_port);
+        listen(_listener, 4);
+        _thread = std::thread([this] { serve(); });
+    }
+
+    ~LoopbackInflux()
+    {
+        _stop = true;
+        shutdown(_listener, SHUT_RDWR);
+        close(_listener);
+        _thread.join();
+    }
+
+    uint16_t port() const { return _port; }
+
+    void script(int status)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _statuses.push_back(status);
+    }
+
+    // Closes every connection after its first response, like a server with
+    // a short idle timeout
+    void setCloseAfterResponse(bool close) { _close_after_response = close; }
+
+    std::vector<ReceivedRequest> requests()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _requests;
+    }
+
+    uint32_t connections()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _connections;
+    }
+
+private:
+    void serve()
+    {
+        while (!_stop)
+        {
+            int client = accept(_listener, nullptr, nullptr);
+            if (client < 0)
+                break;
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _connections++;
+            }
+            std::string pending;
+            while (handle(client, pending) && !_close_after_response)
+            {
+            }
+            close(client);
+        }
+    }
+
+    // Reads one request and answers it; false once the connection closed
+    bool handle(int client, std::string &pending)
+    {
+        size_t header_end;
+        while ((header_end = pending.find("\r\n\r\n")) == std::string::npos)
+        {
+            if (!receive(client, pending))
+                return false;
+        }
+        std::string head = pending.substr(0, header_end);
+        ReceivedRequest request;
+        size_t space = head.find(' ');
+        request.method = head.substr(0, space);
+        request.target = head.substr(space + 1, head.find(' ', space + 1) - space - 1);
+        request.authorization = header(head, "Authorization");
+        request.content_type = header(head, "Content-Type");
+        size_t length = (size_t)atoi(header(head, "Content-Length").c_str());
+        while (pending.size() < header_end + 4 + length)
+        {
+            if (!receive(client, pending))
+                return false;
+        }
+        request.body = pending.substr(header_end + 4, length);
+        pending.erase(0, header_end + 4 + length);
+
+        int status = 204;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _requests.push_back(request);
+            if (!_statuses.empty())
+            {
+                status = _statuses.front();
+                _statuses.pop_front();
+            }
+        }
+        const char *reason = status == 204 ? "" : "{\"code\":\"error\"}";
+        char response[160];
+        int len = snprintf(response, sizeof(response), "HTTP/1.1 %d X\r\nContent-Length: %zu\r\n\r\n%s", status,
+                           strlen(reason), reason);
+        return send(client, response, (size_t)len, MSG_NOSIGNAL) == len;
+    }
+
+    static bool receive(int client, std::string &pending)
+    {
+        char chunk[1024];
+        ssize_t n = recv(client, chunk, sizeof(chunk), 0);
+        if (n <= 0)
+            return false;
+        pending.append(chunk, (size_t)n);
+        return true;
+    }
+
+    static std::string header(const std::string &head, const char *name)
+    {
+        std::string key = std::string("\r\n") + name + ": ";
+        size_t start = head.find(key);
+        if (start == std::string::npos)
+            return "";
+        start += key.size();
+        return head.substr(start, head.find("\r\n", start) - start);
+    }
+
+    int _listener;
+    uint16_t _port;
+    std::thread _thread;
+    std::mutex _mutex;
+    std::deque<int> _statuses;
+    std::vector<ReceivedRequest> _requests;
+    uint32_t _connections;
+    std::atomic<bool> _close_after_response;
+    std::atomic<bool> _stop;
+};
+
+// The request path of InfluxHttpTransport over plain POSIX sockets
+class SocketTransport
+{
+public:
+    explicit SocketTransport(uint16_t port) : _port(port), _fd(-1), _handshakes(0), _reused(0), _last_status(0) {}
+    ~SocketTransport() { disconnect(); }
+
+    UplinkWriteResult write(const char *body, size_t len)
+    {
+        int code = -1;
+        for (int attempt = 0; attempt < 2; attempt++)
+        {
+            bool reused = _fd >= 0;
+            if (!reused && !connectToServer())
+                break;
+            if (reused)
+                _reused++;
+            code = post(body, len);
+            if (code < 0)
+            {
+                // The server closed the idle connection; resend on a new one
+                disconnect();
+                if (reused)
+                    continue;
+            }
+            break;
+        }
+        _last_status = code;
+        return classifyInfluxStatus(code);
+    }
+
+    unsigned long millis()
+    {
+        using namespace std::chrono;
+        return (unsigned long)duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+    }
+
+    uint32_t handshakes() const { return _handshakes; }
+    uint32_t reused() const { return _reused; }
+    int lastStatusCode() const { return _last_status; }
+
+private:
+    bool connectToServer()
+    {
+        _fd = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons(_port);
+        _handshakes++;
+        if (connect(_fd, (sockaddr *)&addr, sizeof(addr)) != 0)
+        {
+            disconnect();
+            return false;
+        }
+        return true;
+    }
+
+    void disconnect()
+    {
+        if (_fd >= 0)
+            close(_fd);
+        _fd = -1;
+    }
+
+    // Sends the request and returns the status code, or -1 on a connection
+    // error
+    int post(const char *body, size_t len)
+    {
+        char head[256];
+        int head_len = snprintf(head, sizeof(head),
+                                "POST /api/v2/write?org=my-org&bucket=opc%%20n3&precision=s HTTP/1.1\r\n"
+                                "Host: 127.0.0.1:%u\r\nConnection: keep-alive\r\nAuthorization: Token secret\r\n"
+                                "Content-Type: text/plain; charset=utf-8\r\nContent-Length: %zu\r\n\r\n",
+                                _port, len);
+        if (send(_fd, head, (size_t)head_len, MSG_NOSIGNAL) != head_len ||
+            send(_fd, body, len, MSG_NOSIGNAL) != (ssize_t)len)
+            return -1;
+
+        std::string response;
+        size_t header_end;
+        char chunk[512];
+        while ((header_end = response.find("\r\n\r\n")) == std::string::npos)
+        {
+            ssize_t n = recv(_fd, chunk, sizeof(chunk), 0);
+            if (n <= 0)
+                return -1;
+            response.append(chunk, (size_t)n);
+        }
+        size_t length_at = response.find("Content-Length: ");
+        size_t length = length_at < header_end ? (size_t)atoi(response.c_str() + length_at + 16) : 0;
+        while (response.size() < header_end + 4 + length)
+        {
+            ssize_t n = recv(_fd, chunk, sizeof(chunk), 0);
+            if (n <= 0)
+                return -1;
+            response.append(chunk, (size_t)n);
+        }
+        return atoi(response.c_str() + 9);
+    }
+
+    uint16_t _port;
+    int _fd;
+    uint32_t _handshakes;
+    uint32_t _reused;
+    int _last_status;
+};
+
+typedef BatchUplink<SocketTransport, 4096> Uplink;
+static const BatchUplinkConfig CONFIG = {10, 60000, 1, 1};
+
+static LoopbackInflux *server;
+static SocketTransport *transport;
+
+void setUp()
+{
+    server = new LoopbackInflux();
+    transport = new SocketTransport(server->port());
+}
+
+void tearDown()
+{
+    delete transport;
+    delete server;
+}
+
+static void addLines(Uplink &uplink, int first, int count)
+{
+    char line[64];
+    for (int i = first; i < first + count; i++)
+    {
+        int len = snprintf(line, sizeof(line), "opcn3,device=a pm2_5=%d.5 %d", i, 1700000000 + i);
+        TEST_ASSERT_TRUE(uplink.add(line, (size_t)len));
+        uplink.flush();
+    }
+}
+
+static int lineCount(const std::string &body)
+{
+    int lines = 0;
+    for (char c : body)
+        lines += c == '\n';
+    return lines;
+}
+
+// 35 lines at 10 per batch: three requests of 10 on one connection, and a
+// fourth for the rest once forced
+void test_one_request_per_batch()
+{
+    Uplink uplink(*transport, CONFIG);
+    addLines(uplink, 0, 35);
+    TEST_ASSERT_EQUAL_UINT32(3, uplink.stats().requests);
+    TEST_ASSERT_EQUAL_INT(UPLINK_FLUSH_SENT, uplink.flush(true));
+
+    std::vector<ReceivedRequest> requests = server->requests();
+    TEST_ASSERT_EQUAL_size_t(4, requests.size());
+    TEST_ASSERT_EQUAL_UINT32(4, uplink.stats().requests);
+    TEST_ASSERT_EQUAL_UINT32(35, uplink.stats().points_sent);
+    TEST_ASSERT_EQUAL_UINT32(1, server->connections());
+    TEST_ASSERT_EQUAL_UINT32(1, transport->handshakes());
+    TEST_ASSERT_EQUAL_UINT32(3, transport->reused());
+
+    for (size_t i = 0; i < requests.size(); i++)
+    {
+        TEST_ASSERT_EQUAL_STRING("POST", requests[i].method.c_str());
+        TEST_ASSERT_EQUAL_STRING("/api/v2/write?org=my-org&bucket=opc%20n3&precision=s", requests[i].target.c_str());
+        TEST_ASSERT_EQUAL_STRING("Token secret", requests[i].authorization.c_str());
+        TEST_ASSERT_EQUAL_STRING("text/plain; charset=utf-8", requests[i].content_type.c_str());
+        TEST_ASSERT_EQUAL_INT(i < 3 ? 10 : 5, lineCount(requests[i].body));
+    }
+    std::string first_line = requests[0].body.substr(0, requests[0].body.find('\n') + 1);
+    TEST_ASSERT_EQUAL_STRING("opcn3,device=a pm2_5=0.5 1700000000\n", first_line.c_str());
+}
+
+// A 503 keeps the batch; the retry sends it again with the lines added since
+void test_server_error_is_retried_with_the_whole_batch()
+{
+    Uplink uplink(*transport, CONFIG);
+    server->script(503);
+    addLines(uplink, 0, 10);
+    TEST_ASSERT_TRUE(uplink.retrying());
+    TEST_ASSERT_EQUAL_INT(503, transport->lastStatusCode());
+    TEST_ASSERT_EQUAL_UINT32(1, uplink.stats().requests_failed);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    addLines(uplink, 10, 2);
+    TEST_ASSERT_FALSE(uplink.retrying());
+
+    std::vector<ReceivedRequest> requests = server->requests();
+    TEST_ASSERT_EQUAL_size_t(2, requests.size());
+    TEST_ASSERT_EQUAL_INT(10, lineCount(requests[0].body));
+    TEST_ASSERT_EQUAL_INT(11, lineCount(requests[1].body));
+    std::string resent = requests[1].body.substr(0, requests[0].body.size());
+    TEST_ASSERT_EQUAL_STRING(requests[0].body.c_str(), resent.c_str());
+    TEST_ASSERT_EQUAL_UINT32(11, uplink.stats().points_sent);
+    TEST_ASSERT_EQUAL_UINT16(1, uplink.points());
+}
+
+// A 400 drops the batch and the next one goes out as usual
+void test_rejected_batch_is_dropped()
+{
+    Uplink uplink(*transport, CONFIG);
+    server->script(400);
+    addLines(uplink, 0, 20);
+    TEST_ASSERT_EQUAL_size_t(2, server->requests().size());
+    TEST_ASSERT_EQUAL_UINT32(10, uplink.stats().points_dropped);
+    TEST_ASSERT_EQUAL_UINT32(10, uplink.stats().points_sent);
+    TEST_ASSERT_FALSE(uplink.retrying());
+}
+
+// A server that closes idle connections gets every batch exactly once, on a
+// new connection each time
+void test_closed_connection_is_reopened()
+{
+    server->setCloseAfterResponse(true);
+    Uplink uplink(*transport, CONFIG);
+    addLines(uplink, 0, 30);
+    TEST_ASSERT_EQUAL_UINT32(3, uplink.stats().requests);
+    TEST_ASSERT_EQUAL_UINT32(0, uplink.stats().requests_failed);
+    TEST_ASSERT_EQUAL_size_t(3, server->requests().size());
+    TEST_ASSERT_EQUAL_UINT32(3, server->connections());
+    TEST_ASSERT_EQUAL_UINT32(3, transport->handshakes());
+}
+
+// Nothing listening: a connection error is retried later
+void test_unreachable_server_is_retried()
+{
+    uint16_t port = server->port();
+    delete server;
+    server = new LoopbackInflux();
+    SocketTransport unreachable(port);
+    Uplink uplink(unreachable, CONFIG);
+    addLines(uplink, 0, 10);
+    TEST_ASSERT_TRUE(uplink.retrying());
+    TEST_ASSERT_EQUAL_INT(-1, unreachable.lastStatusCode());
+    TEST_ASSERT_EQUAL_UINT32(1, uplink.stats().requests_failed);
+    TEST_ASSERT_EQUAL_UINT16(10, uplink.points());
+}
+
+void test_status_classification()
+{
+    TEST_ASSERT_EQUAL_INT(UPLINK_WRITE_OK, classifyInfluxStatus(204));
+    TEST_ASSERT_EQUAL_INT(UPLINK_WRITE_OK, classifyInfluxStatus(200));
+    TEST_ASSERT_EQUAL_INT(UPLINK_WRITE_REJECTED, classifyInfluxStatus(400));
+    TEST_ASSERT_EQUAL_INT(UPLINK_WRITE_REJECTED, classifyInfluxStatus(413));
+    TEST_ASSERT_EQUAL_INT(UPLINK_WRITE_REJECTED, classifyInfluxStatus(422));
+    TEST_ASSERT_EQUAL_INT(UPLINK_WRITE_RETRY, classifyInfluxStatus(401));
+    TEST_ASSERT_EQUAL_INT(UPLINK_WRITE_RETRY, classifyInfluxStatus(429));
+    TEST_ASSERT_EQUAL_INT(UPLINK_WRITE_RETRY, classifyInfluxStatus(503));
+    TEST_ASSERT_EQUAL_INT(UPLINK_WRITE_RETRY, classifyInfluxStatus(-1));
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_one_request_per_batch);
+    RUN_TEST(test_server_error_is_retried_with_the_whole_batch);
+    RUN_TEST(test_rejected_batch_is_dropped);
+    RUN_TEST(test_closed_connection_is_reopened);
+    RUN_TEST(test_unreachable_server_is_retried);
+    RUN_TEST(test_status_classification);
+    return UNITY_END();
+}
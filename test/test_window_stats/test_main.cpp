@@ -0,0 +1,73 @@
+#include <unity.h>
+#include "WindowStats.h"
+#include "../BenchTimer.h"
+
+void setUp() {}
+void tearDown() {}
+
+void test_summary_of_a_small_window()
+{
+    WindowStats<16> stats;
+    TEST_ASSERT_FLOAT_IS_NAN(stats.mean());
+    TEST_ASSERT_FLOAT_IS_NAN(stats.percentile(95.0f));
+    const float values[] = {4.0f, 2.0f, NAN, 8.0f, 6.0f};
+    for (float value : values)
+        stats.add(value);
+    TEST_ASSERT_EQUAL_UINT32(4, stats.count());
+    TEST_ASSERT_EQUAL_FLOAT(2.0f, stats.min());
+    TEST_ASSERT_EQUAL_FLOAT(8.0f, stats.max());
+    TEST_ASSERT_EQUAL_FLOAT(5.0f, stats.mean());
+    TEST_ASSERT_FLOAT_WITHIN(1e-5f, 2.5819889f, stats.stddev());
+    TEST_ASSERT_EQUAL_FLOAT(4.0f, stats.percentile(50.0f));
+    TEST_ASSERT_EQUAL_FLOAT(8.0f, stats.percentile(95.0f));
+    TEST_ASSERT_TRUE(stats.allKept());
+}
+
+// A rising window longer than the kept values: the p95 must cover all of
+// it, not only the first 64 values
+void test_p95_beyond_the_kept_values()
+{
+    WindowStats<64> stats;
+    for (int i = 1; i <= 1000; i++)
+        stats.add((float)i);
+    TEST_ASSERT_FALSE(stats.allKept());
+    TEST_ASSERT_EQUAL_FLOAT(1000.0f, stats.max());
+    TEST_ASSERT_EQUAL_FLOAT(500.5f, stats.mean());
+    TEST_ASSERT_FLOAT_WITHIN(10.0f, 950.0f, stats.percentile(95.0f));
+    // Other percentiles still come from the kept values
+    TEST_ASSERT_EQUAL_FLOAT(32.0f, stats.percentile(50.0f));
+
+    stats.reset();
+    stats.add(3.0f);
+    TEST_ASSERT_TRUE(stats.allKept());
+    TEST_ASSERT_EQUAL_FLOAT(3.0f, stats.percentile(95.0f));
+}
+
+void test_tracked_percentile_can_be_chosen()
+{
+    WindowStats<8> stats(50.0f);
+    for (int i = 1; i <= 101; i++)
+        stats.add((float)(i % 2 ? i : 102 - i));
+    TEST_ASSERT_FLOAT_WITHIN(5.0f, 51.0f, stats.percentile(50.0f));
+}
+
+void test_benchmark()
+{
+    static WindowStats<64> stats;
+    uint32_t i = 0;
+    reportBenchmark("add", nsPerCall([&] {
+                        stats.add((float)(i++ % 977));
+                        return i;
+                    }, 1000000));
+    reportBenchmark("percentile, 64 kept", nsPerCall([&] { return stats.percentile(50.0f); }, 100000));
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_summary_of_a_small_window);
+    RUN_TEST(test_p95_beyond_the_kept_values);
+    RUN_TEST(test_tracked_percentile_can_be_chosen);
+    RUN_TEST(test_benchmark);
+    return UNITY_END();
+}